@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace bench {
+
+// Latency histogram in the HdrHistogram layout: values are kept with
+// `significant_digits` decimal digits of precision from 1 up to `max_value`,
+// buckets double in width and each is split in the same number of linear
+// sub-buckets. Recording is a couple of shifts, so one histogram per thread
+// is cheap and they are merged with add() at the end.
+class HdrHistogram {
+  public:
+    explicit HdrHistogram(int significant_digits = 3, uint64_t max_value = 3600ULL * 1000 * 1000)
+            : _sub_bucket_magnitude(0)
+              , _max_value(max_value)
+              , _total(0)
+              , _min(UINT64_MAX)
+              , _max(0)
+              , _sum(0) {
+        auto largest_single_unit = (uint64_t) (2 * std::pow(10, std::clamp(significant_digits, 1, 5)));
+        _sub_bucket_magnitude = (int) std::bit_width(largest_single_unit - 1);
+
+        uint64_t sub_buckets = 1ULL << _sub_bucket_magnitude;
+        int buckets = 1;
+        for (uint64_t covered = sub_buckets; covered <= max_value && buckets < 64; covered <<= 1) {
+            buckets++;
+        }
+        _counts.assign((size_t) (buckets + 1) << (_sub_bucket_magnitude - 1), 0);
+    }
+
+    void record(uint64_t value, uint64_t count = 1) {
+        value = std::min(value, _max_value);
+        _counts[_index_of(value)] += count;
+        _total += count;
+        _sum += value * count;
+        _min = std::min(_min, value);
+        _max = std::max(_max, value);
+    }
+
+    // Both histograms must have been created with the same parameters
+    void add(const HdrHistogram &other) {
+        for (size_t i = 0; i < _counts.size() && i < other._counts.size(); ++i) {
+            _counts[i] += other._counts[i];
+        }
+        _total += other._total;
+        _sum += other._sum;
+        _min = std::min(_min, other._min);
+        _max = std::max(_max, other._max);
+    }
+
+    // Smallest value that `percentile` percent of the recorded values do not exceed
+    [[nodiscard]] uint64_t value_at_percentile(double percentile) const {
+        if (_total == 0) {
+            return 0;
+        }
+        auto target = (uint64_t) std::ceil(std::clamp(percentile, 0.0, 100.0) / 100.0 * (double) _total);
+        target = std::max(target, (uint64_t) 1);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < _counts.size(); ++i) {
+            seen += _counts[i];
+            if (seen >= target) {
+                return std::min(_highest_equivalent(i), _max);
+            }
+        }
+        return _max;
+    }
+
+    [[nodiscard]] uint64_t get_total_count() const {
+        return _total;
+    }
+
+    [[nodiscard]] uint64_t get_min() const {
+        return _total == 0 ? 0 : _min;
+    }
+
+    [[nodiscard]] uint64_t get_max() const {
+        return _max;
+    }
+
+    [[nodiscard]] double get_mean() const {
+        return _total == 0 ? 0 : (double) _sum / (double) _total;
+    }
+
+  private:
+    [[nodiscard]] size_t _index_of(uint64_t value) const {
+        uint64_t sub_bucket_mask = (1ULL << _sub_bucket_magnitude) - 1;
+        int bucket = (int) std::bit_width(value | sub_bucket_mask) - _sub_bucket_magnitude;
+        auto sub_bucket = value >> bucket;
+        // Bucket 0 uses all its sub-buckets, the next ones only their upper
+        // half because the lower one is covered by the previous bucket
+        return ((size_t) (bucket + 1) << (_sub_bucket_magnitude - 1))
+               + sub_bucket - (1ULL << (_sub_bucket_magnitude - 1));
+    }
+
+    [[nodiscard]] uint64_t _highest_equivalent(size_t index) const {
+        uint64_t half = 1ULL << (_sub_bucket_magnitude - 1);
+        int bucket = (int) (index >> (_sub_bucket_magnitude - 1)) - 1;
+        uint64_t sub_bucket = (index & (half - 1)) + half;
+        if (bucket < 0) {
+            sub_bucket -= half;
+            bucket = 0;
+        }
+        return (sub_bucket << bucket) + (1ULL << bucket) - 1;
+    }
+
+    std::vector<uint64_t>   _counts;
+    int                     _sub_bucket_magnitude;
+    uint64_t                _max_value;
+    uint64_t                _total;
+    uint64_t                _min;
+    uint64_t                _max;
+    uint64_t                _sum;
+};
+
+}
@@ -0,0 +1,43 @@
+-- Query latency of the history schema at 10M rows. Run against a scratch
+-- database created with scripts/init.sql (the rows are not removed):
+--   psql -h localhost -U proxy proxy -f bench/history_latency.sql
+-- The rows hold "GET / HTTP/1.1" with a Host header in the binary format of
+-- http::Request::encode, spread over the last eleven months and 1000 hosts.
+
+\set rows 10000000
+\timing on
+
+SELECT history_create_partition((now() - make_interval(months => m))::date)
+FROM generate_series(1, 11) m;
+
+INSERT INTO history (created_at, port, request_bin, is_https, host)
+SELECT now() - random() * interval '330 days',
+       80,
+       decode('48520103474554012f08485454502f312e310000000104486f7374', 'hex')
+           || set_byte('\x00'::bytea, 0, length(h)) || convert_to(h, 'UTF8'),
+       false,
+       h
+FROM (SELECT 'host' || (n % 1000) || '.example' AS h FROM generate_series(1, :rows) n) hosts;
+
+ANALYZE history;
+
+SELECT min(id) + (max(id) - min(id)) / 2 AS mid_id FROM history \gset
+
+-- /list, first page
+EXPLAIN (ANALYZE, BUFFERS)
+SELECT id, request_bin, request, is_https, host, port FROM history WHERE id > 0 ORDER BY id LIMIT 100;
+
+-- /list, page in the middle of the table (keyset, no OFFSET)
+EXPLAIN (ANALYZE, BUFFERS)
+SELECT id, request_bin, request, is_https, host, port FROM history WHERE id > :mid_id ORDER BY id LIMIT 100;
+
+-- get_by_host
+EXPLAIN (ANALYZE, BUFFERS)
+SELECT id, request_bin, request, is_https, port FROM history WHERE host = 'host500.example' LIMIT 1;
+
+-- get_by_id
+EXPLAIN (ANALYZE, BUFFERS)
+SELECT request_bin, request, host, is_https, port FROM history WHERE id = :mid_id;
+
+-- Retention of half of the data
+SELECT * FROM history_drop_partitions(interval '180 days');
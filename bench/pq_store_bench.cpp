@@ -0,0 +1,131 @@
+#include "repository_lib.hpp"
+#include "request_corpus.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+
+// Rows written by the benchmark are tagged with this host and removed at exit
+static const std::string bench_host = "pq-store-bench";
+
+struct stage_result_t {
+    const char *name;
+    double      inserts_per_second;
+    double      us_per_insert;
+};
+
+template<typename Callable>
+static stage_result_t run_stage(const char *name, size_t inserts, Callable &&stage) {
+    auto start = std::chrono::steady_clock::now();
+    stage();
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return {name, (double) inserts / elapsed, elapsed * 1e6 / (double) inserts};
+}
+
+int main(int argc, char *argv[]) {
+    std::string conn_string = "host=localhost user=proxy password=pwd port=5432 dbname=proxy";
+    std::string path = "requests.jsonl";
+    size_t count = 10000;
+    size_t batch_size = 256;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "c:f:n:b:")) != -1) {
+        switch (opt) {
+            case 'c':
+                conn_string = optarg;
+                break;
+            case 'f':
+                path = optarg;
+                break;
+            case 'n':
+                count = strtoul(optarg, nullptr, 10);
+                break;
+            case 'b':
+                batch_size = strtoul(optarg, nullptr, 10);
+                break;
+            default:
+                std::cerr << "Usage: " << argv[0]
+                          << " [-c connection string] [-f requests.jsonl] [-n inserts] [-b batch size]\n";
+                return EXIT_FAILURE;
+        }
+    }
+    if (count == 0 || batch_size == 0) {
+        std::cerr << "Insert count and batch size must be positive\n";
+        return EXIT_FAILURE;
+    }
+
+    size_t skipped = 0;
+    auto corpus = bench::load_requests(path, skipped);
+    if (corpus.empty()) {
+        corpus.emplace_back("GET http://localhost/ HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    }
+
+    std::vector<rp::request_t> requests(count);
+    for (size_t i = 0; i < count; ++i) {
+        requests[i].request.parse(corpus[i % corpus.size()]);
+        requests[i].host = bench_host;
+        requests[i].port = 80;
+        requests[i].is_https = false;
+        requests[i].is_valid = true;
+    }
+
+    std::vector<std::vector<rp::request_t>> batches;
+    for (size_t i = 0; i < count; i += batch_size) {
+        batches.emplace_back(requests.begin() + (long) i,
+                             requests.begin() + (long) std::min(count, i + batch_size));
+    }
+
+    try {
+        rp::PQStoreRequest store(conn_string);
+        pqxx::connection conn(conn_string);
+
+        std::vector<stage_result_t> results;
+
+        // What PQStoreRequest::add did before statements were prepared:
+        // SQL text parsed and planned by the server on every call
+        results.push_back(run_stage("literal SQL", count, [&] {
+            for (auto &req: requests) {
+                pqxx::work w(conn);
+                auto data = req.request.encode();
+                w.exec_params1("INSERT INTO history (request_bin, is_https, host, port) VALUES($1, $2, $3, $4) RETURNING id",
+                               std::basic_string<std::byte>(reinterpret_cast<const std::byte *>(data.data()), data.size()),
+                               req.is_https, req.host, req.port);
+                w.commit();
+            }
+        }));
+
+        results.push_back(run_stage("prepared", count, [&] {
+            for (auto &req: requests) {
+                store.add(req);
+            }
+        }));
+
+        results.push_back(run_stage("pipeline", count, [&] {
+            for (auto &batch: batches) {
+                store.add_pipelined(batch);
+            }
+        }));
+
+        results.push_back(run_stage("copy", count, [&] {
+            for (auto &batch: batches) {
+                store.add_batch(batch);
+            }
+        }));
+
+        pqxx::work w(conn);
+        w.exec_params0("DELETE FROM history WHERE host = $1", bench_host);
+        w.commit();
+
+        std::cout << "Inserts: " << count << ", batch size: " << batch_size
+                  << ", distinct requests: " << corpus.size() << "\n";
+        std::printf("%-12s %14s %14s\n", "stage", "inserts/s", "us/insert");
+        for (auto &result: results) {
+            std::printf("%-12s %14.0f %14.2f\n", result.name, result.inserts_per_second, result.us_per_insert);
+        }
+    } catch (std::exception &e) {
+        std::cerr << "Benchmark failed: " << e.what() << "\n";
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
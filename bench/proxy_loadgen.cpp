@@ -0,0 +1,208 @@
+#include "proxy_client_lib.hpp"
+#include "request_corpus.hpp"
+#include "hdr_histogram.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <map>
+#include <thread>
+
+using clock_type = std::chrono::steady_clock;
+
+struct loadgen_config_t {
+    std::string proxy_host  = "127.0.0.1";
+    uint16_t    proxy_port  = 8081;
+    std::string upstream    = "127.0.0.1:9090";
+    std::string path        = "requests.jsonl";
+    double      rate        = 1000;     // requests started per second
+    long        duration    = 10;       // seconds
+    size_t      connections = 64;
+    long        timeout     = 2000;     // ms to wait for each part of a response
+};
+
+struct worker_result_t {
+    bench::HdrHistogram     latency;        // from the scheduled start, us
+    bench::HdrHistogram     service_time;   // from the actual send, us
+    std::map<int, size_t>   statuses;
+    size_t                  errors      = 0;
+    size_t                  connects    = 0;
+    size_t                  bytes       = 0;
+};
+
+// Points every request of the corpus at `upstream` through the proxy
+static std::vector<std::string> retarget(const std::vector<std::string> &corpus, const std::string &upstream) {
+    std::vector<std::string> requests;
+    for (auto &raw: corpus) {
+        http::Request request;
+        request.parse(raw);
+        auto url = request.get_url();
+        auto scheme = url.find("://");
+        auto path = url.find('/', scheme == std::string::npos ? 0 : scheme + 3);
+        request.set_url("http://" + upstream + (path == std::string::npos ? "/" : url.substr(path)));
+        request.set_header("Host", upstream);
+        request.set_header("Proxy-Connection", "Keep-Alive");
+        requests.push_back(request.string());
+    }
+    return requests;
+}
+
+static int status_code(const std::string &response) {
+    auto pos = response.find(' ');
+    if (response.rfind("HTTP/", 0) != 0 || pos == std::string::npos) {
+        return 0;
+    }
+    return (int) strtol(response.c_str() + pos + 1, nullptr, 10);
+}
+
+static void print_percentiles(const char *name, const bench::HdrHistogram &histogram) {
+    std::printf("%-14s", name);
+    for (double p: {50.0, 75.0, 90.0, 99.0, 99.9, 99.99}) {
+        std::printf(" %10.2f", (double) histogram.value_at_percentile(p) / 1000.0);
+    }
+    std::printf(" %10.2f\n", (double) histogram.get_max() / 1000.0);
+}
+
+int main(int argc, char *argv[]) {
+    loadgen_config_t config;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "a:p:u:f:r:d:c:t:")) != -1) {
+        switch (opt) {
+            case 'a':
+                config.proxy_host = optarg;
+                break;
+            case 'p':
+                config.proxy_port = (uint16_t) strtoul(optarg, nullptr, 10);
+                break;
+            case 'u':
+                config.upstream = optarg;
+                break;
+            case 'f':
+                config.path = optarg;
+                break;
+            case 'r':
+                config.rate = strtod(optarg, nullptr);
+                break;
+            case 'd':
+                config.duration = strtol(optarg, nullptr, 10);
+                break;
+            case 'c':
+                config.connections = strtoul(optarg, nullptr, 10);
+                break;
+            case 't':
+                config.timeout = strtol(optarg, nullptr, 10);
+                break;
+            default:
+                std::cerr << "Usage: " << argv[0]
+                          << " [-a proxy address] [-p proxy port] [-u upstream host:port] [-f requests.jsonl]"
+                             " [-r requests/s] [-d seconds] [-c connections] [-t read timeout ms]\n";
+                return EXIT_FAILURE;
+        }
+    }
+    if (config.rate <= 0 || config.duration <= 0 || config.connections == 0) {
+        std::cerr << "Rate, duration and connections must be positive\n";
+        return EXIT_FAILURE;
+    }
+
+    socket_addr_in address;
+    if (bstcp::hostname_to_ip(config.proxy_host.c_str(), &address) == -1) {
+        std::cerr << "Can't resolve " << config.proxy_host << "\n";
+        return EXIT_FAILURE;
+    }
+
+    size_t skipped = 0;
+    auto corpus = bench::load_requests(config.path, skipped);
+    if (corpus.empty()) {
+        corpus.emplace_back("GET http://localhost/ HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    }
+    auto requests = retarget(corpus, config.upstream);
+
+    // Open loop: request i is due at start + i / rate whatever happened to the
+    // previous ones. Latency is measured from that due time, so a stalled
+    // proxy shows up as queueing delay instead of silently lowering the rate
+    auto total = (size_t) (config.rate * (double) config.duration);
+    auto interval = std::chrono::duration<double>(1.0 / config.rate);
+    std::atomic<size_t> next = 0;
+    std::vector<worker_result_t> results(config.connections);
+    auto start = clock_type::now() + std::chrono::milliseconds(100);
+
+    auto worker = [&](worker_result_t &result) {
+        proxy::TcpSocket socket;
+        bool connected = false;
+
+        for (size_t i = next++; i < total; i = next++) {
+            auto due = start + std::chrono::duration_cast<clock_type::duration>(interval * (double) i);
+            std::this_thread::sleep_until(due);
+
+            if (!connected) {
+                socket = proxy::TcpSocket();
+                connected = socket.init((uint32_t) address.sin_addr.s_addr, config.proxy_port,
+                                        (uint16_t) bstcp::SocketType::blocking_socket
+                                        | (uint16_t) bstcp::SocketType::client_socket) == bstcp::status::connected;
+                result.connects++;
+            }
+
+            auto sent = clock_type::now();
+            auto &request = requests[i % requests.size()];
+            proxy::upstream_response_t response;
+            if (connected && socket.send_to(request.data(), (int) request.size())) {
+                response = proxy::read_response(socket, config.timeout);
+            }
+            auto done = clock_type::now();
+
+            if (response.data.empty()) {
+                result.errors++;
+            } else {
+                result.statuses[status_code(response.data)]++;
+                result.bytes += response.data.size();
+            }
+            result.latency.record(std::chrono::duration_cast<std::chrono::microseconds>(done - due).count());
+            result.service_time.record(std::chrono::duration_cast<std::chrono::microseconds>(done - sent).count());
+
+            // The proxy closes the connection after each answer for now, then
+            // the next request pays for a new one
+            if (!response.complete || !response.keep_alive) {
+                socket.disconnect();
+                connected = false;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (auto &result: results) {
+        workers.emplace_back(worker, std::ref(result));
+    }
+    for (auto &thread: workers) {
+        thread.join();
+    }
+    auto elapsed = std::chrono::duration<double>(clock_type::now() - start).count();
+
+    worker_result_t summary;
+    for (auto &result: results) {
+        summary.latency.add(result.latency);
+        summary.service_time.add(result.service_time);
+        summary.errors += result.errors;
+        summary.connects += result.connects;
+        summary.bytes += result.bytes;
+        for (auto &[status, count]: result.statuses) {
+            summary.statuses[status] += count;
+        }
+    }
+
+    std::cout << "Requests: " << total << " at " << config.rate << "/s over " << config.connections
+              << " connections, distinct requests: " << requests.size() << ", skipped lines: " << skipped << "\n";
+    std::printf("Throughput: %.0f requests/s, %.2f MB/s, %zu connects, %zu errors\n",
+                (double) total / elapsed, (double) summary.bytes / elapsed / 1e6, summary.connects, summary.errors);
+    for (auto &[status, count]: summary.statuses) {
+        std::cout << "Status " << status << ": " << count << "\n";
+    }
+
+    std::printf("%-14s %10s %10s %10s %10s %10s %10s %10s\n", "ms", "p50", "p75", "p90", "p99", "p99.9", "p99.99",
+                "max");
+    print_percentiles("latency", summary.latency);
+    print_percentiles("service time", summary.service_time);
+    return summary.errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
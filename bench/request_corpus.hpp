@@ -0,0 +1,63 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "request_parser_lib.hpp"
+
+namespace bench {
+
+// Raw HTTP requests built from a jsonl file. Lines in the stored request
+// format (`http::Request::get_json()`) are replayed as-is; any other JSON
+// object is wrapped into a POST request carrying the line as its body.
+inline std::vector<std::string> load_requests(const std::string &path, size_t &skipped) {
+    std::vector<std::string> requests;
+    std::ifstream file(path);
+    std::string line;
+    size_t line_number = 0;
+    skipped = 0;
+
+    while (std::getline(file, line)) {
+        line_number++;
+        if (line.empty()) {
+            continue;
+        }
+
+        nj::json json = nj::json::parse(line, nullptr, false);
+        if (json.is_discarded() || !json.is_object()) {
+            skipped++;
+            continue;
+        }
+
+        if (json.contains("raw") && json["raw"].is_string()) {
+            requests.push_back(json["raw"].get<std::string>());
+            continue;
+        }
+
+        if (json.contains("method") && json.contains("url")) {
+            http::Request request;
+            request.json() = json;
+            requests.push_back(request.string());
+            continue;
+        }
+
+        std::string id = json.contains("request_id") && json["request_id"].is_string()
+                ? json["request_id"].get<std::string>()
+                : std::to_string(line_number);
+        requests.push_back(
+                "POST http://localhost/requests/" + id + "?line=" + std::to_string(line_number) +
+                "&format=jsonl HTTP/1.1\r\n"
+                "Host: localhost\r\n"
+                "User-Agent: request_parser_bench\r\n"
+                "Accept: */*\r\n"
+                "Content-Type: application/json\r\n"
+                "Content-Length: " + std::to_string(line.size()) + "\r\n"
+                "Cookie: session=bench; line=" + std::to_string(line_number) + "\r\n"
+                "Proxy-Connection: Keep-Alive\r\n"
+                "\r\n" + line);
+    }
+    return requests;
+}
+
+}
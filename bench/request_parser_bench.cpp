@@ -0,0 +1,178 @@
+#include "request_parser_lib.hpp"
+#include "request_corpus.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <new>
+
+// Every heap allocation of the process goes through these counters
+static size_t allocations = 0;
+
+[[gnu::noinline]] void *operator new(size_t size) {
+    allocations++;
+    if (void *ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+[[gnu::noinline]] void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+[[gnu::noinline]] void operator delete(void *ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+struct stage_result_t {
+    const char *name;
+    double      ns_per_request;
+    double      allocs_per_request;
+    double      bytes_per_second;
+};
+
+template<typename Callable>
+static stage_result_t run_stage(const char *name, size_t iterations, size_t requests,
+                                size_t bytes, Callable &&stage) {
+    auto start_allocations = allocations;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < iterations; ++i) {
+        stage();
+    }
+
+    auto elapsed = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+    auto total = (double) (iterations * requests);
+    return {name,
+            elapsed / total,
+            (double) (allocations - start_allocations) / total,
+            (double) (iterations * bytes) / (elapsed / 1e9)};
+}
+
+int main(int argc, char *argv[]) {
+    std::string path = "requests.jsonl";
+    size_t iterations = 100;
+    double max_parse_ns = 0;
+    double max_parse_allocs = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:n:p:a:")) != -1) {
+        switch (opt) {
+            case 'f':
+                path = optarg;
+                break;
+            case 'n':
+                iterations = strtoul(optarg, nullptr, 10);
+                break;
+            case 'p':
+                max_parse_ns = strtod(optarg, nullptr);
+                break;
+            case 'a':
+                max_parse_allocs = strtod(optarg, nullptr);
+                break;
+            default:
+                std::cerr << "Usage: " << argv[0]
+                          << " [-f requests.jsonl] [-n iterations]"
+                             " [-p max parse ns/request] [-a max parse allocations/request]"
+                             " [requests.jsonl]\n";
+                return EXIT_FAILURE;
+        }
+    }
+    // The corpus may also be given without -f
+    if (optind < argc) {
+        path = argv[optind];
+    }
+
+    size_t skipped = 0;
+    auto corpus = bench::load_requests(path, skipped);
+    if (corpus.empty()) {
+        std::cerr << "No requests loaded from " << path << "\n";
+        return EXIT_FAILURE;
+    }
+
+    size_t bytes = 0;
+    for (auto &request: corpus) {
+        bytes += request.size();
+    }
+
+    std::vector<http::Request> parsed(corpus.size());
+    std::vector<std::string> dumped(corpus.size());
+    http::Arena arena;
+
+    std::vector<stage_result_t> results;
+    results.push_back(run_stage("parse", iterations, corpus.size(), bytes, [&] {
+        for (size_t i = 0; i < corpus.size(); ++i) {
+            parsed[i].parse(corpus[i]);
+        }
+    }));
+
+    results.push_back(run_stage("parse (arena)", iterations, corpus.size(), bytes, [&] {
+        for (size_t i = 0; i < corpus.size(); ++i) {
+            parsed[i].parse(corpus[i], arena);
+            arena.reset();
+        }
+    }));
+
+    size_t output_bytes = 0;
+    results.push_back(run_stage("string", iterations, corpus.size(), bytes, [&] {
+        for (auto &request: parsed) {
+            output_bytes += request.string().size();
+        }
+    }));
+
+    results.push_back(run_stage("json dump", iterations, corpus.size(), bytes, [&] {
+        for (size_t i = 0; i < parsed.size(); ++i) {
+            dumped[i] = parsed[i].get_json().dump();
+        }
+    }));
+
+    results.push_back(run_stage("json read", iterations, corpus.size(), bytes, [&] {
+        for (size_t i = 0; i < parsed.size(); ++i) {
+            parsed[i].read_json_from_string(dumped[i]);
+        }
+    }));
+
+    std::vector<std::string> encoded(corpus.size());
+    results.push_back(run_stage("binary encode", iterations, corpus.size(), bytes, [&] {
+        for (size_t i = 0; i < parsed.size(); ++i) {
+            encoded[i] = parsed[i].encode();
+        }
+    }));
+
+    results.push_back(run_stage("binary decode", iterations, corpus.size(), bytes, [&] {
+        for (size_t i = 0; i < parsed.size(); ++i) {
+            parsed[i].decode(encoded[i]);
+        }
+    }));
+
+    size_t json_bytes = 0, binary_bytes = 0;
+    for (size_t i = 0; i < parsed.size(); ++i) {
+        json_bytes += dumped[i].size();
+        binary_bytes += encoded[i].size();
+    }
+
+    std::cout << "Requests: " << corpus.size() << " (skipped lines: " << skipped << ")"
+              << ", bytes: " << bytes << ", iterations: " << iterations << "\n";
+    std::cout << "Stored size: json " << json_bytes << " bytes, binary " << binary_bytes << " bytes\n";
+    std::printf("%-16s %14s %16s %14s\n", "stage", "ns/request", "allocs/request", "MB/s");
+    for (auto &result: results) {
+        std::printf("%-16s %14.1f %16.2f %14.2f\n", result.name, result.ns_per_request,
+                    result.allocs_per_request, result.bytes_per_second / 1e6);
+    }
+
+    auto &parse = results.front();
+    if (max_parse_ns > 0 && parse.ns_per_request > max_parse_ns) {
+        std::cerr << "Regression: parse takes " << parse.ns_per_request
+                  << " ns/request, limit " << max_parse_ns << "\n";
+        return EXIT_FAILURE;
+    }
+    if (max_parse_allocs > 0 && parse.allocs_per_request > max_parse_allocs) {
+        std::cerr << "Regression: parse makes " << parse.allocs_per_request
+                  << " allocations/request, limit " << max_parse_allocs << "\n";
+        return EXIT_FAILURE;
+    }
+    return output_bytes ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Proxy throughput against the number of shards (-n), doubling from 1 up to
+# the given maximum. Runs the binaries of ./build (or $BUILD) against a local
+# upstream_stub; the proxy needs its history database, e.g. `make docker-run`.
+#
+# Usage: bench/shard_scaling.sh [max shards] [requests/s] [seconds]
+
+set -e
+
+BUILD=${BUILD:-build}
+MAX_SHARDS=${1:-$(nproc)}
+RATE=${2:-50000}
+DURATION=${3:-20}
+PROXY_PORT=${PROXY_PORT:-18081}
+STUB_PORT=${STUB_PORT:-19090}
+
+"$BUILD/upstream_stub" -p "$STUB_PORT" -s 4096 -n "$MAX_SHARDS" > /dev/null &
+STUB=$!
+trap 'kill $STUB 2> /dev/null' EXIT
+sleep 1
+
+printf "%6s %12s %10s\n" "shards" "requests/s" "errors"
+shards=1
+while [ "$shards" -le "$MAX_SHARDS" ]; do
+    "$BUILD/http-proxy" -p "$PROXY_PORT" -n "$shards" -v error > /dev/null &
+    PROXY=$!
+    sleep 2
+
+    # The offered rate is far above what the proxy serves, the throughput is
+    # what it completes
+    "$BUILD/proxy_loadgen" -p "$PROXY_PORT" -u "127.0.0.1:$STUB_PORT" -r "$RATE" -d "$DURATION" \
+        -c $((64 * shards)) > /tmp/shard_scaling.out || true
+    sed -n 's/^Throughput: \([0-9]*\) requests\/s.*, \([0-9]*\) errors$/\1 \2/p' /tmp/shard_scaling.out \
+        | { read -r throughput errors; printf "%6d %12s %10s\n" "$shards" "$throughput" "$errors"; }
+
+    kill "$PROXY"
+    wait "$PROXY" 2> /dev/null || true
+    shards=$((shards * 2))
+done
@@ -0,0 +1,307 @@
+#include "tcp_server_lib.hpp"
+#include "proxy_client_lib.hpp"
+#include "include/tls_socket.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <string_view>
+#include <thread>
+
+using namespace bstcp;
+
+struct stub_config_t {
+    size_t  body_size   = 1024;
+    bool    chunked     = false;    // chunked transfer encoding instead of Content-Length
+    size_t  chunk_size  = 4096;
+    long    delay       = 0;        // ms before each response is sent
+    bool    tls         = false;    // TLS with a certificate signed by the test CA
+};
+
+// Body bytes are cut from this block, so a response of any size costs no allocation
+static const size_t body_block_size = 64 * 1024;
+
+// Output is collected and written at once, a response bigger than that goes
+// out in several writes
+static const size_t flush_size = 256 * 1024;
+
+// A connection is served until it is idle for this long, then the server
+// loop polls it again
+static const long idle_timeout = 5;
+
+static std::string_view query_value(std::string_view target, std::string_view name) {
+    auto query = target.find('?');
+    while (query != std::string_view::npos) {
+        auto start = query + 1;
+        auto end = std::min(target.find('&', start), target.size());
+        auto pair = target.substr(start, end - start);
+        if (pair.size() > name.size() && pair.substr(0, name.size()) == name && pair[name.size()] == '=') {
+            return pair.substr(name.size() + 1);
+        }
+        query = end < target.size() ? end : std::string_view::npos;
+    }
+    return {};
+}
+
+static std::string_view header_value(std::string_view head, std::string_view name) {
+    for (size_t pos = head.find("\r\n"); pos != std::string_view::npos; pos = head.find("\r\n", pos + 2)) {
+        auto line = head.substr(pos + 2, head.find("\r\n", pos + 2) - pos - 2);
+        auto colon = line.find(':');
+        if (colon != name.size() || !std::equal(name.begin(), name.end(), line.begin(), [](char a, char b) {
+            return tolower(a) == tolower(b);
+        })) {
+            continue;
+        }
+        auto value = line.substr(colon + 1);
+        return value.substr(std::min(value.find_first_not_of(' '), value.size()));
+    }
+    return {};
+}
+
+class StubClient : public IServerClient {
+  public:
+    StubClient() = delete;
+
+    explicit StubClient(proxy::TcpSocket &&socket)
+            : _socket(std::move(socket))
+              , _tls()
+              , _is_tls(false) {}
+
+    StubClient(const StubClient &) = delete;
+
+    StubClient operator=(const StubClient &) = delete;
+
+    StubClient(StubClient &&clt) noexcept
+            : _socket(std::move(clt._socket))
+              , _tls(std::move(clt._tls))
+              , _is_tls(clt._is_tls)
+              , _input(std::move(clt._input))
+              , _output(std::move(clt._output)) {}
+
+    ~StubClient() override = default;
+
+    static void set_config(stub_config_t config) {
+        config.chunk_size = std::clamp(config.chunk_size, (size_t) 1, body_block_size);
+        _config = config;
+        _body_block.resize(body_block_size);
+        for (size_t i = 0; i < body_block_size; ++i) {
+            _body_block[i] = "0123456789abcdefghijklmnopqrstuvwxyz"[i % 36];
+        }
+    }
+
+    void handle_request() override {
+        if (_config.tls && !_is_tls) {
+            _is_tls = true;
+            if (_tls.init(std::move(_socket), false, "localhost") != status::connected) {
+                _tls.disconnect();
+                return;
+            }
+        }
+
+        // Requests are answered while they keep coming, so a kept-alive
+        // client does not wait for the next round of the server loop
+        char buffer[16 * 1024];
+        while (_io().is_allow_to_read(idle_timeout)) {
+            int size = _io().recv_some(buffer, sizeof(buffer));
+            if (size <= 0) {
+                disconnect();
+                return;
+            }
+            _input.append(buffer, size);
+
+            for (auto head_end = _input.find("\r\n\r\n"); head_end != std::string::npos;
+                 head_end = _input.find("\r\n\r\n")) {
+                auto head = std::string_view(_input).substr(0, head_end);
+                auto length = strtoul(std::string(header_value(head, "Content-Length")).c_str(), nullptr, 10);
+                if (_input.size() < head_end + 4 + length) {
+                    break;
+                }
+
+                bool close = header_value(head, "Connection") == "close";
+                if (!_respond(head)) {
+                    disconnect();
+                    return;
+                }
+                _input.erase(0, head_end + 4 + length);
+                if (close) {
+                    disconnect();
+                    return;
+                }
+            }
+        }
+    }
+
+    [[nodiscard]] uint32_t get_host() const override {
+        return _io().get_host();
+    }
+
+    [[nodiscard]] uint16_t get_port() const override {
+        return _io().get_port();
+    }
+
+    [[nodiscard]] status get_status() const override {
+        return _io().get_status();
+    }
+
+    status disconnect() override {
+        return _io().disconnect();
+    }
+
+    bool recv_from(void *buffer, int size) override {
+        return _io().recv_from(buffer, size);
+    }
+
+    int recv_some(void *buffer, int size) override {
+        return _io().recv_some(buffer, size);
+    }
+
+    bool send_to(const void *buffer, int size) const override {
+        return _io().send_to(buffer, size);
+    }
+
+    [[nodiscard]] SocketType get_type() const override {
+        return SocketType::client_socket;
+    }
+
+    [[nodiscard]] bool is_allow_to_read(long timeout) const override {
+        return _io().is_allow_to_read(timeout);
+    }
+
+    [[nodiscard]] bool is_allow_to_write(long timeout) const override {
+        return _io().is_allow_to_write(timeout);
+    }
+
+    [[nodiscard]] bool is_allow_to_rwrite(long timeout) const override {
+        return _io().is_allow_to_rwrite(timeout);
+    }
+
+  private:
+    proxy::TcpSocket &_io() {
+        return _is_tls ? _tls : _socket;
+    }
+
+    [[nodiscard]] const proxy::TcpSocket &_io() const {
+        return _is_tls ? _tls : _socket;
+    }
+
+    // Query parameters size, chunked and delay override the configured
+    // response for one request
+    bool _respond(std::string_view head) {
+        auto target = head.substr(head.find(' ') + 1);
+        target = target.substr(0, target.find(' '));
+
+        auto size = _config.body_size;
+        auto chunked = _config.chunked;
+        auto delay = _config.delay;
+        if (auto value = query_value(target, "size"); !value.empty()) {
+            size = strtoul(std::string(value).c_str(), nullptr, 10);
+        }
+        if (auto value = query_value(target, "chunked"); !value.empty()) {
+            chunked = value != "0";
+        }
+        if (auto value = query_value(target, "delay"); !value.empty()) {
+            delay = strtol(std::string(value).c_str(), nullptr, 10);
+        }
+        if (delay > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+        }
+
+        bool no_body = head.substr(0, 5) == "HEAD ";
+        _output = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n";
+        _output += chunked ? "Transfer-Encoding: chunked\r\n" : "Content-Length: " + std::to_string(size) + "\r\n";
+        _output += "\r\n";
+
+        for (size_t sent = 0; sent < size && !no_body;) {
+            auto part = std::min({size - sent, chunked ? _config.chunk_size : flush_size, body_block_size});
+            if (chunked) {
+                char prefix[20];
+                auto len = snprintf(prefix, sizeof(prefix), "%zx\r\n", part);
+                _output.append(prefix, len);
+            }
+            _output.append(_body_block, 0, part);
+            if (chunked) {
+                _output += "\r\n";
+            }
+            sent += part;
+            if (_output.size() >= flush_size && !_flush()) {
+                return false;
+            }
+        }
+        if (chunked && !no_body) {
+            _output += "0\r\n\r\n";
+        }
+        return _flush();
+    }
+
+    bool _flush() {
+        bool res = _output.empty() || _io().send_to(_output.data(), (int) _output.size());
+        _output.clear();
+        return res;
+    }
+
+    proxy::TcpSocket    _socket;
+    proxy::SSLSocket    _tls;
+    bool                _is_tls;
+    std::string         _input;
+    std::string         _output;
+
+    static inline stub_config_t _config = {};
+    static inline std::string   _body_block;
+};
+
+int main(int argc, char *argv[]) {
+    uint16_t port = 9090;
+    size_t threads = std::thread::hardware_concurrency();
+    stub_config_t config;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:s:ck:d:tn:")) != -1) {
+        switch (opt) {
+            case 'p':
+                port = (uint16_t) strtoul(optarg, nullptr, 10);
+                break;
+            case 's':
+                config.body_size = strtoul(optarg, nullptr, 10);
+                break;
+            case 'c':
+                config.chunked = true;
+                break;
+            case 'k':
+                config.chunk_size = strtoul(optarg, nullptr, 10);
+                break;
+            case 'd':
+                config.delay = strtol(optarg, nullptr, 10);
+                break;
+            case 't':
+                config.tls = true;
+                break;
+            case 'n':
+                threads = strtoul(optarg, nullptr, 10);
+                break;
+            default:
+                std::cerr << "Usage: " << argv[0]
+                          << " [-p port] [-s body bytes] [-c] [-k chunk bytes] [-d delay ms] [-t] [-n threads]\n";
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (config.tls) {
+        proxy::SSLCert::init("certs", "certs/cert.key");
+    }
+    StubClient::set_config(config);
+
+    TcpServer<proxy::TcpSocket, StubClient> server(port, {1, 1, 1}, TcpServer<proxy::TcpSocket, StubClient>::_default_connsection_handler,
+                                                   TcpServer<proxy::TcpSocket, StubClient>::_default_connsection_handler, threads);
+    if (server.start() != TcpServer<proxy::TcpSocket, StubClient>::ServerStatus::up) {
+        std::cerr << "Server start error! Error code:" << int(server.get_status()) << "\n";
+        return EXIT_FAILURE;
+    }
+
+    std::cout << "Upstream stub listen on port " << port << (config.tls ? " with TLS" : "") << ", body "
+              << config.body_size << " bytes" << (config.chunked ? " chunked" : "") << ", delay " << config.delay
+              << " ms, " << threads << " threads\n";
+    server.joinLoop();
+    return EXIT_SUCCESS;
+}
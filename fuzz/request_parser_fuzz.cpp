@@ -0,0 +1,29 @@
+#include "request_parser_lib.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// libFuzzer entry point: parse, serialize and JSON round-trip arbitrary input
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    static http::Arena arena;
+    std::string input(reinterpret_cast<const char *>(data), size);
+
+    http::Request request;
+    if (!request.parse(input, arena)) {
+        arena.reset();
+        return 0;
+    }
+    arena.reset();
+
+    auto serialized = request.string();
+    size_t touched = request.get_params().size() + request.get_cookies().size();
+
+    http::Request reparsed(serialized);
+    touched += reparsed.string().size();
+
+    http::Request restored;
+    restored.read_json_from_string(request.get_json().dump());
+    touched += restored.string().size();
+    return touched == 0 ? -1 : 0;
+}
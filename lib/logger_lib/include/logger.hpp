@@ -0,0 +1,81 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+namespace logging {
+
+enum class Level : uint8_t {
+    debug   = 0,
+    info    = 1,
+    warning = 2,
+    error   = 3,
+    off     = 4,
+};
+
+struct logger_config_t {
+    Level                       level           = Level::info;
+    size_t                      ring_capacity   = 1024;     // entries buffered per thread
+    size_t                      max_entry_size  = 512;      // longer messages are cut
+    size_t                      sample_every    = 1;        // keep 1 of N debug and info entries
+    std::chrono::milliseconds   flush_interval  = std::chrono::milliseconds(100);
+    std::string                 path;                       // appended to, stdout when empty
+};
+
+struct logger_stats_t {
+    size_t written;     // entries flushed to the output
+    size_t dropped;     // lost because the thread ring was full
+    size_t sampled_out; // skipped by sampling
+    size_t truncated;   // cut to max_entry_size
+};
+
+// Asynchronous logger. log() copies the message parts into a ring owned by
+// the calling thread and returns; a background thread formats the entries of
+// all threads in time order and writes them in batches. The hot path takes no
+// lock and never waits: when a ring is full the entry is dropped and counted.
+class Logger {
+  public:
+    // Applies `config` and starts the flusher; called before the first log()
+    // or the defaults are used
+    static void init(logger_config_t config);
+
+    // Writes out what is buffered and stops the flusher, later entries are
+    // ignored. Also done at exit
+    static void stop();
+
+    static bool enabled(Level level) {
+        return level >= _level.load(std::memory_order_relaxed);
+    }
+
+    // The parts are written one after another as one entry
+    static void log(Level level, std::initializer_list<std::string_view> parts);
+
+    static Level parse_level(std::string_view name, Level fallback = Level::info);
+
+    [[nodiscard]] static logger_stats_t get_stats();
+
+  private:
+    static std::atomic<Level> _level;
+};
+
+inline void debug(std::initializer_list<std::string_view> parts) {
+    Logger::log(Level::debug, parts);
+}
+
+inline void info(std::initializer_list<std::string_view> parts) {
+    Logger::log(Level::info, parts);
+}
+
+inline void warning(std::initializer_list<std::string_view> parts) {
+    Logger::log(Level::warning, parts);
+}
+
+inline void error(std::initializer_list<std::string_view> parts) {
+    Logger::log(Level::error, parts);
+}
+
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+#include "include/logger.hpp"
\ No newline at end of file
@@ -0,0 +1,363 @@
+#include "logger.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using system_clock = std::chrono::system_clock;
+
+static const char* level_names[] = {"DEBUG", "INFO ", "WARN ", "ERROR", "OFF  "};
+
+namespace logging {
+
+struct entry_header_t {
+    system_clock::time_point    time;
+    Level                       level;
+    uint32_t                    size;
+};
+
+// Entries of one thread. Only that thread pushes and only the flusher pops,
+// so the indexes are the whole synchronisation; each side keeps its own
+// cache line
+class Ring {
+  public:
+    Ring(size_t capacity, size_t entry_size, size_t sample_every, uint32_t thread_id)
+            : thread_id(thread_id)
+              , sample_every(std::max(sample_every, (size_t) 1))
+              , _capacity(std::bit_ceil(std::max(capacity, (size_t) 2)))
+              , _entry_size(entry_size)
+              , _stride((sizeof(entry_header_t) + entry_size + alignof(entry_header_t) - 1)
+                        / alignof(entry_header_t) * alignof(entry_header_t))
+              , _data(std::make_unique<char[]>(_capacity * _stride)) {}
+
+    // False when the ring is full
+    bool push(Level level, std::initializer_list<std::string_view> parts, bool &truncated) {
+        auto tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _cached_head >= _capacity) {
+            _cached_head = _head.load(std::memory_order_acquire);
+            if (tail - _cached_head >= _capacity) {
+                return false;
+            }
+        }
+
+        auto slot = _data.get() + (tail & (_capacity - 1)) * _stride;
+        auto text = slot + sizeof(entry_header_t);
+        size_t size = 0;
+        for (auto part: parts) {
+            auto len = std::min(part.size(), _entry_size - size);
+            std::memcpy(text + size, part.data(), len);
+            size += len;
+            if (len < part.size()) {
+                truncated = true;
+                break;
+            }
+        }
+
+        entry_header_t header{system_clock::now(), level, (uint32_t) size};
+        std::memcpy(slot, &header, sizeof(header));
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    template<typename Callable>
+    size_t drain(Callable &&callback) {
+        auto head = _head.load(std::memory_order_relaxed);
+        auto tail = _tail.load(std::memory_order_acquire);
+        for (auto pos = head; pos != tail; ++pos) {
+            auto slot = _data.get() + (pos & (_capacity - 1)) * _stride;
+            entry_header_t header;
+            std::memcpy(&header, slot, sizeof(header));
+            callback(header, std::string_view(slot + sizeof(entry_header_t), header.size));
+        }
+        _head.store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    [[nodiscard]] size_t size() const {
+        return _tail.load(std::memory_order_relaxed) - _head.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] size_t get_capacity() const {
+        return _capacity;
+    }
+
+    const uint32_t      thread_id;
+    const size_t        sample_every;
+    size_t              sample_counter = 0;     // owner thread only
+
+    // Written by the owner thread only
+    std::atomic<size_t> dropped{0};
+    std::atomic<size_t> sampled_out{0};
+    std::atomic<size_t> truncated{0};
+
+    std::atomic<bool>   closed{false};          // the owner thread has exited
+
+  private:
+    const size_t            _capacity;
+    const size_t            _entry_size;
+    const size_t            _stride;
+    std::unique_ptr<char[]> _data;
+
+    alignas(64) std::atomic<size_t> _head{0};
+    alignas(64) std::atomic<size_t> _tail{0};
+    size_t                          _cached_head = 0;
+};
+
+struct logger_state_t {
+    std::mutex                          mutex;
+    std::condition_variable             wake;
+    logger_config_t                     config;
+    std::vector<std::shared_ptr<Ring>>  rings;
+    std::thread                         flusher;
+    FILE                               *out = stdout;
+    bool                                running = false;
+    bool                                stopped = false;
+    bool                                at_exit = false;
+    uint32_t                            next_thread_id = 1;
+    logger_stats_t                      retired = {};   // counters of rings already removed
+    std::atomic<size_t>                 written{0};
+    std::atomic<bool>                   wake_requested{false};
+};
+
+// Never destroyed: threads of the pool may still log while statics are
+// destroyed at exit
+static logger_state_t &state() {
+    static auto *instance = new logger_state_t();
+    return *instance;
+}
+
+std::atomic<Level> Logger::_level = Level::info;
+
+static void add_stats(logger_stats_t &stats, const Ring &ring) {
+    stats.dropped += ring.dropped.load(std::memory_order_relaxed);
+    stats.sampled_out += ring.sampled_out.load(std::memory_order_relaxed);
+    stats.truncated += ring.truncated.load(std::memory_order_relaxed);
+}
+
+// Takes every buffered entry, formats them in time order and writes them at once
+static void drain_rings(logger_state_t &st, const std::vector<std::shared_ptr<Ring>> &rings, std::string &batch) {
+    struct pending_t {
+        system_clock::time_point    time;
+        Level                       level;
+        uint32_t                    thread_id;
+        size_t                      offset;
+        size_t                      size;
+    };
+    std::vector<pending_t> pending;
+    std::string texts;
+
+    for (auto &ring: rings) {
+        ring->drain([&](const entry_header_t &header, std::string_view text) {
+            pending.push_back({header.time, header.level, ring->thread_id, texts.size(), text.size()});
+            texts.append(text);
+        });
+    }
+    if (pending.empty()) {
+        return;
+    }
+    std::stable_sort(pending.begin(), pending.end(), [](const pending_t &a, const pending_t &b) {
+        return a.time < b.time;
+    });
+
+    batch.clear();
+    time_t last_second = -1;
+    char second_text[32] = {};
+    for (auto &entry: pending) {
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(entry.time.time_since_epoch()).count();
+        auto second = (time_t) (us / 1000000);
+        if (second != last_second) {
+            last_second = second;
+            tm parts{};
+            localtime_r(&second, &parts);
+            strftime(second_text, sizeof(second_text), "%Y-%m-%d %H:%M:%S", &parts);
+        }
+
+        char prefix[96];
+        auto len = snprintf(prefix, sizeof(prefix), "%s.%06lld %s [%u] ", second_text, (long long) (us % 1000000),
+                            level_names[(size_t) entry.level], entry.thread_id);
+        batch.append(prefix, len);
+        batch.append(texts, entry.offset, entry.size);
+        batch += '\n';
+    }
+
+    fwrite(batch.data(), 1, batch.size(), st.out);
+    fflush(st.out);
+    st.written.fetch_add(pending.size(), std::memory_order_relaxed);
+}
+
+static void flush_loop() {
+    auto &st = state();
+    std::string batch;
+
+    std::unique_lock<std::mutex> lck(st.mutex);
+    while (st.running) {
+        st.wake.wait_for(lck, st.config.flush_interval, [&st] {
+            return !st.running || st.wake_requested.load(std::memory_order_relaxed);
+        });
+        st.wake_requested.store(false, std::memory_order_relaxed);
+
+        auto rings = st.rings;
+        lck.unlock();
+        drain_rings(st, rings, batch);
+        lck.lock();
+
+        // A ring of a finished thread is dropped once it is empty
+        std::erase_if(st.rings, [&st](const std::shared_ptr<Ring> &ring) {
+            if (!ring->closed.load(std::memory_order_acquire) || ring->size() != 0) {
+                return false;
+            }
+            add_stats(st.retired, *ring);
+            return true;
+        });
+    }
+}
+
+static void start_locked(logger_state_t &st) {
+    if (!st.at_exit) {
+        st.at_exit = true;
+        std::atexit(Logger::stop);
+    }
+    st.running = true;
+    st.stopped = false;
+    st.flusher = std::thread(flush_loop);
+}
+
+static Ring *local_ring() {
+    struct owner_t {
+        std::shared_ptr<Ring> ring;
+
+        ~owner_t() {
+            if (ring) {
+                ring->closed.store(true, std::memory_order_release);
+            }
+        }
+    };
+    thread_local owner_t owner;
+
+    if (!owner.ring) {
+        auto &st = state();
+        std::lock_guard<std::mutex> lck(st.mutex);
+        if (!st.running) {
+            if (st.stopped) {
+                return nullptr;
+            }
+            start_locked(st);
+        }
+        owner.ring = std::make_shared<Ring>(st.config.ring_capacity, st.config.max_entry_size,
+                                            st.config.sample_every, st.next_thread_id++);
+        st.rings.push_back(owner.ring);
+    }
+    return owner.ring.get();
+}
+
+void Logger::init(logger_config_t config) {
+    stop();
+
+    auto &st = state();
+    std::lock_guard<std::mutex> lck(st.mutex);
+    if (st.out != stdout) {
+        fclose(st.out);
+        st.out = stdout;
+    }
+    if (!config.path.empty()) {
+        if (auto file = fopen(config.path.c_str(), "a")) {
+            st.out = file;
+        } else {
+            fprintf(stderr, "Can't open log file %s, logging to stdout\n", config.path.c_str());
+        }
+    }
+
+    st.config = std::move(config);
+    _level.store(st.config.level, std::memory_order_relaxed);
+    start_locked(st);
+}
+
+void Logger::stop() {
+    auto &st = state();
+    std::unique_lock<std::mutex> lck(st.mutex);
+    if (!st.running) {
+        return;
+    }
+    st.running = false;
+    st.stopped = true;
+    lck.unlock();
+
+    st.wake.notify_all();
+    st.flusher.join();
+
+    lck.lock();
+    std::string batch;
+    drain_rings(st, st.rings, batch);
+    _level.store(Level::off, std::memory_order_relaxed);
+}
+
+void Logger::log(Level level, std::initializer_list<std::string_view> parts) {
+    if (!enabled(level)) {
+        return;
+    }
+    auto ring = local_ring();
+    if (!ring) {
+        return;
+    }
+
+    // Warnings and errors are never sampled
+    if (level < Level::warning && ring->sample_every > 1 && ring->sample_counter++ % ring->sample_every != 0) {
+        ring->sampled_out.store(ring->sampled_out.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+
+    bool truncated = false;
+    if (!ring->push(level, parts, truncated)) {
+        ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return;
+    }
+    if (truncated) {
+        ring->truncated.store(ring->truncated.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // A burst is written out before the ring fills up
+    if (ring->size() >= ring->get_capacity() / 2) {
+        auto &st = state();
+        if (!st.wake_requested.load(std::memory_order_relaxed)
+            && !st.wake_requested.exchange(true, std::memory_order_relaxed)) {
+            st.wake.notify_one();
+        }
+    }
+}
+
+Level Logger::parse_level(std::string_view name, Level fallback) {
+    static const std::pair<std::string_view, Level> names[] = {
+            {"debug", Level::debug},
+            {"info", Level::info},
+            {"warning", Level::warning},
+            {"error", Level::error},
+            {"off", Level::off},
+    };
+    for (auto &[text, level]: names) {
+        if (text == name) {
+            return level;
+        }
+    }
+    return fallback;
+}
+
+logger_stats_t Logger::get_stats() {
+    auto &st = state();
+    std::lock_guard<std::mutex> lck(st.mutex);
+    auto stats = st.retired;
+    for (auto &ring: st.rings) {
+        add_stats(stats, *ring);
+    }
+    stats.written = st.written.load(std::memory_order_relaxed);
+    return stats;
+}
+
+}
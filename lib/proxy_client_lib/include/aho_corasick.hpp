@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace proxy {
+
+// Multi-pattern matcher: all patterns are compiled into one DFA, so a text is
+// checked for every pattern in a single pass, chunk by chunk if it arrives in
+// parts.
+class AhoCorasick {
+  public:
+    static constexpr int no_match = -1;
+
+    // Position in the automaton carried from one chunk of a stream to the next
+    struct state_t {
+        uint32_t node = 0;
+    };
+
+    AhoCorasick() : AhoCorasick(std::vector<std::string>()) {}
+
+    explicit AhoCorasick(const std::vector<std::string> &patterns);
+
+    // Returns the index of the first pattern that ends in `data`, or no_match
+    int feed(state_t &state, std::string_view data) const;
+
+    [[nodiscard]] int find(std::string_view data) const;
+
+    [[nodiscard]] size_t get_nodes_count() const;
+
+  private:
+    std::vector<std::array<uint32_t, 256>>  _next;
+    std::vector<int>                        _output;    // pattern ending here or at a suffix
+};
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "tcp_server_lib.hpp"
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace proxy {
+
+struct dns_stats_t {
+    size_t hits;
+    size_t misses;      // looked up with getaddrinfo
+};
+
+// Addresses of upstream hosts kept for `ttl` after a lookup. Failed lookups
+// are not kept. When full, expired entries are dropped, or everything if
+// none has expired yet.
+class DnsCache {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    explicit DnsCache(std::chrono::seconds ttl = std::chrono::seconds(30), size_t capacity = 4096);
+
+    DnsCache(const DnsCache &) = delete;
+    DnsCache &operator=(const DnsCache &) = delete;
+
+    // Every address of `host` in the order to try them (see
+    // bstcp::resolve_host), false when it can't be resolved
+    bool resolve(const std::string &host, std::vector<bstcp::endpoint_t> *endpoints);
+
+    // Only looks in the cache, false when `host` isn't there; a miss is
+    // counted by the resolve() that follows
+    bool find(const std::string &host, std::vector<bstcp::endpoint_t> *endpoints);
+
+    [[nodiscard]] dns_stats_t get_stats() const;
+
+  private:
+    struct entry_t {
+        std::vector<bstcp::endpoint_t>  endpoints;
+        clock::time_point               expires;
+    };
+
+    std::chrono::seconds                        _ttl;
+    size_t                                      _capacity;
+
+    mutable std::mutex                          _mutex;
+    std::unordered_map<std::string, entry_t>    _entries;
+    dns_stats_t                                 _stats;
+};
+
+}
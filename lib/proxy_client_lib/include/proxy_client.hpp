@@ -1,28 +1,52 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
 #include <ostream>
 
 #include "tcp_server_lib.hpp"
 #include "tcp_socket.hpp"
+#include "upstream_pool.hpp"
+#include "dns_cache.hpp"
+#include "response_reader.hpp"
+#include "scan_corpus.hpp"
+#include "proxy_metrics.hpp"
 #include "repository_lib.hpp"
 
 namespace proxy {
 
 struct request_t;
 
+struct search_config_t {
+    size_t  concurrency         = 8;    // probes of one /search in flight at once
+    long    read_timeout        = 2000; // ms to wait for each part of a response
+    size_t  max_idle_per_host   = 8;    // kept-alive upstream connections
+    size_t  excerpt_size        = 512;  // bytes of a matching response put in the report
+    size_t  max_replay          = 10000;// stored requests one batch /repeat may replay
+
+    // Payloads and signatures file (see scan/injections.txt), empty for the
+    // built-in ones
+    std::string corpus_path;
+};
+
 class ProxyClient : public bstcp::IServerClient {
   public:
     ProxyClient() = delete;
 
     explicit ProxyClient(TcpSocket &&socket)
-            : _socket(std::move(socket)) {}
+            : _socket(std::move(socket))
+              , _accepted_at(ProxyMetrics::clock::now())
+              , _got_first_byte(false) {}
 
     ProxyClient(const ProxyClient &) = delete;
 
     ProxyClient operator=(const ProxyClient &) = delete;
 
     ProxyClient(ProxyClient &&clt) noexcept
-            : _socket(std::move(clt._socket)) {}
+            : _socket(std::move(clt._socket))
+              , _arena(std::move(clt._arena))
+              , _accepted_at(clt._accepted_at)
+              , _got_first_byte(clt._got_first_byte) {}
 
     ProxyClient &operator=(const ProxyClient &&) = delete;
 
@@ -30,6 +54,10 @@ class ProxyClient : public bstcp::IServerClient {
 
     void handle_request() override;
 
+    // handle_request() as a coroutine on the event loop of the server: the
+    // sockets are waited on `loop`, the service routes run on its helper threads
+    bstcp::Task<void> handle_request_async(bstcp::EventLoop &loop);
+
     [[nodiscard]] uint32_t get_host() const override;
 
     [[nodiscard]] uint16_t get_port() const override;
@@ -40,6 +68,8 @@ class ProxyClient : public bstcp::IServerClient {
 
     bool recv_from(void *buffer, int size) override;
 
+    int recv_some(void *buffer, int size) override;
+
     bool send_to(const void *buffer, int size) const override;
 
     [[nodiscard]] SocketType get_type() const override;
@@ -54,7 +84,25 @@ class ProxyClient : public bstcp::IServerClient {
 
     [[nodiscard]] bool is_allow_to_rwrite(long timeout) const override;
 
-    static void set_repository(const std::string& conn_string);
+    static void set_repository(const std::string& conn_string, rp::recorder_config_t config = {},
+                               rp::retention_config_t retention = {});
+
+    static rp::recorder_metrics_t get_recorder_metrics();
+
+    static void set_search_config(search_config_t config);
+
+    // Upstream connects race the addresses of the host with these timeouts
+    static void set_connect_config(bstcp::connect_config_t config);
+
+    // Gives every server shard its own upstream connections and DNS cache,
+    // called before the server starts
+    static void set_shard_count(size_t count);
+
+    static upstream_stats_t get_upstream_stats();
+
+    static dns_stats_t get_dns_stats();
+
+    [[nodiscard]] http::arena_stats_t get_arena_stats() const;
 
   private:
     static std::string _read_from_socket(bstcp::ISocket &socket, size_t chank_size);
@@ -63,15 +111,52 @@ class ProxyClient : public bstcp::IServerClient {
 
     static std::string _init_client_socket(const std::string& host, size_t port, TcpSocket &socket);
 
-    static std::string _parse_not_proxy_request(http::Request& req);
+    static bool _send_chunk(bstcp::ISocket &socket, std::string_view data);
+
+    static std::string _parse_not_proxy_request(http::Request& req, bstcp::ISocket &client);
+
+    // Streams the list straight to `client` with chunked transfer encoding
+    static std::string _get_list(http::Request& req, bstcp::ISocket &client);
+
+    static std::string _get_metrics();
 
-    static std::string _get_list(http::Request& req);
+    // Sends a stored request over a pooled upstream connection
+    // `on_attempt` is called before each try so that `on_data` starts over
+    // when a dead kept-alive connection made the request go out again
+    static std::string _resend_request(const rp::request_t& req, const response_handler_t& on_data = {},
+                                       const std::function<void()>& on_attempt = {});
 
-    static std::string _resend_request(rp::request_t& req);
+    struct probe_result_t {
+        std::string                 response;
+        int                         signature;  // index of the matched signature or AhoCorasick::no_match
+        std::chrono::milliseconds   latency;
+    };
+
+    // Gets each probe as soon as it is done, one call at a time; returning
+    // false cancels the probes that are not sent yet
+    using probe_handler_t = std::function<bool(size_t index, probe_result_t& result)>;
+
+    // Sends every request with at most `concurrency` in flight and matches the
+    // responses against the corpus signatures while they are read. False if
+    // `on_done` cancelled the rest
+    static bool _send_probes(const std::vector<rp::request_t>& requests, size_t concurrency,
+                             const probe_handler_t& on_done);
+
+    // Runs task(0) .. task(count - 1) on the helper threads of the shard with at
+    // most `concurrency` at once and waits for them. `before_start(i)` is called
+    // on the calling thread before task i is queued, false stops the rest
+    static void _run_on_helpers(size_t count, size_t concurrency, const std::function<void(size_t)>& task,
+                                const std::function<bool(size_t)>& before_start);
 
     static std::string _repeat_request(http::Request& req);
 
-    static std::string _search_vulnerability(http::Request& req);
+    // Replays the requests given by `ids` or `from` and `to` with at most
+    // `concurrency` in flight and `rate` started per second, reports latency
+    // percentiles and status codes instead of the responses
+    static std::string _repeat_batch(http::Request& req);
+
+    // Streams a line per probe to `client` with chunked transfer encoding
+    static std::string _search_vulnerability(http::Request& req, bstcp::ISocket &client);
 
     std::string _parse_proxy_request(http::Request& req);
 
@@ -81,9 +166,65 @@ class ProxyClient : public bstcp::IServerClient {
 
     std::string _https_request(request_t &request);
 
+    // Coroutine versions of the above, resumed on the loop thread only
+    static bstcp::Task<std::string> _read_from_socket_async(bstcp::AsyncSocket &socket, size_t chank_size);
+
+    static bstcp::Task<std::string> _init_client_socket_async(bstcp::EventLoop &loop, const std::string& host,
+                                                              size_t port, TcpSocket &socket);
+
+    // Records on the loop thread while the queue has room, the overflow
+    // policy may wait or write the spool and runs on a helper thread
+    static bstcp::Task<bool> _record_async(bstcp::EventLoop &loop, rp::request_t req);
+
+    bstcp::Task<std::string> _parse_request_async(bstcp::EventLoop &loop, std::string &data);
+
+    bstcp::Task<std::string> _http_request_async(bstcp::EventLoop &loop, request_t &request);
+
+    bstcp::Task<std::string> _https_request_async(bstcp::EventLoop &loop, request_t &request);
+
     TcpSocket _socket;
 
+    // Request-scoped parse state, reset once the request is handled
+    http::Arena _arena;
+
+    ProxyMetrics::clock::time_point _accepted_at;
+    bool                            _got_first_byte;
+
     static std::unique_ptr<rp::PQStoreRequest> _rep;
+
+    static std::unique_ptr<rp::HistoryRecorder> _recorder;
+
+    static std::unique_ptr<rp::HistoryRetention> _retention;
+
+    static search_config_t _search_config;
+
+    static bstcp::connect_config_t _connect_config;
+
+    static ScanCorpus _corpus;
+
+    // Threads of a shard sending probes and replays; a batch /repeat has at
+    // most as many requests in flight
+    static constexpr size_t max_helper_threads = 256;
+
+    // State of one server shard, only used by the threads of that shard
+    struct shard_state_t {
+        explicit shard_state_t(const search_config_t &config)
+                : upstreams(&ProxyClient::_init_client_socket, config.max_idle_per_host)
+                  , dns()
+                  , helpers() {
+            helpers.set_min_threads(config.concurrency);
+            helpers.set_max_threads(max_helper_threads);
+        }
+
+        UpstreamPool    upstreams;
+        DnsCache        dns;
+        prll::Parallel  helpers;    // a /search keeps `concurrency` of them busy
+    };
+
+    // State of the shard of the calling thread
+    static shard_state_t &_shard();
+
+    static std::vector<std::unique_ptr<shard_state_t>> _shards;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace proxy {
+
+// Stages timed for every proxied request
+enum class Stage : size_t {
+    first_byte,         // accept to the first byte of the request
+    parse,
+    db_record,          // handing the request to the history recorder
+    dns,
+    upstream_connect,
+    client_tls,         // handshake with the client after CONNECT
+    upstream_tls,
+    upstream_ttfb,      // request sent to the first byte of the answer
+    total,
+    count
+};
+
+enum class ErrorKind : size_t {
+    bad_request,
+    dns,
+    connect,
+    tls,
+    timeout,
+    db,
+    other,
+    count
+};
+
+// Log2 buckets of microseconds, bucket i counts times below 2^i us; the last
+// one takes everything longer (about a minute)
+static const size_t metrics_buckets = 27;
+
+// Request counters and stage histograms. Every thread writes its own block
+// without locks or shared cache lines; blocks are only summed by render()
+class ProxyMetrics {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    static void observe(Stage stage, clock::duration time);
+
+    static void count_request();
+
+    static void count_error(ErrorKind kind);
+
+    static void add_bytes_in(size_t bytes);
+
+    static void add_bytes_out(size_t bytes);
+
+    // Addresses tried to connect one upstream and how many of them failed
+    static void count_connect(size_t attempts, size_t failed);
+
+    static void connection_accepted();
+
+    static void connection_closed();
+
+    // Error kind of an error response built by the proxy itself, by status
+    static ErrorKind error_kind(int status);
+
+    // Everything in the Prometheus text format
+    static std::string render();
+
+  private:
+    enum class Counter : size_t {
+        requests,
+        bytes_in,
+        bytes_out,
+        connect_attempts,
+        connect_failed,
+        count
+    };
+
+    struct thread_block_t;
+
+    static thread_block_t &_local();
+
+    // Blocks outlive their threads: a finished thread gives its block to the
+    // next new one, so nothing counted is lost
+    static std::mutex                                   _blocks_mutex;
+    static std::deque<std::unique_ptr<thread_block_t>>  _blocks;
+
+    static std::atomic<uint64_t> _accepted;
+    static std::atomic<int64_t>  _active;
+};
+
+// Observes the time from its creation to stop() for `stage`
+class StageTimer {
+  public:
+    explicit StageTimer(Stage stage)
+            : _stage(stage)
+              , _start(ProxyMetrics::clock::now()) {}
+
+    void stop() const {
+        ProxyMetrics::observe(_stage, ProxyMetrics::clock::now() - _start);
+    }
+
+  private:
+    Stage                           _stage;
+    ProxyMetrics::clock::time_point _start;
+};
+
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "tcp_server_lib.hpp"
+
+#include <functional>
+#include <string>
+#include <string_view>
+
+namespace proxy {
+
+struct upstream_response_t {
+    std::string data;
+    int         status      = 0;
+    bool        complete    = false;    // the whole message was read
+    bool        keep_alive  = false;    // the connection can carry the next request
+    bool        stopped     = false;    // on_data asked to stop before the end
+};
+
+// Gets every part of a response as it arrives, returns false to stop reading
+using response_handler_t = std::function<bool(std::string_view data)>;
+
+// Reads one HTTP response framed by Content-Length or chunked transfer
+// encoding, or by the end of the connection when it has neither. Returns as
+// soon as the message is complete instead of waiting for the socket to go
+// quiet. `timeout` is the longest wait for each read in ms; `no_body` is set
+// for responses to HEAD. A response stopped by `on_data` leaves the connection
+// in the middle of a message, so it is never kept alive.
+upstream_response_t read_response(bstcp::ISocket &socket, long timeout, bool no_body = false,
+                                  const response_handler_t &on_data = {});
+
+}
\ No newline at end of file
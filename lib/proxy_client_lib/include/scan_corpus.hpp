@@ -0,0 +1,38 @@
+#pragma once
+
+#include "aho_corasick.hpp"
+
+#include <string>
+#include <vector>
+
+namespace proxy {
+
+// Payloads injected by /search and the signatures that reveal a successful
+// injection in a response.
+class ScanCorpus {
+  public:
+    // The payloads and the signature the scanner started with
+    ScanCorpus();
+
+    ScanCorpus(std::vector<std::string> payloads, std::vector<std::string> signatures);
+
+    // Reads a corpus file with one entry per line:
+    //   payload <text>
+    //   signature <text>
+    // Lines starting with '#' are comments; \r, \n, \t, \\ and \xHH escapes
+    // are allowed in the text. Returns false and keeps `corpus` on error.
+    static bool load(const std::string &path, ScanCorpus &corpus);
+
+    [[nodiscard]] const std::vector<std::string> &get_payloads() const;
+
+    [[nodiscard]] const std::vector<std::string> &get_signatures() const;
+
+    [[nodiscard]] const AhoCorasick &get_matcher() const;
+
+  private:
+    std::vector<std::string>    _payloads;
+    std::vector<std::string>    _signatures;
+    AhoCorasick                 _matcher;
+};
+
+}
@@ -4,6 +4,7 @@
 #include <openssl/err.h>
 
 #include <string>
+#include <string_view>
 
 namespace proxy {
 class SSLCert {
@@ -22,6 +23,9 @@ class SSLCert {
 
     static bool clear_cert_dir();
 
+    // Logs and clears the OpenSSL error queue of the calling thread
+    static void log_errors(std::string_view context);
+
   private:
     static bool file_cert(SSL_CTX *cert, const std::string &domain);
 
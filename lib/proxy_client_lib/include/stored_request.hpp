@@ -0,0 +1,17 @@
+#pragma once
+
+#include "repository_lib.hpp"
+
+#include <functional>
+#include <string>
+
+namespace proxy {
+
+// Gets a stored request by its id; is_valid is false when there is none
+using request_lookup_t = std::function<rp::request_t(size_t id)>;
+
+// Looks up request `id` into `res`. Empty on success, otherwise the response
+// to send instead: 404 for an unknown id, 500 when the lookup threw
+std::string load_stored_request(size_t id, const request_lookup_t &lookup, rp::request_t &res);
+
+}
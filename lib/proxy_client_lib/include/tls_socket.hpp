@@ -24,7 +24,13 @@ class SSLSocket : public TcpSocket {
 
     SSLSocket &operator=(SSLSocket &&sok) noexcept;
 
-    bstcp::status init(TcpSocket &&base_socket, bool client = true, std::string domain = "");
+    // Waits at most `timeout` ms for each step of the handshake
+    bstcp::status init(TcpSocket &&base_socket, bool client = true, std::string domain = "", long timeout = 5000);
+
+    // init() for a non-blocking socket: the handshake waits on `loop`, at
+    // most `timeout` ms for each step
+    bstcp::Task<bstcp::status> init_async(bstcp::EventLoop &loop, TcpSocket &&base_socket, long timeout,
+                                          bool client = true, std::string domain = "");
 
     ~SSLSocket() override;
 
@@ -32,11 +38,33 @@ class SSLSocket : public TcpSocket {
 
     bool recv_from(void *buffer, int size) override;
 
+    int recv_some(void *buffer, int size) override;
+
     bool send_to(const void *buffer, int size) const override;
 
+    int send_some(const void *buffer, int size) override;
+
+    [[nodiscard]] int get_pending() const override;
+
+    // Also true when OpenSSL holds decrypted data the socket no longer shows
+    [[nodiscard]] bool is_allow_to_read(long timeout) const override;
+
     TcpSocket release();
 
   private:
+    enum class handshake_t : uint8_t {
+        done,
+        want_read,
+        want_write,
+        failed,
+    };
+
+    // Takes the socket and sets up the session, connected when the handshake can start
+    bstcp::status _prepare(TcpSocket &&base_socket, bool client, const std::string &domain);
+
+    handshake_t _handshake();
+
+    bstcp::status _finish_handshake(handshake_t result);
 
     void _clear_ssl();
 
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "tcp_socket.hpp"
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace proxy {
+
+struct upstream_stats_t {
+    size_t connects;    // connections opened (with the TLS handshake for https)
+    size_t reused;      // requests sent over an idle connection
+    size_t discarded;   // idle connections found closed by the server
+    size_t idle;
+};
+
+// Keep-alive connections to upstream servers, shared by the routes that replay
+// stored requests. A connection is taken for one request/response exchange and
+// given back only when the response was read completely and allows reuse.
+class UpstreamPool {
+  public:
+    // Opens a plain connection, returns an HTTP error response on failure
+    using connector_t = std::function<std::string(const std::string &host, size_t port, TcpSocket &socket)>;
+
+    explicit UpstreamPool(connector_t connector, size_t max_idle_per_host = 8);
+
+    UpstreamPool(const UpstreamPool &) = delete;
+    UpstreamPool &operator=(const UpstreamPool &) = delete;
+
+    // Returns an idle connection (`reused` is set) or opens a new one; on
+    // failure returns nullptr and puts the HTTP error response into `error`
+    std::unique_ptr<TcpSocket> acquire(const std::string &host, size_t port, bool is_https,
+                                       bool &reused, std::string &error);
+
+    void release(const std::string &host, size_t port, bool is_https, std::unique_ptr<TcpSocket> socket);
+
+    void set_max_idle_per_host(size_t max_idle_per_host);
+
+    [[nodiscard]] upstream_stats_t get_stats() const;
+
+  private:
+    using key_t = std::tuple<std::string, size_t, bool>;
+
+    connector_t                                                 _connector;
+    size_t                                                      _max_idle_per_host;
+
+    mutable std::mutex                                          _mutex;
+    std::map<key_t, std::vector<std::unique_ptr<TcpSocket>>>    _idle;
+    upstream_stats_t                                            _stats;
+};
+
+}
@@ -0,0 +1,86 @@
+#include "aho_corasick.hpp"
+
+#include <queue>
+
+static const uint32_t no_node = UINT32_MAX;
+
+namespace proxy {
+
+AhoCorasick::AhoCorasick(const std::vector<std::string> &patterns)
+        : _next(1)
+          , _output(1, no_match) {
+    _next[0].fill(no_node);
+
+    // Trie of all patterns
+    for (size_t i = 0; i < patterns.size(); ++i) {
+        if (patterns[i].empty()) {
+            continue;
+        }
+        uint32_t node = 0;
+        for (unsigned char c: patterns[i]) {
+            if (_next[node][c] == no_node) {
+                _next[node][c] = (uint32_t) _next.size();
+                _next.emplace_back().fill(no_node);
+                _output.push_back(no_match);
+            }
+            node = _next[node][c];
+        }
+        if (_output[node] == no_match) {
+            _output[node] = (int) i;
+        }
+    }
+
+    // Breadth-first pass turns the trie into a DFA: a missing edge goes where
+    // the failure link (longest proper suffix in the trie) would go
+    std::vector<uint32_t> fail(_next.size(), 0);
+    std::queue<uint32_t> queue;
+    for (auto &next: _next[0]) {
+        if (next == no_node) {
+            next = 0;
+        } else {
+            queue.push(next);
+        }
+    }
+
+    while (!queue.empty()) {
+        auto node = queue.front();
+        queue.pop();
+        if (_output[node] == no_match) {
+            _output[node] = _output[fail[node]];
+        }
+
+        for (size_t c = 0; c < 256; ++c) {
+            auto &next = _next[node][c];
+            if (next == no_node) {
+                next = _next[fail[node]][c];
+            } else {
+                fail[next] = _next[fail[node]][c];
+                queue.push(next);
+            }
+        }
+    }
+}
+
+int AhoCorasick::feed(state_t &state, std::string_view data) const {
+    auto node = state.node;
+    for (unsigned char c: data) {
+        node = _next[node][c];
+        if (_output[node] != no_match) {
+            state.node = node;
+            return _output[node];
+        }
+    }
+    state.node = node;
+    return no_match;
+}
+
+int AhoCorasick::find(std::string_view data) const {
+    state_t state;
+    return feed(state, data);
+}
+
+size_t AhoCorasick::get_nodes_count() const {
+    return _next.size();
+}
+
+}
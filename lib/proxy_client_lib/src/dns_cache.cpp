@@ -0,0 +1,55 @@
+#include "dns_cache.hpp"
+
+namespace proxy {
+
+DnsCache::DnsCache(std::chrono::seconds ttl, size_t capacity)
+        : _ttl(ttl)
+          , _capacity(capacity)
+          , _entries()
+          , _stats() {}
+
+bool DnsCache::resolve(const std::string &host, std::vector<bstcp::endpoint_t> *endpoints) {
+    if (find(host, endpoints)) {
+        return true;
+    }
+    auto now = clock::now();
+    {
+        std::lock_guard<std::mutex> lck(_mutex);
+        _stats.misses++;
+    }
+
+    // The lookup is slow, other hosts are served meanwhile
+    if (bstcp::resolve_host(host.c_str(), endpoints) == -1) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lck(_mutex);
+    if (_entries.size() >= _capacity) {
+        std::erase_if(_entries, [now](const auto &entry) {
+            return entry.second.expires <= now;
+        });
+        if (_entries.size() >= _capacity) {
+            _entries.clear();
+        }
+    }
+    _entries[host] = {*endpoints, now + _ttl};
+    return true;
+}
+
+bool DnsCache::find(const std::string &host, std::vector<bstcp::endpoint_t> *endpoints) {
+    std::lock_guard<std::mutex> lck(_mutex);
+    auto it = _entries.find(host);
+    if (it == _entries.end() || it->second.expires <= clock::now()) {
+        return false;
+    }
+    *endpoints = it->second.endpoints;
+    _stats.hits++;
+    return true;
+}
+
+dns_stats_t DnsCache::get_stats() const {
+    std::lock_guard<std::mutex> lck(_mutex);
+    return _stats;
+}
+
+}
@@ -1,83 +1,371 @@
 #include "proxy_client.hpp"
-#include "tls_socket.hpp"
+#include "response_reader.hpp"
+#include "stored_request.hpp"
+#include "logger_lib.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <exception>
-#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
 
 const char* get_list_requests = "/list";
 const char* repeat_requests = "/repeat";
 const char* search_vulnerability_requests = "/search";
-
-const char* injection_1 = ";cat /etc/passwd;";
-const char* injection_2 = "|cat /etc/passwd|";
-const char* injection_3 = "`cat /etc/passwd`";
-const char* syndrom_injection = "root:";
+const char* metrics_requests = "/metrics";
 
 const char* limit_param = "limit";
+const char* after_id_param = "after_id";
 const char* id_param = "id";
+const char* ids_param = "ids";
+const char* from_param = "from";
+const char* to_param = "to";
+const char* concurrency_param = "concurrency";
+const char* rate_param = "rate";
+
+// Rows fetched from the history cursor at once and bytes collected before a
+// chunk is sent: together they bound the memory of a /list of any length
+const size_t list_fetch_rows = 64;
+const size_t list_chunk_size = 16 * 1024;
+
+const char* list_headers = "HTTP/1.1 200 OK\r\n"
+                           "Content-Type: text/plain\r\n"
+                           "Transfer-Encoding: chunked\r\n"
+                           "Trailer: X-Last-Id\r\n"
+                           "\r\n";
+
+const char* search_headers = "HTTP/1.1 200 OK\r\n"
+                             "Content-Type: text/plain\r\n"
+                             "Transfer-Encoding: chunked\r\n"
+                             "\r\n";
 
 const size_t client_chank_size = 1024;
-const size_t server_chank_size = 20000;
+
+// Part of `response` around the first `signature`, at most `size` bytes
+static std::string_view excerpt(std::string_view response, std::string_view signature, size_t size) {
+    if (response.size() <= size) {
+        return response;
+    }
+    auto pos = response.find(signature);
+    if (pos == std::string_view::npos || pos < size / 2) {
+        return response.substr(0, size);
+    }
+    return response.substr(std::min(pos - size / 2, response.size() - size), size);
+}
 
 namespace proxy {
-    std::string ProxyClient::_get_list(http::Request& req) {
+    std::string ProxyClient::_get_list(http::Request& req, bstcp::ISocket &client) {
         auto param = req.get_param(limit_param);
         size_t limit = 0;
         if (param.empty()) {
             limit = 10;
         } else {
-            limit = strtol(param.data(), nullptr, 10);
-            if (limit <= 0) {
+            auto value = strtoll(param.data(), nullptr, 10);
+            if (value <= 0) {
                 return "HTTP/1.1 400 Bad request  \n Not allow limit \n\n";
             }
+            limit = value;
         }
-        std::vector <rp::request_t> list;
+
+        // Keyset pagination: the next page starts after the last id of this one
+        param = req.get_param(after_id_param);
+        size_t after_id = 0;
+        if (!param.empty()) {
+            auto value = strtoll(param.data(), nullptr, 10);
+            if (value < 0) {
+                return "HTTP/1.1 400 Bad request  \n Not allow after_id \n\n";
+            }
+            after_id = value;
+        }
+
+        // Headers go out with the first row, so a failing query still gets a 500
+        bool started = false;
+        bool connected = true;
+        size_t last_id = after_id;
+        std::string chunk;
+        chunk.reserve(list_chunk_size);
+
+        auto start = [&] {
+            if (!started) {
+                started = true;
+                connected = _send_to_socket(client, list_headers, client_chank_size);
+            }
+            return connected;
+        };
 
         try {
-            list = _rep->get_list(limit);
+            _rep->stream_list(after_id, limit, list_fetch_rows, [&](const rp::request_t& item) {
+                chunk += "id = " + std::to_string(item.id) + "\n Request: \n";
+                chunk += item.request.string();
+                chunk += "\n";
+                last_id = item.id;
+
+                if (chunk.size() >= list_chunk_size) {
+                    connected = start() && _send_chunk(client, chunk);
+                    chunk.clear();
+                }
+                return connected;
+            });
         } catch(std::exception& ex) {
-            std::cerr << ex.what() << "\n";
-            return "HTTP/1.1 500 Server error  \n BD error \n\n";
+            logging::error({ex.what()});
+            if (!started) {
+                return "HTTP/1.1 500 Server error  \n BD error \n\n";
+            }
+            // Part of the list is already sent: the missing last chunk tells
+            // the client that the response is incomplete
+            return "";
         }
 
-        std::string res = "HTTP/1.1 200 OK\n\n";
-        for (auto& item : list) {
-            res += "id = " + std::to_string(item.id) + "\n Request: \n";
-            res += item.request.string();
-            res += "\n";
+        if (start() && _send_chunk(client, chunk)) {
+            auto end = "0\r\nX-Last-Id: " + std::to_string(last_id) + "\r\n\r\n";
+            _send_to_socket(client, end, client_chank_size);
         }
-        return res;
+        return "";
     }
 
-    std::string ProxyClient::_resend_request(rp::request_t& req) {
-        TcpSocket to;
-        auto res = _init_client_socket(req.host, req.port, to);
-        if (!res.empty()) {
-            return res;
+    std::string ProxyClient::_resend_request(const rp::request_t& req, const response_handler_t& on_data,
+                                             const std::function<void()>& on_attempt) {
+        auto data = req.request.string();
+        bool no_body = req.request.get_method() == "HEAD";
+
+        // A kept-alive connection may have been closed by the server meanwhile,
+        // then the request is sent once more over a new one
+        for (int attempt = 0; attempt < 2; ++attempt) {
+            bool reused = false;
+            std::string error;
+            auto socket = _shard().upstreams.acquire(req.host, req.port, req.is_https, reused, error);
+            if (!socket) {
+                return error;
+            }
+            if (on_attempt) {
+                on_attempt();
+            }
+
+            if (!_send_to_socket(*socket, data, client_chank_size)) {
+                if (reused) {
+                    continue;
+                }
+                return "HTTP/1.1 503 Service Unavailable \n Can't send request to host \n\n";
+            }
+
+            auto answ = read_response(*socket, _search_config.read_timeout, no_body, on_data);
+            if (answ.data.empty()) {
+                if (reused) {
+                    continue;
+                }
+                return "HTTP/1.1 408 Request Timeout  \n " +
+                       std::to_string(_search_config.read_timeout) + "ms time out \n\n";
+            }
+
+            if (answ.complete && answ.keep_alive) {
+                _shard().upstreams.release(req.host, req.port, req.is_https, std::move(socket));
+            }
+            return answ.data;
         }
+        return "HTTP/1.1 503 Service Unavailable \n Can't connect to host \n\n";
+    }
+
+    void ProxyClient::_run_on_helpers(size_t count, size_t concurrency, const std::function<void(size_t)>& task,
+                                      const std::function<bool(size_t)>& before_start) {
+        auto& helpers = _shard().helpers;
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t running = 0;
 
-        if (req.is_https) {
-            SSLSocket ssl_socket;
-            if (ssl_socket.init(std::move(to)) != bstcp::status::connected) {
-                return "HTTP/1.1 525 SSL Handshake Failed \n Can't connect to server by tls \n\n";
+        for (size_t i = 0; i < count; ++i) {
+            {
+                std::unique_lock<std::mutex> lck(mutex);
+                done.wait(lck, [&] { return running < concurrency; });
             }
-            _send_to_socket(ssl_socket, req.request.string(), client_chank_size);
-            auto answ = _read_from_socket(ssl_socket, server_chank_size);
-            return answ;
+            if (before_start && !before_start(i)) {
+                break;
+            }
+
+            {
+                std::lock_guard<std::mutex> lck(mutex);
+                running++;
+            }
+            // The helpers keep using the connections of this shard
+            helpers.add([&, i, shard = bstcp::get_current_shard()] {
+                bstcp::set_current_shard(shard);
+                task(i);
+                // Notified under the lock, the waiting frame may be gone right after it
+                std::lock_guard<std::mutex> lck(mutex);
+                running--;
+                done.notify_all();
+            });
         }
 
-        _send_to_socket(to, req.request.string(), client_chank_size);
+        std::unique_lock<std::mutex> lck(mutex);
+        done.wait(lck, [&] { return running == 0; });
+    }
+
+    bool ProxyClient::_send_probes(const std::vector<rp::request_t>& requests, size_t concurrency,
+                                   const probe_handler_t& on_done) {
+        std::atomic<bool> cancelled = false;
+        std::mutex done_mutex;
+        auto& matcher = _corpus.get_matcher();
+
+        _run_on_helpers(requests.size(), concurrency, [&](size_t i) {
+            // Signatures are looked for in each part as it arrives, the
+            // rest of the response is not read once one is found
+            AhoCorasick::state_t state;
+            probe_result_t result{"", AhoCorasick::no_match, {}};
+            auto start = std::chrono::steady_clock::now();
+            result.response = _resend_request(requests[i], [&](std::string_view data) {
+                result.signature = matcher.feed(state, data);
+                return result.signature == AhoCorasick::no_match;
+            }, [&] {
+                // A retry gets the whole response again, matches of a cut off one don't count
+                state = AhoCorasick::state_t();
+                result.signature = AhoCorasick::no_match;
+            });
+            result.latency = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start);
+
+            std::lock_guard<std::mutex> lck(done_mutex);
+            if (!cancelled && !on_done(i, result)) {
+                cancelled = true;
+            }
+        }, [&cancelled](size_t) {
+            return !cancelled;
+        });
+        return !cancelled;
+    }
+
 
-        if (!to.is_allow_to_read(2000)) {
-            return "HTTP/1.1 408 Request Timeout  \n 2s time out \n\n";
+    // Status code of a response or 0 when it is not HTTP
+    static int status_code(std::string_view response) {
+        auto pos = response.find(' ');
+        if (response.rfind("HTTP/", 0) != 0 || pos == std::string_view::npos) {
+            return 0;
         }
+        return (int) strtol(response.data() + pos + 1, nullptr, 10);
+    }
 
-        auto answ = _read_from_socket(to, server_chank_size);
-        return answ;
+    // Comma separated ids, false if one of them is not a positive number
+    static bool parse_ids(const std::string& param, std::vector<size_t>& ids) {
+        for (size_t pos = 0; pos <= param.size();) {
+            auto end = std::min(param.find(',', pos), param.size());
+            char* parsed = nullptr;
+            auto value = strtoll(param.data() + pos, &parsed, 10);
+            if (value <= 0 || parsed != param.data() + end) {
+                return false;
+            }
+            ids.push_back(value);
+            pos = end + 1;
+        }
+        std::sort(ids.begin(), ids.end());
+        ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+        return true;
     }
 
+    std::string ProxyClient::_repeat_batch(http::Request& req) {
+        std::vector<rp::request_t> requests;
+        try {
+            auto param = req.get_param(ids_param);
+            if (!param.empty()) {
+                std::vector<size_t> ids;
+                if (!parse_ids(param, ids)) {
+                    return "HTTP/1.1 400 Bad request  \n Not allow ids \n\n";
+                }
+                if (ids.size() > _search_config.max_replay) {
+                    return "HTTP/1.1 400 Bad request  \n More than " +
+                           std::to_string(_search_config.max_replay) + " ids \n\n";
+                }
+                requests = _rep->get_by_ids(ids);
+            } else {
+                auto from = strtoll(req.get_param(from_param).c_str(), nullptr, 10);
+                auto to = strtoll(req.get_param(to_param).c_str(), nullptr, 10);
+                if (from <= 0 || to < from) {
+                    return "HTTP/1.1 400 Bad request  \n Not allow from and to \n\n";
+                }
+                requests = _rep->get_range(from, to, _search_config.max_replay);
+            }
+        } catch(std::exception& ex) {
+            logging::error({ex.what()});
+            return "HTTP/1.1 500 Server error  \n BD error \n\n";
+        }
+
+        size_t concurrency = _search_config.concurrency;
+        auto param = req.get_param(concurrency_param);
+        if (!param.empty()) {
+            auto value = strtoll(param.c_str(), nullptr, 10);
+            if (value <= 0) {
+                return "HTTP/1.1 400 Bad request  \n Not allow concurrency \n\n";
+            }
+            concurrency = std::min((size_t) value, max_helper_threads);
+        }
+
+        // Request i is started no earlier than i / rate seconds after the first
+        double rate = 0;
+        param = req.get_param(rate_param);
+        if (!param.empty()) {
+            rate = strtod(param.c_str(), nullptr);
+            if (rate <= 0) {
+                return "HTTP/1.1 400 Bad request  \n Not allow rate \n\n";
+            }
+        }
+
+        std::vector<std::chrono::microseconds> latencies(requests.size());
+        std::vector<int> statuses(requests.size());
+        auto start = std::chrono::steady_clock::now();
+
+        _run_on_helpers(requests.size(), concurrency, [&](size_t i) {
+            auto sent = std::chrono::steady_clock::now();
+            // Only the status is kept, the rest of the response is dropped
+            // as soon as it is read
+            statuses[i] = status_code(_resend_request(requests[i]));
+            latencies[i] = std::chrono::duration_cast<std::chrono::microseconds>(
+                    std::chrono::steady_clock::now() - sent);
+        }, [&](size_t i) {
+            if (rate > 0) {
+                std::this_thread::sleep_until(start + std::chrono::duration_cast<std::chrono::microseconds>(
+                        std::chrono::duration<double>((double) i / rate)));
+            }
+            return true;
+        });
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+
+        std::string answ = "HTTP/1.1 200 OK \n\n";
+        answ += "Replayed " + std::to_string(requests.size()) + " requests in " + std::to_string(elapsed) +
+                " ms, concurrency " + std::to_string(concurrency);
+        if (rate > 0) {
+            answ += ", rate " + std::to_string(rate) + "/s";
+        }
+        answ += "\n";
+        if (requests.empty()) {
+            return answ;
+        }
+
+        std::sort(latencies.begin(), latencies.end());
+        auto percentile = [&latencies](double p) {
+            auto us = latencies[std::min((size_t) (p * (double) latencies.size()), latencies.size() - 1)];
+            return std::to_string((double) us.count() / 1000.0);
+        };
+        answ += "Latency ms: p50 " + percentile(0.5) + ", p90 " + percentile(0.9) + ", p99 " + percentile(0.99) +
+                ", max " + percentile(1) + "\n";
+
+        std::map<int, size_t> codes;
+        for (auto status : statuses) {
+            codes[status]++;
+        }
+        for (auto& [status, count] : codes) {
+            answ += (status == 0 ? std::string("No response") : "Status " + std::to_string(status)) + ": " +
+                    std::to_string(count) + "\n";
+        }
+        return answ;
+    }
 
     std::string ProxyClient::_repeat_request(http::Request& req) {
+        if (!req.get_param(ids_param).empty() || !req.get_param(from_param).empty()) {
+            return _repeat_batch(req);
+        }
+
         auto param = req.get_param(id_param);
         size_t id = 0;
         if (param.empty()) {
@@ -90,16 +378,14 @@ namespace proxy {
         }
 
         rp::request_t res;
-        try {
-            res = _rep->get_by_id(id);
-        } catch(std::exception& ex) {
-            std::cerr << ex.what() << "\n";
-            return "HTTP/1.1 500 Server error  \n BD error \n\n";
+        auto error = load_stored_request(id, [](size_t key) { return _rep->get_by_id(key); }, res);
+        if (!error.empty()) {
+            return error;
         }
         return _resend_request(res);
     }
 
-    std::string ProxyClient::_search_vulnerability(http::Request& req) {
+    std::string ProxyClient::_search_vulnerability(http::Request& req, bstcp::ISocket &client) {
         auto param = req.get_param(id_param);
         size_t id = 0;
         if (param.empty()) {
@@ -112,132 +398,102 @@ namespace proxy {
         }
 
         rp::request_t save_req;
-        try {
-            save_req = _rep->get_by_id(id);
-        } catch(std::exception& ex) {
-            std::cerr << ex.what() << "\n";
-            return "HTTP/1.1 500 Server error  \n BD error \n\n";
+        auto error = load_stored_request(id, [](size_t key) { return _rep->get_by_id(key); }, save_req);
+        if (!error.empty()) {
+            return error;
         }
 
-        auto tmp = save_req;
-
-        std::string answ = "HTTP/1.1 200 OK \n\n";
-
-        auto params = tmp.request.get_params();
-        for (auto [key, value] : params) {
-            tmp.request.set_param(key, value + injection_1);
-            auto res = _resend_request(tmp);
-            if (res.find(syndrom_injection) != std::string::npos) {
-                answ += "Found vulnerability with param " + key + " with injection " +injection_1;
-                answ += "\n" + res;
-            } else {
-                answ += "Not found vulnerability with param " + key + " and with injection " + injection_1;
-                answ += "\n";
-            }
+        // Every payload injected into every param, header and cookie is a probe;
+        // they are sent concurrently and reported as soon as each one is done
+        struct probe_t {
+            const char*         target;
+            std::string         key;
+            const std::string*  injection;
+        };
+        std::vector<probe_t> probes;
+        std::vector<rp::request_t> requests;
 
-            tmp.request.set_param(key, value + injection_2);
-            res = _resend_request(tmp);
-            if (res.find(syndrom_injection) != std::string::npos) {
-                answ += "Found vulnerability with param " + key + " with injection " + injection_2;
-                answ += "\n" + res;
-            } else {
-                answ += "Not found vulnerability with param " + key + " and with injection " + injection_2;
-                answ += "\n";
+        auto add_probes = [&](const char* target, const std::map<std::string, std::string>& values,
+                              bool (http::Request::*set)(const std::string&, const std::string&)) {
+            for (auto& [key, value] : values) {
+                for (auto& injection : _corpus.get_payloads()) {
+                    auto tmp = save_req;
+                    (tmp.request.*set)(key, value + injection);
+                    probes.push_back({target, key, &injection});
+                    requests.push_back(std::move(tmp));
+                }
             }
+        };
+        add_probes("param", save_req.request.get_params(), &http::Request::set_param);
+        add_probes("header", save_req.request.get_headers(), &http::Request::set_header);
+        add_probes("cookie", save_req.request.get_cookies(), &http::Request::set_cookie);
 
-            tmp.request.set_param(key, value + injection_3);
-            res = _resend_request(tmp);
-            if (res.find(syndrom_injection) != std::string::npos) {
-                answ += "Found vulnerability with param " + key + " with injection " + injection_3;
-                answ += "\n" + res;
-            } else {
-                answ += "Not found vulnerability with param " + key + " and with injection " + injection_3;
-                answ += "\n";
-            }
-            tmp = save_req;
+        if (!_send_to_socket(client, search_headers, client_chank_size)) {
+            return "";
         }
 
-        auto headers = tmp.request.get_headers();
-        for (auto [key, value] : headers) {
-            tmp.request.set_header(key, value + injection_1);
-            auto res = _resend_request(tmp);
-            if (res.find(syndrom_injection) != std::string::npos) {
-                answ += "Found vulnerability with header " + key + " with injection " +injection_1;
-                answ += "\n" + res;
-            } else {
-                answ += "Not found vulnerability with header " + key + " and with injection " + injection_1;
-                answ += "\n";
-            }
+        // Only one probe line and an excerpt of its response are held at a time
+        size_t done = 0;
+        size_t found = 0;
+        auto total = std::to_string(probes.size());
+        auto start = std::chrono::steady_clock::now();
 
-            tmp.request.set_header(key, value + injection_2);
-            res = _resend_request(tmp);
-            if (res.find(syndrom_injection) != std::string::npos) {
-                answ += "Found vulnerability with header " + key + " with injection " + injection_2;
-                answ += "\n" + res;
+        bool completed = _send_probes(requests, _search_config.concurrency, [&](size_t i, probe_result_t& result) {
+            auto& probe = probes[i];
+            std::string line = "[" + std::to_string(++done) + "/" + total + "] ";
+            if (result.signature != AhoCorasick::no_match) {
+                found++;
+                auto& signature = _corpus.get_signatures()[result.signature];
+                line += std::string("Found vulnerability with ") + probe.target + " " + probe.key +
+                        " with injection " + *probe.injection + " (signature " + signature + ", " +
+                        std::to_string(result.latency.count()) + " ms)\n";
+                line += excerpt(result.response, signature, _search_config.excerpt_size);
+                line += "\n";
             } else {
-                answ += "Not found vulnerability with header " + key + " and with injection " + injection_2;
-                answ += "\n";
+                line += std::string("Not found vulnerability with ") + probe.target + " " + probe.key +
+                        " and with injection " + *probe.injection + " (" +
+                        std::to_string(result.latency.count()) + " ms)\n";
             }
+            return _send_chunk(client, line);
+        });
 
-            tmp.request.set_header(key, value + injection_3);
-            res = _resend_request(tmp);
-            if (res.find(syndrom_injection) != std::string::npos) {
-                answ += "Found vulnerability with header " + key + " with injection " + injection_3;
-                answ += "\n" + res;
-            } else {
-                answ += "Not found vulnerability with header " + key + " and with injection " + injection_3;
-                answ += "\n";
-            }
-            tmp = save_req;
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        logging::info({"Search for request ", std::to_string(id), ": ", std::to_string(done), "/",
+                       std::to_string(probes.size()), " probes in ", std::to_string(elapsed), " ms"});
+        if (!completed) {
+            return "";
         }
 
-        auto cookies = tmp.request.get_cookies();
-        for (auto [key, value] : cookies) {
-            tmp.request.set_cookie(key, value + injection_1);
-            auto res = _resend_request(tmp);
-            if (res.find(syndrom_injection) != std::string::npos) {
-                answ += "Found vulnerability with cookie " + key + " with injection " +injection_1;
-                answ += "\n" + res;
-            } else {
-                answ += "Not found vulnerability with cookie " + key + " and with injection " + injection_1;
-                answ += "\n";
-            }
-
-            tmp.request.set_cookie(key, value + injection_2);
-            res = _resend_request(tmp);
-            if (res.find(syndrom_injection) != std::string::npos) {
-                answ += "Found vulnerability with cookie " + key + " with injection " + injection_2;
-                answ += "\n" + res;
-            } else {
-                answ += "Not found vulnerability with cookie " + key + " and with injection " + injection_2;
-                answ += "\n";
-            }
-
-            tmp.request.set_cookie(key, value + injection_3);
-            res = _resend_request(tmp);
-            if (res.find(syndrom_injection) != std::string::npos) {
-                answ += "Found vulnerability with cookie " + key + " with injection " + injection_3;
-                answ += "\n" + res;
-            } else {
-                answ += "Not found vulnerability with cookie " + key + " and with injection " + injection_3;
-                answ += "\n";
-            }
-            tmp = save_req;
+        auto summary = "Scanned " + total + " probes in " + std::to_string(elapsed) + " ms, concurrency " +
+                       std::to_string(_search_config.concurrency) + ", found " + std::to_string(found) + "\n";
+        if (_send_chunk(client, summary)) {
+            _send_to_socket(client, "0\r\n\r\n", client_chank_size);
         }
+        return "";
+    }
 
-        return answ;
+    std::string ProxyClient::_get_metrics() {
+        auto body = ProxyMetrics::render();
+        return "HTTP/1.1 200 OK\r\n"
+               "Content-Type: text/plain; version=0.0.4\r\n"
+               "Content-Length: " + std::to_string(body.size()) + "\r\n"
+               "\r\n" + body;
     }
 
-    std::string ProxyClient::_parse_not_proxy_request(http::Request& req) {
+    std::string ProxyClient::_parse_not_proxy_request(http::Request& req, bstcp::ISocket &client) {
         auto url = req.get_url();
         if (url == get_list_requests) {
-            return _get_list(req);
+            return _get_list(req, client);
+        }
+        if (url == metrics_requests) {
+            return _get_metrics();
         }
         if (url == repeat_requests) {
             return _repeat_request(req);
         }
         if (url == search_vulnerability_requests) {
-            return _search_vulnerability(req);
+            return _search_vulnerability(req, client);
         }
         return "HTTP/1.1 400 Bad request  \n Not allow this path \n\n";
     }
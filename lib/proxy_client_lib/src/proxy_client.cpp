@@ -2,6 +2,7 @@
 #include "tls_socket.hpp"
 
 #include "request_parser_lib.hpp"
+#include "logger_lib.hpp"
 
 #include <regex>
 #include <iostream>
@@ -14,6 +15,13 @@ const auto https_answer = "HTTP/1.0 200 Connection established\n\n";
 const size_t client_chank_size = 1024;
 const size_t server_chank_size = 20000;
 
+// Waits of the coroutine versions, in ms; the blocking ones wait as long
+// for reading, but leave sending to the kernel
+const long read_timeout = 1000;
+const long answer_timeout = 2000;
+const long tls_timeout = 5000;
+const long send_timeout = 5000;
+
 using namespace proxy;
 
 static const std::regex url_r(
@@ -39,6 +47,15 @@ static std::string get_protocol(std::string &url) {
     return protocol;
 }
 
+// What is answered by the proxy itself is either its error or a service
+// route, whose failures (e.g. a replayed 5xx) are counted as well
+static void count_answer(const std::string &res) {
+    auto status = strtol(res.c_str() + std::min(res.find(' '), res.size()), nullptr, 10);
+    if (status >= 400) {
+        ProxyMetrics::count_error(ProxyMetrics::error_kind((int) status));
+    }
+}
+
 static std::string get_hostname(std::string &url) {
     auto end = url.find('/');
     if (end == std::string::npos) {
@@ -63,42 +80,104 @@ namespace proxy {
     };
 
     std::unique_ptr<rp::PQStoreRequest> ProxyClient::_rep = nullptr;
+    std::unique_ptr<rp::HistoryRecorder> ProxyClient::_recorder = nullptr;
+    std::unique_ptr<rp::HistoryRetention> ProxyClient::_retention = nullptr;
 
-    void ProxyClient::set_repository(const std::string &conn_string) {
+    void ProxyClient::set_repository(const std::string &conn_string, rp::recorder_config_t config,
+                                     rp::retention_config_t retention) {
+        _retention = nullptr;
+        _recorder = nullptr;
         _rep = std::make_unique<rp::PQStoreRequest>(conn_string);
+        _recorder = std::make_unique<rp::HistoryRecorder>(*_rep, config);
+        _retention = std::make_unique<rp::HistoryRetention>(*_rep, retention);
+    }
+
+    rp::recorder_metrics_t ProxyClient::get_recorder_metrics() {
+        return _recorder ? _recorder->get_metrics() : rp::recorder_metrics_t{};
+    }
+
+    search_config_t ProxyClient::_search_config = {};
+    bstcp::connect_config_t ProxyClient::_connect_config = {};
+    ScanCorpus ProxyClient::_corpus = {};
+    std::vector<std::unique_ptr<ProxyClient::shard_state_t>> ProxyClient::_shards = [] {
+        std::vector<std::unique_ptr<shard_state_t>> shards;
+        shards.push_back(std::make_unique<shard_state_t>(_search_config));
+        return shards;
+    }();
+
+    void ProxyClient::set_search_config(search_config_t config) {
+        config.concurrency = std::max(config.concurrency, (size_t) 1);
+        if (!config.corpus_path.empty() && ScanCorpus::load(config.corpus_path, _corpus)) {
+            logging::info({"Scan corpus ", config.corpus_path, ": ", std::to_string(_corpus.get_payloads().size()),
+                           " payloads, ", std::to_string(_corpus.get_signatures().size()), " signatures"});
+        }
+        _search_config = config;
+        for (auto &shard: _shards) {
+            shard->upstreams.set_max_idle_per_host(config.max_idle_per_host);
+            shard->helpers.set_min_threads(config.concurrency);
+        }
+    }
+
+    void ProxyClient::set_connect_config(bstcp::connect_config_t config) {
+        _connect_config = config;
+    }
+
+    void ProxyClient::set_shard_count(size_t count) {
+        _shards.clear();
+        for (size_t i = 0; i < std::max(count, (size_t) 1); ++i) {
+            _shards.push_back(std::make_unique<shard_state_t>(_search_config));
+        }
+    }
+
+    ProxyClient::shard_state_t &ProxyClient::_shard() {
+        return *_shards[bstcp::get_current_shard() % _shards.size()];
+    }
+
+    upstream_stats_t ProxyClient::get_upstream_stats() {
+        upstream_stats_t res{};
+        for (auto &shard: _shards) {
+            auto stats = shard->upstreams.get_stats();
+            res.connects += stats.connects;
+            res.reused += stats.reused;
+            res.discarded += stats.discarded;
+            res.idle += stats.idle;
+        }
+        return res;
+    }
+
+    dns_stats_t ProxyClient::get_dns_stats() {
+        dns_stats_t res{};
+        for (auto &shard: _shards) {
+            auto stats = shard->dns.get_stats();
+            res.hits += stats.hits;
+            res.misses += stats.misses;
+        }
+        return res;
     }
 }
 
 std::string ProxyClient::_read_from_socket(bstcp::ISocket &socket, size_t chank_size) {
-    tcp_data_t buffer(chank_size);
+    bstcp::IOBuffer buffer;
+    auto size = (int) std::min(chank_size, buffer.size());
 
     if(!socket.is_allow_to_read(1000)) {
         return "";
     }
 
-    bool status = socket.recv_from(buffer.data(), (int)chank_size);
-    if (!status) {
+    int got = socket.recv_some(buffer.data(), size);
+    if (got <= 0) {
         return "";
     }
     std::string res;
 
-    while (status) {
-        res.insert(
-                res.end(),
-                std::make_move_iterator(buffer.begin()),
-                std::make_move_iterator(buffer.end())
-        );
-        auto end = res.find('\0');
-        if (end != std::string::npos) {
-            res = res.substr(0, end);
-        }
+    while (got > 0) {
+        res.append(buffer.data(), got);
 
         if(!socket.is_allow_to_read(1000)) {
             break;
         }
 
-        buffer = tcp_data_t(chank_size);
-        status = socket.recv_from(buffer.data(), (int)chank_size);
+        got = socket.recv_some(buffer.data(), size);
     }
 
     return res;
@@ -112,36 +191,50 @@ bool ProxyClient::_send_to_socket(bstcp::ISocket &socket, const std::string& dat
     return res;
 }
 
+bool ProxyClient::_send_chunk(bstcp::ISocket &socket, std::string_view data) {
+    if (data.empty()) {
+        return true;
+    }
+
+    char size[20];
+    auto len = snprintf(size, sizeof(size), "%zx\r\n", data.size());
+    return socket.send_to(size, len)
+           && socket.send_to(data.data(), (int)data.size())
+           && socket.send_to("\r\n", 2);
+}
+
 std::string ProxyClient::_init_client_socket(const std::string& host, size_t port, TcpSocket &socket) {
-    socket_addr_in adr;
-    if (bstcp::hostname_to_ip(host.c_str(), &adr) == -1) {
+    std::vector<bstcp::endpoint_t> endpoints;
+    StageTimer dns(Stage::dns);
+    if (!_shard().dns.resolve(host, &endpoints)) {
         return "HTTP/1.1 523 Origin Is Unreachable \n Can't resolve hostname " +
                 host + "\n\n";
     }
+    dns.stop();
 
-#ifdef _WIN32
-    if (socket.init((uint32_t) adr.sin_addr.S_un.S_addr, request.port,
-#else
-    if (socket.init((uint32_t) adr.sin_addr.s_addr, port,
-#endif
-                    (uint16_t) SocketType::blocking_socket
-                    | (uint16_t) SocketType::client_socket) !=
-        SocketStatus::connected) {
+    StageTimer connect(Stage::upstream_connect);
+    bstcp::ConnectRace race(std::move(endpoints), (uint16_t) port, _connect_config);
+    auto sts = race.run(socket);
+    ProxyMetrics::count_connect(race.get_attempts(), race.get_failed());
+    if (sts != SocketStatus::connected) {
         return "HTTP/1.1 503 Service Unavailable \n Can't connect to host \n\n";
     }
+    connect.stop();
     return "";
 }
 
 std::string ProxyClient::_parse_request(std::string &data) {
-    http::Request tmp(data);
+    StageTimer parse(Stage::parse);
+    http::Request tmp(data, _arena);
+    parse.stop();
     if (tmp.get_header("Proxy-Connection").empty() && tmp.get_method() != https_method) {
-        return _parse_not_proxy_request(tmp);
+        return _parse_not_proxy_request(tmp, *this);
     }
     return _parse_proxy_request(tmp);
 }
 
 
-std::string ProxyClient::_parse_proxy_request(http::Request& data) {
+static request_t to_proxy_request(http::Request& data) {
     data.delete_header("Proxy-Connection");
 
     auto url = data.get_url();
@@ -155,9 +248,14 @@ std::string ProxyClient::_parse_proxy_request(http::Request& data) {
 
     req.data = std::move(data);
 
-    std::cout << "Connect to client" + req.protocol + "://" +
-                 req.hostname + ":" << req.port << std::endl;
+    if (logging::Logger::enabled(logging::Level::info)) {
+        logging::info({"Connect to client", req.protocol, "://", req.hostname, ":", std::to_string(req.port)});
+    }
+    return req;
+}
 
+std::string ProxyClient::_parse_proxy_request(http::Request& data) {
+    auto req = to_proxy_request(data);
     if (req.protocol == HTTP) {
         return _http_request(req);
     }
@@ -174,9 +272,11 @@ std::string ProxyClient::_https_request(request_t &request) {
     send_to(https_answer, (int)std::string(https_answer).size());
 
     SSLSocket client_socket;
-    if (client_socket.init(std::move(_socket), false, request.hostname) != bstcp::status::connected) {
+    StageTimer client_tls(Stage::client_tls);
+    if (client_socket.init(std::move(_socket), false, request.hostname, tls_timeout) != bstcp::status::connected) {
         return "HTTP/1.1 525 SSL Handshake Failed \n Can't connect to client by tls \n\n";
     }
+    client_tls.stop();
 
     auto message = _read_from_socket(client_socket, client_chank_size);
 
@@ -184,18 +284,16 @@ std::string ProxyClient::_https_request(request_t &request) {
         return "HTTP/1.1 400 Bad request \n Empty message from client \n\n";
     }
 
-    try {
-        ProxyClient::_rep->add(rp::request_t{
-                .is_valid = true,
-                .is_https = true,
-                .id = 0,
-                .port = (size_t)request.port,
-                .host = request.hostname,
-                .request = http::Request(message)
-        });
-    } catch(std::exception& e) {
-        std::cerr << e.what() << "\n";
-    }
+    StageTimer db_record(Stage::db_record);
+    ProxyClient::_recorder->record(rp::request_t{
+            .is_valid = true,
+            .is_https = true,
+            .id = 0,
+            .port = (size_t)request.port,
+            .host = request.hostname,
+            .request = http::Request(message, _arena)
+    });
+    db_record.stop();
 
     TcpSocket to;
     auto res = _init_client_socket(request.hostname, request.port, to);
@@ -204,32 +302,39 @@ std::string ProxyClient::_https_request(request_t &request) {
     }
 
     SSLSocket ssl_socket;
-    if (ssl_socket.init(std::move(to)) != bstcp::status::connected) {
+    StageTimer upstream_tls(Stage::upstream_tls);
+    if (ssl_socket.init(std::move(to), true, "", tls_timeout) != bstcp::status::connected) {
         return "HTTP/1.1 525 SSL Handshake Failed \n Can't connect to server by tls \n\n";
     }
+    upstream_tls.stop();
 
+    StageTimer ttfb(Stage::upstream_ttfb);
     ssl_socket.send_to(message.data(), message.size());
     message.clear();
 
-    auto answ = _read_from_socket(ssl_socket, server_chank_size);
-    _send_to_socket(client_socket, answ, client_chank_size);
+    std::string answ;
+    if (ssl_socket.is_allow_to_read(1000)) {
+        ttfb.stop();
+        answ = _read_from_socket(ssl_socket, server_chank_size);
+    }
+    if (_send_to_socket(client_socket, answ, client_chank_size)) {
+        ProxyMetrics::add_bytes_out(answ.size());
+    }
     _socket = client_socket.release();
     return "";
 }
 
 std::string ProxyClient::_http_request(request_t &request) {
-    try {
-        ProxyClient::_rep->add(rp::request_t{
-                .is_valid = true,
-                .is_https = false,
-                .id = 0,
-                .port = (size_t)request.port,
-                .host = request.hostname,
-                .request = request.data
-        });
-    } catch(std::exception& e) {
-        std::cerr << e.what() << "\n";
-    }
+    StageTimer db_record(Stage::db_record);
+    ProxyClient::_recorder->record(rp::request_t{
+            .is_valid = true,
+            .is_https = false,
+            .id = 0,
+            .port = (size_t)request.port,
+            .host = request.hostname,
+            .request = request.data
+    });
+    db_record.stop();
 
     TcpSocket to;
     auto res = _init_client_socket(request.hostname, request.port, to);
@@ -237,11 +342,13 @@ std::string ProxyClient::_http_request(request_t &request) {
         return res;
     }
 
+    StageTimer ttfb(Stage::upstream_ttfb);
     _send_to_socket(to, request.data.string(), client_chank_size);
 
     if (!to.is_allow_to_read(2000)) {
         return "HTTP/1.1 408 Request Timeout  \n 2s time out \n\n";
     }
+    ttfb.stop();
 
     auto answ = _read_from_socket(to, server_chank_size);
     _send_to_socket(*this, answ, client_chank_size);
@@ -250,19 +357,243 @@ std::string ProxyClient::_http_request(request_t &request) {
 
 
 void ProxyClient::handle_request() {
+    if (!is_allow_to_read(1000)) {
+        return;
+    }
+    if (!_got_first_byte) {
+        _got_first_byte = true;
+        ProxyMetrics::observe(Stage::first_byte, ProxyMetrics::clock::now() - _accepted_at);
+    }
+
+    StageTimer total(Stage::total);
     std::string data = _read_from_socket(*this, client_chank_size);
     if (data.empty()) {
         return;
     }
+    ProxyMetrics::count_request();
+    ProxyMetrics::add_bytes_in(data.size());
 
-    std::cout << "Client " << " send data [ " << data.size()
-              << " bytes ]: \n" << (char *) data.data() << '\n';
+    // Only the head of a big body is kept, the logger cuts long entries
+    if (logging::Logger::enabled(logging::Level::debug)) {
+        logging::debug({"Client send data [ ", std::to_string(data.size()), " bytes ]: \n", data});
+    }
     auto res = _parse_request(data);
 
     if (!res.empty()) {
+        count_answer(res);
         _send_to_socket(*this, res, client_chank_size);
     }
+    _arena.reset();
     disconnect();
+    total.stop();
+}
+
+bstcp::Task<std::string> ProxyClient::_read_from_socket_async(bstcp::AsyncSocket &socket, size_t chank_size) {
+    bstcp::IOBuffer buffer;
+    auto size = (int) std::min(chank_size, buffer.size());
+
+    // Like _read_from_socket, the message ends with a second of silence
+    std::string res;
+    int got = co_await socket.read(buffer.data(), size, read_timeout);
+    while (got > 0) {
+        res.append(buffer.data(), got);
+        got = co_await socket.read(buffer.data(), size, read_timeout);
+    }
+    co_return res;
+}
+
+bstcp::Task<std::string> ProxyClient::_init_client_socket_async(bstcp::EventLoop &loop, const std::string& host,
+                                                                size_t port, TcpSocket &socket) {
+    std::vector<bstcp::endpoint_t> endpoints;
+    StageTimer dns(Stage::dns);
+    auto &cache = _shard().dns;
+    if (!cache.find(host, &endpoints)
+        && !co_await loop.run_blocking([&cache, &host, &endpoints] { return cache.resolve(host, &endpoints); })) {
+        co_return "HTTP/1.1 523 Origin Is Unreachable \n Can't resolve hostname " +
+                  host + "\n\n";
+    }
+    dns.stop();
+
+    StageTimer connect(Stage::upstream_connect);
+    bstcp::ConnectRace race(std::move(endpoints), (uint16_t) port, _connect_config);
+    bstcp::AsyncSocket upstream(loop, socket);
+    auto sts = co_await upstream.connect(race);
+    ProxyMetrics::count_connect(race.get_attempts(), race.get_failed());
+    if (sts != SocketStatus::connected) {
+        co_return "HTTP/1.1 503 Service Unavailable \n Can't connect to host \n\n";
+    }
+    connect.stop();
+    co_return "";
+}
+
+bstcp::Task<bool> ProxyClient::_record_async(bstcp::EventLoop &loop, rp::request_t req) {
+    if (_recorder->try_record(req)) {
+        co_return true;
+    }
+    co_return co_await loop.run_blocking([&req] { return _recorder->record(std::move(req)); });
+}
+
+bstcp::Task<std::string> ProxyClient::_parse_request_async(bstcp::EventLoop &loop, std::string &data) {
+    StageTimer parse(Stage::parse);
+    http::Request tmp(data, _arena);
+    parse.stop();
+    if (tmp.get_header("Proxy-Connection").empty() && tmp.get_method() != https_method) {
+        // The routes stream to the client with blocking sends from a helper
+        // thread. The coroutine is parked meanwhile and the loop leaves the
+        // socket alone, only its mode has to change
+        _socket.set_blocking(true);
+        auto res = co_await loop.run_blocking([this, &tmp] { return _parse_not_proxy_request(tmp, *this); });
+        _socket.set_blocking(false);
+        co_return res;
+    }
+
+    auto req = to_proxy_request(tmp);
+    if (req.protocol == HTTP) {
+        co_return co_await _http_request_async(loop, req);
+    }
+
+    if (req.protocol == HTTPS && req.method == https_method) {
+        co_return co_await _https_request_async(loop, req);
+    }
+
+    co_return "HTTP/1.1 404 Not found \n Unknown protocol " + req.protocol + "\n\n";
+}
+
+bstcp::Task<std::string> ProxyClient::_https_request_async(bstcp::EventLoop &loop, request_t &request) {
+    bstcp::AsyncSocket plain(loop, _socket);
+    auto answer_size = (int) std::string(https_answer).size();
+    if (co_await plain.write(https_answer, answer_size, send_timeout)) {
+        ProxyMetrics::add_bytes_out(answer_size);
+    }
+
+    SSLSocket client_socket;
+    StageTimer client_tls(Stage::client_tls);
+    if (co_await client_socket.init_async(loop, std::move(_socket), tls_timeout, false, request.hostname) !=
+        bstcp::status::connected) {
+        co_return "HTTP/1.1 525 SSL Handshake Failed \n Can't connect to client by tls \n\n";
+    }
+    client_tls.stop();
+
+    bstcp::AsyncSocket client(loop, client_socket);
+    auto message = co_await _read_from_socket_async(client, client_chank_size);
+
+    if (message.empty()) {
+        co_return "HTTP/1.1 400 Bad request \n Empty message from client \n\n";
+    }
+
+    StageTimer db_record(Stage::db_record);
+    co_await _record_async(loop, rp::request_t{
+            .is_valid = true,
+            .is_https = true,
+            .id = 0,
+            .port = (size_t)request.port,
+            .host = request.hostname,
+            .request = http::Request(message, _arena)
+    });
+    db_record.stop();
+
+    TcpSocket to;
+    auto res = co_await _init_client_socket_async(loop, request.hostname, request.port, to);
+    if (!res.empty()) {
+        co_return res;
+    }
+
+    SSLSocket ssl_socket;
+    StageTimer upstream_tls(Stage::upstream_tls);
+    if (co_await ssl_socket.init_async(loop, std::move(to), tls_timeout) != bstcp::status::connected) {
+        co_return "HTTP/1.1 525 SSL Handshake Failed \n Can't connect to server by tls \n\n";
+    }
+    upstream_tls.stop();
+
+    bstcp::AsyncSocket upstream(loop, ssl_socket);
+    StageTimer ttfb(Stage::upstream_ttfb);
+    co_await upstream.write(message.data(), (int) message.size(), send_timeout);
+    message.clear();
+
+    std::string answ;
+    if (co_await upstream.readable(read_timeout)) {
+        ttfb.stop();
+        answ = co_await _read_from_socket_async(upstream, server_chank_size);
+    }
+    if (co_await client.write(answ.data(), (int) answ.size(), send_timeout)) {
+        ProxyMetrics::add_bytes_out(answ.size());
+    }
+    _socket = client_socket.release();
+    co_return "";
+}
+
+bstcp::Task<std::string> ProxyClient::_http_request_async(bstcp::EventLoop &loop, request_t &request) {
+    StageTimer db_record(Stage::db_record);
+    co_await _record_async(loop, rp::request_t{
+            .is_valid = true,
+            .is_https = false,
+            .id = 0,
+            .port = (size_t)request.port,
+            .host = request.hostname,
+            .request = request.data
+    });
+    db_record.stop();
+
+    TcpSocket to;
+    auto res = co_await _init_client_socket_async(loop, request.hostname, request.port, to);
+    if (!res.empty()) {
+        co_return res;
+    }
+
+    bstcp::AsyncSocket upstream(loop, to);
+    StageTimer ttfb(Stage::upstream_ttfb);
+    auto data = request.data.string();
+    co_await upstream.write(data.data(), (int) data.size(), send_timeout);
+
+    if (!co_await upstream.readable(answer_timeout)) {
+        co_return "HTTP/1.1 408 Request Timeout  \n 2s time out \n\n";
+    }
+    ttfb.stop();
+
+    auto answ = co_await _read_from_socket_async(upstream, server_chank_size);
+    bstcp::AsyncSocket client(loop, _socket);
+    if (co_await client.write(answ.data(), (int) answ.size(), send_timeout)) {
+        ProxyMetrics::add_bytes_out(answ.size());
+    }
+    co_return "";
+}
+
+bstcp::Task<void> ProxyClient::handle_request_async(bstcp::EventLoop &loop) {
+    bstcp::AsyncSocket client(loop, _socket);
+    if (!co_await client.readable(read_timeout)) {
+        co_return;
+    }
+    if (!_got_first_byte) {
+        _got_first_byte = true;
+        ProxyMetrics::observe(Stage::first_byte, ProxyMetrics::clock::now() - _accepted_at);
+    }
+
+    StageTimer total(Stage::total);
+    std::string data = co_await _read_from_socket_async(client, client_chank_size);
+    if (data.empty()) {
+        co_return;
+    }
+    ProxyMetrics::count_request();
+    ProxyMetrics::add_bytes_in(data.size());
+
+    if (logging::Logger::enabled(logging::Level::debug)) {
+        logging::debug({"Client send data [ ", std::to_string(data.size()), " bytes ]: \n", data});
+    }
+    auto res = co_await _parse_request_async(loop, data);
+
+    if (!res.empty()) {
+        count_answer(res);
+        if (co_await client.write(res.data(), (int) res.size(), send_timeout)) {
+            ProxyMetrics::add_bytes_out(res.size());
+        }
+    }
+    _arena.reset();
+    disconnect();
+    total.stop();
+}
+
+http::arena_stats_t ProxyClient::get_arena_stats() const {
+    return _arena.get_stats();
 }
 
 uint32_t ProxyClient::get_host() const {
@@ -285,8 +616,16 @@ bool ProxyClient::recv_from(void *buffer, int size) {
     return _socket.recv_from(buffer, size);
 }
 
+int ProxyClient::recv_some(void *buffer, int size) {
+    return _socket.recv_some(buffer, size);
+}
+
 bool ProxyClient::send_to(const void *buffer, int size) const {
-    return _socket.send_to(buffer, size);
+    if (!_socket.send_to(buffer, size)) {
+        return false;
+    }
+    ProxyMetrics::add_bytes_out(size);
+    return true;
 }
 
 SocketType ProxyClient::get_type() const {
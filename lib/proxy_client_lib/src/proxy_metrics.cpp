@@ -0,0 +1,198 @@
+#include "proxy_metrics.hpp"
+#include "tcp_server_lib.hpp"
+
+#include <algorithm>
+#include <bit>
+
+static const char* stage_names[] = {
+        "first_byte", "parse", "db_record", "dns", "upstream_connect",
+        "client_tls", "upstream_tls", "upstream_ttfb", "total"
+};
+
+static const char* error_names[] = {
+        "bad_request", "dns", "connect", "tls", "timeout", "db", "other"
+};
+
+static_assert(std::size(stage_names) == (size_t) proxy::Stage::count);
+static_assert(std::size(error_names) == (size_t) proxy::ErrorKind::count);
+
+namespace proxy {
+
+static const size_t stage_count = (size_t) Stage::count;
+static const size_t error_count = (size_t) ErrorKind::count;
+
+struct ProxyMetrics::thread_block_t {
+    std::array<std::array<std::atomic<uint64_t>, metrics_buckets>, stage_count> buckets{};
+    std::array<std::atomic<uint64_t>, stage_count>                              sums{};     // us
+    std::array<std::atomic<uint64_t>, (size_t) Counter::count>                  counters{};
+    std::array<std::atomic<uint64_t>, error_count>                              errors{};
+
+    std::atomic<bool> in_use{true};
+};
+
+std::mutex ProxyMetrics::_blocks_mutex;
+std::deque<std::unique_ptr<ProxyMetrics::thread_block_t>> ProxyMetrics::_blocks;
+std::atomic<uint64_t> ProxyMetrics::_accepted = 0;
+std::atomic<int64_t>  ProxyMetrics::_active = 0;
+
+// Only the owning thread writes a block, so a plain load and store is enough
+static void increment(std::atomic<uint64_t>& value, uint64_t delta = 1) {
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+ProxyMetrics::thread_block_t& ProxyMetrics::_local() {
+    struct owner_t {
+        thread_block_t* block = nullptr;
+
+        ~owner_t() {
+            if (block) {
+                block->in_use.store(false, std::memory_order_release);
+            }
+        }
+    };
+    thread_local owner_t owner;
+
+    if (!owner.block) {
+        std::lock_guard<std::mutex> lck(_blocks_mutex);
+        for (auto& block : _blocks) {
+            bool free = false;
+            if (block->in_use.compare_exchange_strong(free, true, std::memory_order_acquire)) {
+                owner.block = block.get();
+                break;
+            }
+        }
+        if (!owner.block) {
+            _blocks.push_back(std::make_unique<thread_block_t>());
+            owner.block = _blocks.back().get();
+        }
+    }
+    return *owner.block;
+}
+
+void ProxyMetrics::observe(Stage stage, clock::duration time) {
+    auto us = (uint64_t) std::max(std::chrono::duration_cast<std::chrono::microseconds>(time).count(),
+                                  (std::chrono::microseconds::rep) 0);
+    auto& block = _local();
+    increment(block.buckets[(size_t) stage][std::min((size_t) std::bit_width(us), metrics_buckets - 1)]);
+    increment(block.sums[(size_t) stage], us);
+}
+
+void ProxyMetrics::count_request() {
+    increment(_local().counters[(size_t) Counter::requests]);
+}
+
+void ProxyMetrics::count_error(ErrorKind kind) {
+    increment(_local().errors[(size_t) kind]);
+}
+
+void ProxyMetrics::add_bytes_in(size_t bytes) {
+    increment(_local().counters[(size_t) Counter::bytes_in], bytes);
+}
+
+void ProxyMetrics::add_bytes_out(size_t bytes) {
+    increment(_local().counters[(size_t) Counter::bytes_out], bytes);
+}
+
+void ProxyMetrics::count_connect(size_t attempts, size_t failed) {
+    increment(_local().counters[(size_t) Counter::connect_attempts], attempts);
+    increment(_local().counters[(size_t) Counter::connect_failed], failed);
+}
+
+void ProxyMetrics::connection_accepted() {
+    _accepted.fetch_add(1, std::memory_order_relaxed);
+    _active.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ProxyMetrics::connection_closed() {
+    _active.fetch_sub(1, std::memory_order_relaxed);
+}
+
+ErrorKind ProxyMetrics::error_kind(int status) {
+    switch (status) {
+        case 400:
+            return ErrorKind::bad_request;
+        case 408:
+            return ErrorKind::timeout;
+        case 500:
+            return ErrorKind::db;
+        case 503:
+            return ErrorKind::connect;
+        case 523:
+            return ErrorKind::dns;
+        case 525:
+            return ErrorKind::tls;
+        default:
+            return ErrorKind::other;
+    }
+}
+
+std::string ProxyMetrics::render() {
+    std::array<std::array<uint64_t, metrics_buckets>, stage_count> buckets{};
+    std::array<uint64_t, stage_count> sums{};
+    std::array<uint64_t, (size_t) Counter::count> counters{};
+    std::array<uint64_t, error_count> errors{};
+
+    {
+        std::lock_guard<std::mutex> lck(_blocks_mutex);
+        for (auto& block : _blocks) {
+            for (size_t stage = 0; stage < stage_count; ++stage) {
+                for (size_t i = 0; i < metrics_buckets; ++i) {
+                    buckets[stage][i] += block->buckets[stage][i].load(std::memory_order_relaxed);
+                }
+                sums[stage] += block->sums[stage].load(std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < counters.size(); ++i) {
+                counters[i] += block->counters[i].load(std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < error_count; ++i) {
+                errors[i] += block->errors[i].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    std::string res;
+    auto counter = [&res](const char* name, const char* help, const char* type, const std::string& value) {
+        res += std::string("# HELP ") + name + " " + help + "\n# TYPE " + name + " " + type + "\n";
+        res += std::string(name) + " " + value + "\n";
+    };
+    counter("proxy_connections_accepted_total", "Client connections accepted.", "counter",
+            std::to_string(_accepted.load(std::memory_order_relaxed)));
+    counter("proxy_connections_active", "Client connections open now.", "gauge",
+            std::to_string(_active.load(std::memory_order_relaxed)));
+    counter("proxy_requests_total", "Requests read from clients.", "counter",
+            std::to_string(counters[(size_t) Counter::requests]));
+    counter("proxy_received_bytes_total", "Bytes read from clients.", "counter",
+            std::to_string(counters[(size_t) Counter::bytes_in]));
+    counter("proxy_sent_bytes_total", "Bytes sent to clients.", "counter",
+            std::to_string(counters[(size_t) Counter::bytes_out]));
+    counter("proxy_upstream_connect_attempts_total", "Upstream addresses tried to connect.", "counter",
+            std::to_string(counters[(size_t) Counter::connect_attempts]));
+    counter("proxy_upstream_connect_failed_total", "Upstream connect attempts failed or timed out.", "counter",
+            std::to_string(counters[(size_t) Counter::connect_failed]));
+
+    auto buffers = bstcp::BufferPool::get_stats();
+    counter("proxy_io_buffers_live", "Pooled I/O buffers in use.", "gauge", std::to_string(buffers.live));
+    counter("proxy_io_buffers_free", "Pooled I/O buffers kept for reuse.", "gauge", std::to_string(buffers.free));
+
+    res += "# HELP proxy_errors_total Error responses by kind.\n# TYPE proxy_errors_total counter\n";
+    for (size_t i = 0; i < error_count; ++i) {
+        res += std::string("proxy_errors_total{kind=\"") + error_names[i] + "\"} " + std::to_string(errors[i]) + "\n";
+    }
+
+    res += "# HELP proxy_stage_seconds Time spent in each stage of a request.\n"
+           "# TYPE proxy_stage_seconds histogram\n";
+    for (size_t stage = 0; stage < stage_count; ++stage) {
+        std::string labels = std::string("stage=\"") + stage_names[stage] + "\"";
+        uint64_t cumulative = 0;
+        for (size_t i = 0; i < metrics_buckets; ++i) {
+            cumulative += buckets[stage][i];
+            auto le = i + 1 == metrics_buckets ? std::string("+Inf") : std::to_string((double) (1ULL << i) / 1e6);
+            res += "proxy_stage_seconds_bucket{" + labels + ",le=\"" + le + "\"} " + std::to_string(cumulative) + "\n";
+        }
+        res += "proxy_stage_seconds_sum{" + labels + "} " + std::to_string((double) sums[stage] / 1e6) + "\n";
+        res += "proxy_stage_seconds_count{" + labels + "} " + std::to_string(cumulative) + "\n";
+    }
+    return res;
+}
+
+}
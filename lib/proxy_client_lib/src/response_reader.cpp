@@ -0,0 +1,155 @@
+#include "response_reader.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <optional>
+#include <string_view>
+
+static bool iequals(std::string_view lhs, std::string_view rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(), [](char a, char b) {
+        return std::tolower((unsigned char) a) == std::tolower((unsigned char) b);
+    });
+}
+
+static bool icontains(std::string_view str, std::string_view word) {
+    return std::search(str.begin(), str.end(), word.begin(), word.end(), [](char a, char b) {
+        return std::tolower((unsigned char) a) == std::tolower((unsigned char) b);
+    }) != str.end();
+}
+
+static std::string_view trim(std::string_view str) {
+    while (!str.empty() && (str.front() == ' ' || str.front() == '\t')) {
+        str.remove_prefix(1);
+    }
+    while (!str.empty() && (str.back() == ' ' || str.back() == '\t' || str.back() == '\r')) {
+        str.remove_suffix(1);
+    }
+    return str;
+}
+
+struct framing_t {
+    size_t                  body_start  = 0;
+    std::optional<size_t>   length;
+    bool                    chunked     = false;
+};
+
+// Parses the status line and the headers that matter for framing
+static framing_t parse_head(proxy::upstream_response_t &res, std::string_view head, bool no_body) {
+    framing_t framing;
+
+    auto line_end = head.find('\n');
+    auto status_line = head.substr(0, line_end);
+    bool http_1_0 = status_line.substr(0, 8) == "HTTP/1.0";
+    res.status = (int) strtol(std::string(status_line.substr(std::min(status_line.size(), (size_t) 9), 3)).c_str(),
+                              nullptr, 10);
+    res.keep_alive = !http_1_0;
+
+    while (line_end != std::string_view::npos) {
+        head.remove_prefix(line_end + 1);
+        line_end = head.find('\n');
+        auto line = head.substr(0, line_end);
+        auto colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+
+        auto name = trim(line.substr(0, colon));
+        auto value = trim(line.substr(colon + 1));
+        if (iequals(name, "Content-Length")) {
+            framing.length = strtoull(std::string(value).c_str(), nullptr, 10);
+        } else if (iequals(name, "Transfer-Encoding")) {
+            framing.chunked = icontains(value, "chunked");
+        } else if (iequals(name, "Connection")) {
+            if (icontains(value, "close")) {
+                res.keep_alive = false;
+            } else if (icontains(value, "keep-alive")) {
+                res.keep_alive = true;
+            }
+        }
+    }
+
+    if (no_body || res.status / 100 == 1 || res.status == 204 || res.status == 304) {
+        framing.chunked = false;
+        framing.length = 0;
+    }
+    if (!framing.chunked && !framing.length) {
+        res.keep_alive = false;
+    }
+    return framing;
+}
+
+// Returns true once the chunked body starting at `pos` is complete
+static bool chunked_complete(std::string_view data, size_t pos) {
+    while (true) {
+        auto line_end = data.find("\r\n", pos);
+        if (line_end == std::string_view::npos) {
+            return false;
+        }
+
+        auto size = strtoull(std::string(data.substr(pos, line_end - pos)).c_str(), nullptr, 16);
+        pos = line_end + 2;
+        if (size == 0) {
+            // Optional trailers end with an empty line
+            if (data.substr(pos, 2) == "\r\n") {
+                return true;
+            }
+            return data.find("\r\n\r\n", pos) != std::string_view::npos;
+        }
+
+        if (data.size() < pos + size + 2) {
+            return false;
+        }
+        pos += size + 2;
+    }
+}
+
+namespace proxy {
+
+upstream_response_t read_response(bstcp::ISocket &socket, long timeout, bool no_body,
+                                  const response_handler_t &on_data) {
+    upstream_response_t res;
+    std::optional<framing_t> framing;
+    bstcp::IOBuffer buffer;
+
+    while (true) {
+        if (!socket.is_allow_to_read(timeout)) {
+            return res;
+        }
+
+        auto size = socket.recv_some(buffer.data(), (int) buffer.size());
+        if (size <= 0) {
+            // Without a length the end of the connection ends the message
+            res.complete = framing && !framing->length && !framing->chunked;
+            res.keep_alive = false;
+            return res;
+        }
+        res.data.append(buffer.data(), size);
+        if (on_data && !on_data(std::string_view(buffer.data(), size))) {
+            res.stopped = true;
+            res.keep_alive = false;
+            return res;
+        }
+
+        if (!framing) {
+            auto head_end = res.data.find("\r\n\r\n");
+            if (head_end == std::string::npos) {
+                continue;
+            }
+            framing = parse_head(res, std::string_view(res.data).substr(0, head_end), no_body);
+            framing->body_start = head_end + 4;
+        }
+
+        if (framing->chunked) {
+            res.complete = chunked_complete(res.data, framing->body_start);
+        } else if (framing->length) {
+            res.complete = res.data.size() >= framing->body_start + *framing->length;
+        }
+
+        if (res.complete) {
+            return res;
+        }
+    }
+}
+
+}
\ No newline at end of file
@@ -0,0 +1,105 @@
+#include "scan_corpus.hpp"
+#include "logger_lib.hpp"
+
+#include <fstream>
+
+static std::string unescape(std::string_view text) {
+    std::string res;
+    res.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '\\' || i + 1 == text.size()) {
+            res += text[i];
+            continue;
+        }
+
+        switch (text[++i]) {
+            case 'r':
+                res += '\r';
+                break;
+            case 'n':
+                res += '\n';
+                break;
+            case 't':
+                res += '\t';
+                break;
+            case 'x':
+                if (i + 2 < text.size()) {
+                    res += (char) strtol(std::string(text.substr(i + 1, 2)).c_str(), nullptr, 16);
+                    i += 2;
+                }
+                break;
+            default:
+                res += text[i];
+                break;
+        }
+    }
+    return res;
+}
+
+namespace proxy {
+
+ScanCorpus::ScanCorpus()
+        : ScanCorpus({";cat /etc/passwd;", "|cat /etc/passwd|", "`cat /etc/passwd`"}, {"root:"}) {}
+
+ScanCorpus::ScanCorpus(std::vector<std::string> payloads, std::vector<std::string> signatures)
+        : _payloads(std::move(payloads))
+          , _signatures(std::move(signatures))
+          , _matcher(_signatures) {}
+
+bool ScanCorpus::load(const std::string &path, ScanCorpus &corpus) {
+    std::ifstream file(path);
+    if (!file) {
+        logging::error({"Can't open scan corpus ", path});
+        return false;
+    }
+
+    std::vector<std::string> payloads, signatures;
+    std::string line;
+    for (size_t number = 1; std::getline(file, line); ++number) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        auto space = line.find(' ');
+        auto kind = line.substr(0, space);
+        auto text = space == std::string::npos ? std::string() : unescape(std::string_view(line).substr(space + 1));
+        if (text.empty()) {
+            logging::error({path, ":", std::to_string(number), ": empty ", kind});
+            return false;
+        }
+
+        if (kind == "payload") {
+            payloads.push_back(std::move(text));
+        } else if (kind == "signature") {
+            signatures.push_back(std::move(text));
+        } else {
+            logging::error({path, ":", std::to_string(number), ": unknown entry ", kind});
+            return false;
+        }
+    }
+
+    if (payloads.empty() || signatures.empty()) {
+        logging::error({"Scan corpus ", path, " needs at least one payload and one signature"});
+        return false;
+    }
+
+    corpus = ScanCorpus(std::move(payloads), std::move(signatures));
+    return true;
+}
+
+const std::vector<std::string> &ScanCorpus::get_payloads() const {
+    return _payloads;
+}
+
+const std::vector<std::string> &ScanCorpus::get_signatures() const {
+    return _signatures;
+}
+
+const AhoCorasick &ScanCorpus::get_matcher() const {
+    return _matcher;
+}
+
+}
@@ -1,4 +1,5 @@
 #include "include/ssl_cert.hpp"
+#include "logger_lib.hpp"
 
 #include <cstring>
 #include <utility>
@@ -23,8 +24,7 @@ SSL_CTX *proxy::SSLCert::get_client_cert() {
     SSL_CTX *client_cert = SSL_CTX_new(TLS_client_method());
 
     if (client_cert == nullptr) {
-        ERR_print_errors_fp(stderr);
-        ERR_clear_error();
+        log_errors("Can't create TLS context");
         return nullptr;
     }
     return client_cert;
@@ -39,8 +39,7 @@ SSL_CTX *proxy::SSLCert::get_server_cert(const std::string &domain) {
     SSL_CTX *server_cert = SSL_CTX_new(method_server);
 
     if (server_cert == nullptr) {
-        ERR_print_errors_fp(stderr);
-        ERR_clear_error();
+        log_errors("Can't create TLS context");
         return nullptr;
     }
 
@@ -77,39 +76,44 @@ bool proxy::SSLCert::file_cert(SSL_CTX *cert, const std::string &domain) {
     _is_init = true;
     if (SSL_CTX_load_verify_locations(cert, cert_file.data(),
                                       _key_file.data()) != 1) {
-        ERR_print_errors_fp(stderr);
-        ERR_clear_error();
+        log_errors(cert_file);
         return false;
     }
 
     if (SSL_CTX_set_default_verify_paths(cert) != 1) {
-        ERR_print_errors_fp(stderr);
-        ERR_clear_error();
+        log_errors(cert_file);
         return false;
     }
 
     if (SSL_CTX_use_certificate_file(cert, cert_file.data(),
                                      SSL_FILETYPE_PEM) <= 0) {
-        ERR_print_errors_fp(stderr);
-        ERR_clear_error();
+        log_errors(cert_file);
         return false;
     }
 
     if (SSL_CTX_use_PrivateKey_file(cert, _key_file.data(), SSL_FILETYPE_PEM) <=
         0) {
-        ERR_print_errors_fp(stderr);
-        ERR_clear_error();
+        log_errors(cert_file);
         return false;
     }
 
     if (!SSL_CTX_check_private_key(cert)) {
-        fprintf(stderr, "Private key does not match the public certificate\n");
+        logging::error({"Private key does not match the public certificate ", cert_file});
         return false;
     }
 
     return true;
 }
 
+void proxy::SSLCert::log_errors(std::string_view context) {
+    char text[256];
+    for (auto code = ERR_get_error(); code != 0; code = ERR_get_error()) {
+        ERR_error_string_n(code, text, sizeof(text));
+        logging::error({context, ": ", text});
+    }
+    ERR_clear_error();
+}
+
 void proxy::SSLCert::free_cert(SSL_CTX *_cert) {
     SSL_CTX_free(_cert);
 }
@@ -0,0 +1,22 @@
+#include "stored_request.hpp"
+#include "logger_lib.hpp"
+
+#include <exception>
+
+namespace proxy {
+
+std::string load_stored_request(size_t id, const request_lookup_t &lookup, rp::request_t &res) {
+    try {
+        res = lookup(id);
+    } catch (std::exception &ex) {
+        logging::error({ex.what()});
+        return "HTTP/1.1 500 Server error  \n BD error \n\n";
+    }
+
+    if (!res.is_valid) {
+        return "HTTP/1.1 404 Not found  \n Not found id \n\n";
+    }
+    return "";
+}
+
+}
@@ -1,6 +1,7 @@
 #include "tls_socket.hpp"
 #include "ssl_cert.hpp"
 
+#include <cerrno>
 #include <iostream>
 
 extern "C" {
@@ -12,7 +13,37 @@ SSLSocket::~SSLSocket() {
     TcpSocket::~TcpSocket();
 }
 
-status SSLSocket::init(TcpSocket &&base_socket, bool client, std::string domain) {
+status SSLSocket::init(TcpSocket &&base_socket, bool client, std::string domain, long timeout) {
+    if (auto sts = _prepare(std::move(base_socket), client, domain); sts != bstcp::status::connected) {
+        return sts;
+    }
+
+    // Accepted sockets are non-blocking, each step waits for the socket the
+    // way init_async() does instead of retrying at once
+    auto step = _handshake();
+    while (step == handshake_t::want_read || step == handshake_t::want_write) {
+        bool ready = step == handshake_t::want_read ? is_allow_to_read(timeout) : is_allow_to_write(timeout);
+        step = ready ? _handshake() : handshake_t::failed;
+    }
+    return _finish_handshake(step);
+}
+
+bstcp::Task<status> SSLSocket::init_async(bstcp::EventLoop &loop, TcpSocket &&base_socket, long timeout,
+                                          bool client, std::string domain) {
+    if (auto sts = _prepare(std::move(base_socket), client, domain); sts != bstcp::status::connected) {
+        co_return sts;
+    }
+
+    auto step = _handshake();
+    while (step == handshake_t::want_read || step == handshake_t::want_write) {
+        bool ready = co_await (step == handshake_t::want_read ? loop.readable(_socket, timeout)
+                                                              : loop.writable(_socket, timeout));
+        step = ready ? _handshake() : handshake_t::failed;
+    }
+    co_return _finish_handshake(step);
+}
+
+status SSLSocket::_prepare(TcpSocket &&base_socket, bool client, const std::string &domain) {
     if (base_socket._status != bstcp::status::connected) {
         return _ssl_status = base_socket._status;
     }
@@ -56,23 +87,35 @@ status SSLSocket::init(TcpSocket &&base_socket, bool client, std::string domain)
     }
 
     SSL_set_fd(_ssl_socket, (int) _socket);
-
-    int status = 0;
     if (client) {
-        status = SSL_connect(_ssl_socket);
+        SSL_set_connect_state(_ssl_socket);
     } else {
-        status = SSL_accept(_ssl_socket);
-        auto ret = SSL_get_error(_ssl_socket, status);
-        while (ret == SSL_ERROR_WANT_READ || ret == SSL_ERROR_WANT_WRITE) {
-            ret = SSL_get_error(_ssl_socket, status);
+        SSL_set_accept_state(_ssl_socket);
+    }
+    return bstcp::status::connected;
+}
+
+SSLSocket::handshake_t SSLSocket::_handshake() {
+    auto status = SSL_do_handshake(_ssl_socket);
+    if (status == 1) {
+        return handshake_t::done;
+    }
+
+    switch (SSL_get_error(_ssl_socket, status)) {
+        case SSL_ERROR_WANT_READ:
             ERR_clear_error();
-            status = SSL_accept(_ssl_socket);
-        }
+            return handshake_t::want_read;
+        case SSL_ERROR_WANT_WRITE:
+            ERR_clear_error();
+            return handshake_t::want_write;
+        default:
+            return handshake_t::failed;
     }
+}
 
-    if (status != 1) {
-        ERR_print_errors_fp(stdout);
-        ERR_clear_error();
+status SSLSocket::_finish_handshake(handshake_t result) {
+    if (result != handshake_t::done) {
+        SSLCert::log_errors("TLS handshake failed");
         SSLCert::free_cert(_cert);
         return _ssl_status = bstcp::status::err_socket_connect;
     }
@@ -95,6 +138,34 @@ bool SSLSocket::recv_from(void *buffer, int size) {
     return true;
 }
 
+int SSLSocket::recv_some(void *buffer, int size) {
+    if (_ssl_status != SocketStatus::connected) {
+        return -1;
+    }
+
+    auto answ = SSL_read(_ssl_socket, buffer, size);
+    if (answ <= 0) {
+        auto err = SSL_get_error(_ssl_socket, answ);
+        ERR_clear_error();
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+            errno = EAGAIN;
+        }
+        return err == SSL_ERROR_ZERO_RETURN ? 0 : -1;
+    }
+    return answ;
+}
+
+int SSLSocket::get_pending() const {
+    return _ssl_status == SocketStatus::connected ? SSL_pending(_ssl_socket) : 0;
+}
+
+bool SSLSocket::is_allow_to_read(long timeout) const {
+    if (get_pending() > 0) {
+        return true;
+    }
+    return TcpSocket::is_allow_to_read(timeout);
+}
+
 bool SSLSocket::send_to(const void *buffer, int size) const {
     if (_ssl_status != SocketStatus::connected) {
         return false;
@@ -108,6 +179,22 @@ bool SSLSocket::send_to(const void *buffer, int size) const {
     return true;
 }
 
+int SSLSocket::send_some(const void *buffer, int size) {
+    if (_ssl_status != SocketStatus::connected) {
+        return -1;
+    }
+
+    // Retried with the same buffer after EAGAIN, as OpenSSL requires
+    auto answ = SSL_write(_ssl_socket, buffer, size);
+    if (answ <= 0) {
+        auto err = SSL_get_error(_ssl_socket, answ);
+        ERR_clear_error();
+        errno = err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE ? EAGAIN : EIO;
+        return -1;
+    }
+    return answ;
+}
+
 status SSLSocket::disconnect() {
     _clear_ssl();
     return TcpSocket::disconnect();
@@ -0,0 +1,81 @@
+#include "upstream_pool.hpp"
+#include "tls_socket.hpp"
+
+namespace proxy {
+
+UpstreamPool::UpstreamPool(connector_t connector, size_t max_idle_per_host)
+        : _connector(std::move(connector))
+          , _max_idle_per_host(max_idle_per_host)
+          , _idle()
+          , _stats() {}
+
+std::unique_ptr<TcpSocket> UpstreamPool::acquire(const std::string &host, size_t port, bool is_https,
+                                                 bool &reused, std::string &error) {
+    // Closed after unlocking, a TLS shutdown would hold up every other host
+    std::vector<std::unique_ptr<TcpSocket>> discarded;
+    {
+        std::lock_guard<std::mutex> lck(_mutex);
+        auto it = _idle.find({host, port, is_https});
+        while (it != _idle.end() && !it->second.empty()) {
+            auto socket = std::move(it->second.back());
+            it->second.pop_back();
+            _stats.idle--;
+
+            // An idle connection has nothing to read unless the server closed it
+            if (socket->is_allow_to_read(0)) {
+                _stats.discarded++;
+                discarded.push_back(std::move(socket));
+                continue;
+            }
+            _stats.reused++;
+            reused = true;
+            return socket;
+        }
+    }
+    discarded.clear();
+
+    reused = false;
+    TcpSocket to;
+    error = _connector(host, port, to);
+    if (!error.empty()) {
+        return nullptr;
+    }
+
+    std::unique_ptr<TcpSocket> socket;
+    if (is_https) {
+        auto ssl_socket = std::make_unique<SSLSocket>();
+        if (ssl_socket->init(std::move(to)) != bstcp::status::connected) {
+            error = "HTTP/1.1 525 SSL Handshake Failed \n Can't connect to server by tls \n\n";
+            return nullptr;
+        }
+        socket = std::move(ssl_socket);
+    } else {
+        socket = std::make_unique<TcpSocket>(std::move(to));
+    }
+
+    std::lock_guard<std::mutex> lck(_mutex);
+    _stats.connects++;
+    return socket;
+}
+
+void UpstreamPool::release(const std::string &host, size_t port, bool is_https, std::unique_ptr<TcpSocket> socket) {
+    std::lock_guard<std::mutex> lck(_mutex);
+    auto &idle = _idle[{host, port, is_https}];
+    if (idle.size() >= _max_idle_per_host) {
+        return;
+    }
+    idle.push_back(std::move(socket));
+    _stats.idle++;
+}
+
+void UpstreamPool::set_max_idle_per_host(size_t max_idle_per_host) {
+    std::lock_guard<std::mutex> lck(_mutex);
+    _max_idle_per_host = max_idle_per_host;
+}
+
+upstream_stats_t UpstreamPool::get_stats() const {
+    std::lock_guard<std::mutex> lck(_mutex);
+    return _stats;
+}
+
+}
@@ -0,0 +1,127 @@
+#include "include/aho_corasick.hpp"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using proxy::AhoCorasick;
+
+TEST(AhoCorasick, FindsEachPattern) {
+    AhoCorasick matcher({"root:", "uid=", "[boot loader]"});
+    EXPECT_EQ(matcher.find("xx root:x:0:0"), 0);
+    EXPECT_EQ(matcher.find("uid=0(root)"), 1);
+    EXPECT_EQ(matcher.find("...[boot loader]..."), 2);
+    EXPECT_EQ(matcher.find("nothing here"), AhoCorasick::no_match);
+    EXPECT_EQ(matcher.find(""), AhoCorasick::no_match);
+}
+
+TEST(AhoCorasick, ReportsFirstPatternToEnd) {
+    // "bc" ends before "abcd" does
+    AhoCorasick matcher({"abcd", "bc"});
+    EXPECT_EQ(matcher.find("abcd"), 1);
+
+    // A pattern that is a suffix of the current match is found through the failure links
+    AhoCorasick suffixes({"she", "he"});
+    EXPECT_EQ(suffixes.find("ahe"), 1);
+    EXPECT_EQ(suffixes.find("she"), 0);
+}
+
+TEST(AhoCorasick, IgnoresEmptyPatterns) {
+    AhoCorasick matcher({"", "x"});
+    EXPECT_EQ(matcher.find("abc"), AhoCorasick::no_match);
+    EXPECT_EQ(matcher.find("abx"), 1);
+
+    AhoCorasick none;
+    EXPECT_EQ(none.find("anything"), AhoCorasick::no_match);
+    EXPECT_EQ(none.get_nodes_count(), 1u);
+}
+
+TEST(AhoCorasick, DuplicatePatternsReportTheFirst) {
+    AhoCorasick matcher({"dup", "dup"});
+    EXPECT_EQ(matcher.find("a dup"), 0);
+    EXPECT_EQ(matcher.get_nodes_count(), 4u);
+}
+
+TEST(AhoCorasick, MatchesBinaryData) {
+    std::string pattern("\x00\xff\x80", 3);
+    AhoCorasick matcher({pattern});
+    EXPECT_EQ(matcher.find(std::string("ab\x00\xff\x80", 5)), 0);
+    EXPECT_EQ(matcher.find(std::string("ab\x00\xff", 4)), AhoCorasick::no_match);
+}
+
+TEST(AhoCorasick, StreamsAcrossChunks) {
+    AhoCorasick matcher({"root:x:0:0", "secret"});
+    std::string response = "HTTP/1.1 200 OK\r\n\r\nroot:x:0:0:root:/root:/bin/bash";
+    for (size_t split = 0; split <= response.size(); ++split) {
+        AhoCorasick::state_t state;
+        auto found = matcher.feed(state, std::string_view(response).substr(0, split));
+        if (found == AhoCorasick::no_match) {
+            found = matcher.feed(state, std::string_view(response).substr(split));
+        }
+        EXPECT_EQ(found, 0) << "split " << split;
+    }
+
+    // One byte at a time
+    AhoCorasick::state_t state;
+    int found = AhoCorasick::no_match;
+    for (char c: std::string("xxsecrexsecret")) {
+        if ((found = matcher.feed(state, std::string_view(&c, 1))) != AhoCorasick::no_match) {
+            break;
+        }
+    }
+    EXPECT_EQ(found, 1);
+}
+
+TEST(AhoCorasick, FreshStateForgetsPreviousInput) {
+    AhoCorasick matcher({"abc"});
+    AhoCorasick::state_t state;
+    EXPECT_EQ(matcher.feed(state, "ab"), AhoCorasick::no_match);
+    EXPECT_EQ(matcher.feed(state, "c"), 0);
+
+    // What a retried probe does: a cut off response doesn't complete a match
+    state = AhoCorasick::state_t();
+    EXPECT_EQ(matcher.feed(state, "ab"), AhoCorasick::no_match);
+    state = AhoCorasick::state_t();
+    EXPECT_EQ(matcher.feed(state, "c"), AhoCorasick::no_match);
+}
+
+TEST(AhoCorasick, AgreesWithNaiveSearch) {
+    std::mt19937 random(42);
+    auto make = [&random](size_t max_size) {
+        std::string res(random() % max_size + 1, 'a');
+        for (auto &c: res) {
+            c = (char) ('a' + random() % 3);
+        }
+        return res;
+    };
+
+    for (int round = 0; round < 500; ++round) {
+        std::vector<std::string> patterns;
+        for (size_t i = 0, count = random() % 5 + 1; i < count; ++i) {
+            patterns.push_back(make(4));
+        }
+        AhoCorasick matcher(patterns);
+        auto text = make(40);
+
+        // The earliest position at which some pattern ends
+        size_t end = std::string::npos;
+        for (auto &pattern: patterns) {
+            auto pos = text.find(pattern);
+            if (pos != std::string::npos) {
+                end = std::min(end, pos + pattern.size());
+            }
+        }
+
+        auto found = matcher.find(text);
+        if (end == std::string::npos) {
+            EXPECT_EQ(found, AhoCorasick::no_match) << text;
+            continue;
+        }
+        ASSERT_NE(found, AhoCorasick::no_match) << text;
+        auto &pattern = patterns[found];
+        EXPECT_GE(end, pattern.size()) << text;
+        EXPECT_EQ(text.substr(end - pattern.size(), pattern.size()), pattern) << text;
+    }
+}
@@ -0,0 +1,186 @@
+#include "include/response_reader.hpp"
+
+#include <cstring>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using proxy::read_response;
+
+// Hands out the parts one recv at a time. After the last part the peer
+// either closes the connection or goes quiet until the timeout
+class FakeSocket : public bstcp::ISocket {
+  public:
+    FakeSocket(std::vector<std::string> parts, bool closes)
+            : _parts(parts.begin(), parts.end())
+              , _closes(closes) {}
+
+    bool recv_from(void *, int) override {
+        return false;
+    }
+
+    int recv_some(void *buffer, int size) override {
+        if (_parts.empty()) {
+            return 0;
+        }
+        auto &part = _parts.front();
+        auto count = std::min((size_t) size, part.size());
+        std::memcpy(buffer, part.data(), count);
+        part.erase(0, count);
+        if (part.empty()) {
+            _parts.pop_front();
+        }
+        reads++;
+        return (int) count;
+    }
+
+    bool send_to(const void *, int) const override {
+        return true;
+    }
+
+    bstcp::status disconnect() override {
+        return bstcp::status::disconnected;
+    }
+
+    [[nodiscard]] bstcp::status get_status() const override {
+        return bstcp::status::connected;
+    }
+
+    [[nodiscard]] uint32_t get_host() const override {
+        return 0;
+    }
+
+    [[nodiscard]] uint16_t get_port() const override {
+        return 0;
+    }
+
+    [[nodiscard]] bstcp::SocketType get_type() const override {
+        return bstcp::SocketType::client_socket;
+    }
+
+    [[nodiscard]] bool is_allow_to_read(long) const override {
+        return !_parts.empty() || _closes;
+    }
+
+    [[nodiscard]] bool is_allow_to_write(long) const override {
+        return true;
+    }
+
+    [[nodiscard]] bool is_allow_to_rwrite(long) const override {
+        return true;
+    }
+
+    [[nodiscard]] bool drained() const {
+        return _parts.empty();
+    }
+
+    size_t reads = 0;
+
+  private:
+    std::deque<std::string> _parts;
+    bool                    _closes;
+};
+
+TEST(ReadResponse, ContentLengthInParts) {
+    FakeSocket socket({"HTTP/1.1 200 OK\r\nContent-Len", "gth: 10\r\n\r\n01234", "56789"}, false);
+    auto res = read_response(socket, 10);
+    EXPECT_TRUE(res.complete);
+    EXPECT_TRUE(res.keep_alive);
+    EXPECT_EQ(res.status, 200);
+    EXPECT_EQ(res.data, "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n0123456789");
+}
+
+TEST(ReadResponse, StopsAtTheEndOfMessage) {
+    // The next response on the connection is not waited for
+    FakeSocket socket({"HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nok", "HTTP/1.1 200 OK\r\n"}, false);
+    auto res = read_response(socket, 10);
+    EXPECT_TRUE(res.complete);
+    EXPECT_FALSE(socket.drained());
+}
+
+TEST(ReadResponse, Chunked) {
+    FakeSocket socket({"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n4\r\nWiki\r\n",
+                       "5\r\npedia\r\n", "0\r\n", "\r\n"}, false);
+    auto res = read_response(socket, 10);
+    EXPECT_TRUE(res.complete);
+    EXPECT_TRUE(res.keep_alive);
+    EXPECT_EQ(socket.reads, 4u);
+}
+
+TEST(ReadResponse, ChunkedWithTrailers) {
+    FakeSocket socket({"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n"
+                       "3\r\nabc\r\n0\r\nX-Checksum: 1\r\n", "\r\n"}, false);
+    auto res = read_response(socket, 10);
+    EXPECT_TRUE(res.complete);
+    EXPECT_EQ(socket.reads, 2u);
+}
+
+TEST(ReadResponse, ChunkSizeLooksLikeEnd) {
+    // "0\r\n" inside chunk data must not end the body
+    FakeSocket socket({"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\n0\r\n\r\n\r\n"}, false);
+    auto res = read_response(socket, 10);
+    EXPECT_FALSE(res.complete);
+}
+
+TEST(ReadResponse, EndOfConnectionFramesBodyWithoutLength) {
+    FakeSocket socket({"HTTP/1.1 200 OK\r\n\r\nsome", " body"}, true);
+    auto res = read_response(socket, 10);
+    EXPECT_TRUE(res.complete);
+    EXPECT_FALSE(res.keep_alive);
+    EXPECT_EQ(res.data, "HTTP/1.1 200 OK\r\n\r\nsome body");
+}
+
+TEST(ReadResponse, ConnectionCloseBeforeLengthIsIncomplete) {
+    FakeSocket socket({"HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n01234"}, true);
+    auto res = read_response(socket, 10);
+    EXPECT_FALSE(res.complete);
+    EXPECT_FALSE(res.keep_alive);
+}
+
+TEST(ReadResponse, TimeoutIsIncomplete) {
+    FakeSocket socket({"HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n01234"}, false);
+    auto res = read_response(socket, 10);
+    EXPECT_FALSE(res.complete);
+    EXPECT_EQ(res.status, 200);
+}
+
+TEST(ReadResponse, BodylessResponses) {
+    for (std::string status : {"204 No Content", "304 Not Modified"}) {
+        FakeSocket socket({"HTTP/1.1 " + status + "\r\nContent-Length: 100\r\n\r\n"}, false);
+        auto res = read_response(socket, 10);
+        EXPECT_TRUE(res.complete) << status;
+        EXPECT_TRUE(res.keep_alive) << status;
+    }
+
+    FakeSocket head({"HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\n"}, false);
+    EXPECT_TRUE(read_response(head, 10, true).complete);
+}
+
+TEST(ReadResponse, KeepAliveFollowsVersionAndConnection) {
+    FakeSocket http_1_0({"HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n"}, false);
+    EXPECT_FALSE(read_response(http_1_0, 10).keep_alive);
+
+    FakeSocket kept({"HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\nContent-Length: 0\r\n\r\n"}, false);
+    EXPECT_TRUE(read_response(kept, 10).keep_alive);
+
+    FakeSocket closed({"HTTP/1.1 200 OK\r\nconnection: close\r\ncontent-length: 0\r\n\r\n"}, false);
+    auto res = read_response(closed, 10);
+    EXPECT_TRUE(res.complete);
+    EXPECT_FALSE(res.keep_alive);
+}
+
+TEST(ReadResponse, HandlerStopsReading) {
+    FakeSocket socket({"HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n01234", "56789"}, false);
+    std::string seen;
+    auto res = read_response(socket, 10, false, [&seen](std::string_view data) {
+        seen.append(data);
+        return seen.find("234") == std::string::npos;
+    });
+    EXPECT_TRUE(res.stopped);
+    EXPECT_FALSE(res.complete);
+    EXPECT_FALSE(res.keep_alive);
+    EXPECT_EQ(seen, res.data);
+    EXPECT_FALSE(socket.drained());
+}
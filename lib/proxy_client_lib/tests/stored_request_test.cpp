@@ -0,0 +1,49 @@
+#include "include/stored_request.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using proxy::load_stored_request;
+
+static rp::request_t stored(size_t id) {
+    rp::request_t res;
+    res.is_valid = true;
+    res.id = id;
+    res.host = "example.com";
+    res.port = 80;
+    return res;
+}
+
+TEST(StoredRequest, LoadsKnownId) {
+    rp::request_t res;
+    EXPECT_EQ(load_stored_request(7, stored, res), "");
+    EXPECT_TRUE(res.is_valid);
+    EXPECT_EQ(res.id, 7u);
+    EXPECT_EQ(res.host, "example.com");
+}
+
+TEST(StoredRequest, UnknownIdIsNotFound) {
+    // PQStoreRequest::get_by_id returns an invalid request for a missing row
+    size_t asked = 0;
+    rp::request_t res;
+    auto answer = load_stored_request(42, [&asked](size_t id) {
+        asked = id;
+        return rp::request_t{.is_valid = false, .is_https = false, .id = 0, .port = 0, .host = "",
+                             .request = http::Request()};
+    }, res);
+
+    EXPECT_EQ(asked, 42u);
+    EXPECT_EQ(answer.rfind("HTTP/1.1 404 ", 0), 0u);
+    EXPECT_NE(answer.find("Not found id"), std::string::npos);
+    EXPECT_FALSE(res.is_valid);
+}
+
+TEST(StoredRequest, LookupErrorIsServerError) {
+    rp::request_t res;
+    auto answer = load_stored_request(1, [](size_t) -> rp::request_t {
+        throw std::runtime_error("connection lost");
+    }, res);
+    EXPECT_EQ(answer.rfind("HTTP/1.1 500 ", 0), 0u);
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+
+namespace repository {
+    // Bounded lock-free MPMC queue (Vyukov). Capacity is rounded up to a power of two.
+    template<typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity)
+            : _mask(_round_capacity(capacity) - 1)
+            , _cells(std::make_unique<cell_t[]>(_mask + 1))
+            , _enqueue_pos(0)
+            , _dequeue_pos(0) {
+            for (size_t i = 0; i <= _mask; ++i) {
+                _cells[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        bool try_push(T&& value) {
+            cell_t* cell;
+            size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &_cells[pos & _mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                auto diff = (intptr_t) seq - (intptr_t) pos;
+                if (diff == 0) {
+                    if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = _enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            cell->value = std::move(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(T& value) {
+            cell_t* cell;
+            size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+            while (true) {
+                cell = &_cells[pos & _mask];
+                size_t seq = cell->sequence.load(std::memory_order_acquire);
+                auto diff = (intptr_t) seq - (intptr_t) (pos + 1);
+                if (diff == 0) {
+                    if (_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = _dequeue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            value = std::move(cell->value);
+            cell->sequence.store(pos + _mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Approximate, for metrics and wake-up decisions only
+        [[nodiscard]] size_t size() const {
+            auto enqueued = _enqueue_pos.load(std::memory_order_relaxed);
+            auto dequeued = _dequeue_pos.load(std::memory_order_relaxed);
+            return enqueued > dequeued ? enqueued - dequeued : 0;
+        }
+
+        [[nodiscard]] size_t capacity() const {
+            return _mask + 1;
+        }
+
+    private:
+        struct cell_t {
+            std::atomic<size_t> sequence;
+            T                   value;
+        };
+
+        static size_t _round_capacity(size_t capacity) {
+            size_t res = 2;
+            while (res < capacity) {
+                res <<= 1;
+            }
+            return res;
+        }
+
+        static constexpr size_t cache_line = 64;
+
+        const size_t                        _mask;
+        std::unique_ptr<cell_t[]>           _cells;
+        alignas(cache_line) std::atomic<size_t> _enqueue_pos;
+        alignas(cache_line) std::atomic<size_t> _dequeue_pos;
+    };
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bounded_queue.hpp"
+#include "history_spool.hpp"
+#include "pq_repository.hpp"
+
+namespace repository {
+    enum class OverflowPolicy : uint8_t {
+        drop    = 0,    // lose the request
+        block   = 1,    // wait for the writer to free a slot
+        spill   = 2,    // put it in the local spool (or in memory without one)
+    };
+
+    struct recorder_config_t {
+        size_t                      queue_capacity  = 4096;
+        size_t                      batch_size      = 256;
+        std::chrono::milliseconds   max_latency     = std::chrono::milliseconds(100);
+        OverflowPolicy              overflow        = OverflowPolicy::spill;
+
+        // Batches that fail to reach the database go to the local spool and
+        // are replayed once it answers again
+        bool                        use_spool       = true;
+        spool_config_t              spool           = {};
+        std::chrono::milliseconds   retry_interval  = std::chrono::milliseconds(1000);
+    };
+
+    struct recorder_metrics_t {
+        size_t recorded;        // requests accepted by record()
+        size_t written;         // requests stored in the database
+        size_t dropped;         // lost on overflow or on a failed batch
+        size_t spilled;         // went to the overflow list
+        size_t blocked;         // record() calls that had to wait
+        size_t batches;
+        size_t failed_batches;
+        size_t queue_depth;
+        size_t last_batch_size;
+        size_t last_flush_us;
+        size_t spooled;         // written to the local spool
+        size_t replayed;        // moved from the spool to the database
+        size_t spool_pending_bytes;
+        bool   db_available;
+    };
+
+    // Write-behind history: record() only enqueues, a background writer stores
+    // the requests in batches.
+    class HistoryRecorder {
+    public:
+        using sink_t = std::function<void(const std::vector<request_t>&)>;
+
+        HistoryRecorder(PQStoreRequest& rep, recorder_config_t config = {});
+
+        HistoryRecorder(sink_t sink, recorder_config_t config = {});
+
+        HistoryRecorder(const HistoryRecorder&) = delete;
+        HistoryRecorder& operator=(const HistoryRecorder&) = delete;
+
+        ~HistoryRecorder();
+
+        bool record(request_t&& req);
+
+        // record() that never waits: false, with `req` left as it was, when the
+        // queue is full and the overflow policy would have to act
+        bool try_record(request_t& req);
+
+        void flush();
+
+        [[nodiscard]] recorder_metrics_t get_metrics() const;
+
+        [[nodiscard]] const recorder_config_t& get_config() const;
+
+    private:
+        void _writer_loop();
+
+        size_t _collect_batch(std::vector<request_t>& batch);
+
+        void _write_batch(std::vector<request_t>& batch);
+
+        void _spool_batch(const std::vector<request_t>& batch);
+
+        void _replay_spool();
+
+        void _mark_db_down();
+
+        sink_t                      _sink;
+        recorder_config_t           _config;
+        BoundedQueue<request_t>     _queue;
+
+        std::mutex                  _spill_mutex;
+        std::deque<request_t>       _spill;
+
+        std::unique_ptr<HistorySpool>           _spool;
+        std::atomic<bool>                       _spool_dirty;
+        std::atomic<bool>                       _db_available;
+        std::chrono::steady_clock::time_point   _next_retry;
+
+        std::mutex                  _wake_mutex;
+        std::condition_variable     _wake;
+        std::condition_variable     _space;
+        std::atomic<size_t>         _flush_requests;
+        std::atomic<size_t>         _flushed;
+        std::atomic<bool>           _stop;
+
+        std::atomic<size_t>         _recorded;
+        std::atomic<size_t>         _written;
+        std::atomic<size_t>         _dropped;
+        std::atomic<size_t>         _spilled;
+        std::atomic<size_t>         _blocked;
+        std::atomic<size_t>         _batches;
+        std::atomic<size_t>         _failed_batches;
+        std::atomic<size_t>         _last_batch_size;
+        std::atomic<size_t>         _last_flush_us;
+        std::atomic<size_t>         _spooled;
+
+        std::thread                 _writer;
+    };
+}
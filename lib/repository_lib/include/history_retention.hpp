@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "pq_repository.hpp"
+
+namespace repository {
+    struct retention_config_t {
+        std::chrono::hours          keep            = std::chrono::hours(24 * 90);
+        std::chrono::minutes        interval        = std::chrono::minutes(60);
+        size_t                      months_ahead    = 2;
+    };
+
+    struct retention_metrics_t {
+        size_t runs;
+        size_t failed_runs;
+        size_t dropped_partitions;
+    };
+
+    // Background job keeping the monthly history partitions: creates the ones
+    // for the coming months and drops the ones older than `keep`.
+    class HistoryRetention {
+    public:
+        HistoryRetention(PQStoreRequest& rep, retention_config_t config = {});
+
+        HistoryRetention(const HistoryRetention&) = delete;
+        HistoryRetention& operator=(const HistoryRetention&) = delete;
+
+        ~HistoryRetention();
+
+        // Runs one pass on the calling thread, returns false if it failed
+        bool run_once();
+
+        [[nodiscard]] retention_metrics_t get_metrics() const;
+
+    private:
+        void _loop();
+
+        PQStoreRequest&             _rep;
+        retention_config_t          _config;
+
+        std::mutex                  _mutex;
+        std::condition_variable     _wake;
+        bool                        _stop;
+        std::thread                 _worker;
+
+        std::atomic<size_t>         _runs;
+        std::atomic<size_t>         _failed_runs;
+        std::atomic<size_t>         _dropped_partitions;
+    };
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "pq_repository.hpp"
+
+namespace repository {
+    struct spool_config_t {
+        std::string directory       = "spool";
+        size_t      segment_size    = 16 * 1024 * 1024;
+    };
+
+    struct spool_stats_t {
+        size_t appended;
+        size_t replayed;
+        size_t corrupted;       // records skipped because of a checksum mismatch
+        size_t segments;        // segment files on disk
+        size_t pending_bytes;   // written but not yet replayed
+    };
+
+    // Append-only local journal of requests that could not reach the database.
+    // Records live in memory-mapped segment files:
+    //  segment header: magic, version, offset of the first record not replayed yet
+    //  record: magic, payload size, crc32 of payload, payload
+    // A full segment is sealed and a new one is started.
+    class HistorySpool {
+    public:
+        using sink_t = std::function<void(const std::vector<request_t>&)>;
+
+        explicit HistorySpool(spool_config_t config);
+
+        HistorySpool(const HistorySpool&) = delete;
+        HistorySpool& operator=(const HistorySpool&) = delete;
+
+        ~HistorySpool();
+
+        bool append(const request_t& req);
+
+        // Feeds the segments spooled so far to `sink` oldest first, in batches,
+        // and sets `replayed` to the number of requests fed. Replayed segments are
+        // removed; on a sink error the rest stays for the next call and false is returned.
+        // Requests appended meanwhile go to a new segment left for the next call.
+        bool replay(const sink_t& sink, size_t batch_size, size_t& replayed);
+
+        [[nodiscard]] bool empty();
+
+        [[nodiscard]] spool_stats_t get_stats();
+
+    private:
+        struct segment_t {
+            size_t      index   = 0;
+            int         fd      = -1;
+            uint8_t*    data    = nullptr;
+            size_t      size    = 0;
+            size_t      offset  = 0;
+        };
+
+        bool _open_segment(size_t index, size_t min_size);
+
+        void _seal_segment();
+
+        [[nodiscard]] std::string _segment_path(size_t index) const;
+
+        std::vector<size_t> _list_segments() const;
+
+        bool _replay_segment(size_t index, const sink_t& sink, size_t batch_size, size_t& replayed);
+
+        spool_config_t  _config;
+        std::mutex      _mutex;
+        segment_t       _current;
+        size_t          _next_index;
+
+        size_t          _appended;
+        size_t          _replayed;
+        size_t          _corrupted;
+        size_t          _pending_bytes;
+    };
+}
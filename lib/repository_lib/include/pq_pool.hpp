@@ -1,29 +1,107 @@
 #pragma once
 
 #include <pqxx/connection>
+#include <array>
 #include <vector>
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
 #include <condition_variable>
 
 namespace repository {
+    struct pool_config_t {
+        size_t                      min_size        = 2;    // opened at start and kept open
+        size_t                      max_size        = 20;   // opened lazily under load
+        std::chrono::milliseconds   acquire_timeout = std::chrono::milliseconds(5000);
+    };
+
+    // Number of log2 buckets of the acquire wait histogram, bucket i counts
+    // waits shorter than 2^i microseconds
+    static const size_t pool_wait_buckets = 24;
+
+    struct pool_stats_t {
+        size_t                                  size;       // open connections
+        size_t                                  idle;
+        size_t                                  created;
+        size_t                                  replaced;   // broken connections given back
+        size_t                                  acquired;
+        size_t                                  timeouts;
+        std::vector<size_t>                     uses;       // per open connection
+        std::array<size_t, pool_wait_buckets>   wait_histogram;
+    };
+
+    class pool_timeout : public std::runtime_error {
+    public:
+        using std::runtime_error::runtime_error;
+    };
+
     class PQPool {
     public:
-        explicit PQPool(std::string connection_string);
+        // Called for every connection the pool opens, e.g. to prepare statements
+        using conn_init_t = std::function<void(pqxx::connection&)>;
+
+        // Connection taken from the pool, given back when the lease is destroyed
+        class Lease {
+        public:
+            Lease(PQPool& pool, std::shared_ptr<pqxx::connection> conn);
+
+            Lease(const Lease&) = delete;
+            Lease& operator=(const Lease&) = delete;
+
+            Lease(Lease&& lease) noexcept;
+            Lease& operator=(Lease&& lease) noexcept;
+
+            ~Lease();
+
+            pqxx::connection& operator*() const;
+            pqxx::connection* operator->() const;
+
+        private:
+            void _release();
+
+            PQPool*                             _pool;
+            std::shared_ptr<pqxx::connection>   _conn;
+        };
+
+        explicit PQPool(std::string connection_string, conn_init_t init = {}, pool_config_t config = {});
 
         PQPool(PQPool&& pool) noexcept;
 
-        std::shared_ptr<pqxx::connection> conn();
+        // Throws pool_timeout when no connection frees up within acquire_timeout
+        // and pqxx::broken_connection when the database can not be reached
+        Lease lease();
 
-        void free_conn(const std::shared_ptr<pqxx::connection>& conn);
+        [[nodiscard]] pool_stats_t get_stats() const;
 
     private:
+        std::shared_ptr<pqxx::connection> _acquire();
+
+        // Broken connections are closed here and replaced up to min_size
+        void _free_conn(const std::shared_ptr<pqxx::connection>& conn);
 
-        void _create_pool();
+        // Opens one connection without holding _mutex, false if it failed
+        bool _open_conn(std::unique_lock<std::mutex>& lck);
+
+        void _record_wait(std::chrono::steady_clock::duration wait);
 
         bool _is_moved;
 
-        std::mutex                                      _mutex;
+        mutable std::mutex                              _mutex;
         std::string                                     _connection_string;
+        conn_init_t                                     _init;
+        pool_config_t                                   _config;
         std::condition_variable                         _condition;
         std::vector<std::shared_ptr<pqxx::connection>>  _pool;
+        std::unordered_map<pqxx::connection*, size_t>   _uses;
+        size_t                                          _size;      // open plus being opened
+        std::chrono::steady_clock::time_point           _next_attempt;
+        std::chrono::milliseconds                       _retry_delay;
+
+        size_t                                          _created;
+        size_t                                          _replaced;
+        size_t                                          _acquired;
+        size_t                                          _timeouts;
+        std::array<size_t, pool_wait_buckets>           _wait_histogram;
     };
 }
\ No newline at end of file
@@ -2,7 +2,11 @@
 
 #include <pqxx/pqxx>
 
+#include <chrono>
+#include <functional>
+
 #include "pq_pool.hpp"
+#include "recent_history.hpp"
 #include "request_parser_lib.hpp"
 
 namespace repository {
@@ -18,17 +22,60 @@ namespace repository {
     class PQStoreRequest {
     public:
 
-        explicit PQStoreRequest(const std::string& connection_string);
+        // The last `recent_capacity` written requests are also kept in memory
+        // and served from there by get_by_id, get_list and stream_list
+        explicit PQStoreRequest(const std::string& connection_string, pool_config_t pool_config = {},
+                                size_t recent_capacity = 4096);
 
         request_t get_by_id(size_t id);
         request_t get_by_host(const std::string& host);
 
-        std::vector<request_t> get_list(size_t limit);
+        // Up to `limit` requests with id greater than `after_id`, ordered by id
+        std::vector<request_t> get_list(size_t after_id, size_t limit);
+
+        // Stored requests among `ids` ordered by id, the ones not in memory are
+        // read with one query; missing ids are skipped
+        std::vector<request_t> get_by_ids(const std::vector<size_t>& ids);
+
+        // Up to `limit` requests with id in [from, to], ordered by id
+        std::vector<request_t> get_range(size_t from, size_t to, size_t limit);
+
+        // Same rows as get_list, read from a server-side cursor `chunk_size` rows
+        // at a time and handed to `callback` one by one; returning false from it
+        // stops the scan. Returns the number of rows passed to `callback`
+        size_t stream_list(size_t after_id, size_t limit, size_t chunk_size,
+                           const std::function<bool(const request_t&)>& callback);
 
         size_t add(const request_t& req);
 
+        // Writes the whole batch with one COPY
+        void add_batch(const std::vector<request_t>& batch);
+
+        // Sends prepared inserts through a pipeline, returns ids in batch order
+        std::vector<size_t> add_pipelined(const std::vector<request_t>& batch);
+
+        // Re-encodes up to `batch_size` legacy json rows into request_bin,
+        // returns how many rows were converted
+        size_t migrate_json_rows(size_t batch_size);
+
+        // Creates monthly history partitions up to `months_ahead` from now
+        void ensure_partitions(size_t months_ahead);
+
+        // Drops partitions older than `keep`, returns their names
+        std::vector<std::string> drop_partitions(std::chrono::hours keep);
+
+        [[nodiscard]] pool_stats_t get_pool_stats() const;
+
+        [[nodiscard]] recent_stats_t get_recent_stats() const;
+
     private:
-        PQPool _rep;
+        std::vector<request_t> _get_list_db(size_t after_id, size_t limit);
+
+        size_t _stream_list_db(size_t after_id, size_t limit, size_t chunk_size,
+                               const std::function<bool(const request_t&)>& callback);
+
+        PQPool          _rep;
+        RecentHistory   _recent;
     };
 }
 
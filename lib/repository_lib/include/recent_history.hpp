@@ -0,0 +1,86 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace repository {
+    struct request_t;
+
+    struct recent_stats_t {
+        size_t capacity;
+        size_t published;       // highest id in the ring
+        size_t id_hits;
+        size_t id_misses;
+        size_t list_hits;       // list scans served from the ring alone
+        size_t list_misses;     // list scans that needed the database
+    };
+
+    struct recent_scan_t {
+        size_t sent;            // rows handed to the callback
+        size_t last_id;         // id the scan stopped after
+        bool   complete;        // false if the database has to continue from last_id
+    };
+
+    // Ring of the most recently written requests, the slot of a request is
+    // id % capacity. Lock-free: a slot holds a pointer to an immutable
+    // reference-counted entry, swapped in with a CAS that keeps the newest id.
+    // A reader guards the entry it loaded with a hazard pointer only until it
+    // has taken a reference, and a writer frees a replaced entry once no hazard
+    // points to it. Writers may publish concurrently and out of id order. An id
+    // up to published() that is not in its slot was evicted (a newer id took
+    // the slot), never written, or is still being committed, which is what the
+    // database would show for it at that moment too.
+    class RecentHistory {
+    public:
+        // Capacity is rounded up to a power of two, 0 disables the ring
+        explicit RecentHistory(size_t capacity);
+
+        RecentHistory(const RecentHistory&) = delete;
+        RecentHistory& operator=(const RecentHistory&) = delete;
+
+        ~RecentHistory();
+
+        void publish(const std::vector<request_t>& batch, const std::vector<size_t>& ids);
+
+        std::shared_ptr<const request_t> find(size_t id);
+
+        // Hands rows with id > after_id in id order to `callback`, at most `limit`
+        recent_scan_t scan(size_t after_id, size_t limit, const std::function<bool(const request_t&)>& callback);
+
+        [[nodiscard]] recent_stats_t get_stats() const;
+
+    private:
+        struct entry_t;
+
+        using slot_t = std::atomic<entry_t*>;
+        using hazard_t = std::atomic<entry_t*>;
+
+        // Readers guarding an entry at the same time; one more waits for a free hazard
+        static constexpr size_t hazard_count = 64;
+
+        // Loads `slot` and guards the entry with a hazard, nullptr for an empty slot
+        entry_t* _protect(const slot_t& slot, hazard_t*& hazard);
+
+        hazard_t& _claim_hazard(entry_t* entry);
+
+        // Drops the reference of a slot to `entry` once no hazard points to it
+        void _retire(entry_t* entry);
+
+        static void _release(entry_t* entry);
+
+        size_t                      _mask;
+        std::unique_ptr<slot_t[]>   _slots;
+        std::array<hazard_t, hazard_count> _hazards;
+        std::atomic<size_t>         _floor;         // first id ever published
+        std::atomic<size_t>         _published;
+
+        std::atomic<size_t>         _id_hits;
+        std::atomic<size_t>         _id_misses;
+        std::atomic<size_t>         _list_hits;
+        std::atomic<size_t>         _list_misses;
+    };
+}
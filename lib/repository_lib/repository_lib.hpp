@@ -1,3 +1,7 @@
 #pragma once
 
-#include "include/pq_repository.hpp"
\ No newline at end of file
+#include "include/pq_repository.hpp"
+#include "include/recent_history.hpp"
+#include "include/history_spool.hpp"
+#include "include/history_recorder.hpp"
+#include "include/history_retention.hpp"
\ No newline at end of file
@@ -0,0 +1,261 @@
+#include "history_recorder.hpp"
+#include "logger_lib.hpp"
+
+#include <utility>
+
+namespace repository {
+
+    HistoryRecorder::HistoryRecorder(PQStoreRequest& rep, recorder_config_t config)
+        : HistoryRecorder([&rep](const std::vector<request_t>& batch) { rep.add_batch(batch); },
+                          config) {}
+
+    HistoryRecorder::HistoryRecorder(sink_t sink, recorder_config_t config)
+        : _sink(std::move(sink))
+        , _config(config)
+        , _queue(config.queue_capacity)
+        , _spool_dirty(false)
+        , _db_available(true)
+        , _next_retry()
+        , _flush_requests(0)
+        , _flushed(0)
+        , _stop(false)
+        , _recorded(0)
+        , _written(0)
+        , _dropped(0)
+        , _spilled(0)
+        , _blocked(0)
+        , _batches(0)
+        , _failed_batches(0)
+        , _last_batch_size(0)
+        , _last_flush_us(0)
+        , _spooled(0) {
+        if (_config.batch_size == 0) {
+            _config.batch_size = 1;
+        }
+        if (_config.use_spool) {
+            _spool = std::make_unique<HistorySpool>(_config.spool);
+            // Leftovers of a previous run are replayed first
+            _spool_dirty = !_spool->empty();
+        }
+        _writer = std::thread(&HistoryRecorder::_writer_loop, this);
+    }
+
+    HistoryRecorder::~HistoryRecorder() {
+        _stop = true;
+        _wake.notify_one();
+        _space.notify_all();
+        if (_writer.joinable()) {
+            _writer.join();
+        }
+    }
+
+    bool HistoryRecorder::try_record(request_t& req) {
+        if (!_queue.try_push(std::move(req))) {
+            return false;
+        }
+        _recorded.fetch_add(1, std::memory_order_relaxed);
+        if (_queue.size() >= _config.batch_size) {
+            _wake.notify_one();
+        }
+        return true;
+    }
+
+    bool HistoryRecorder::record(request_t&& req) {
+        if (try_record(req)) {
+            return true;
+        }
+        _recorded.fetch_add(1, std::memory_order_relaxed);
+
+        switch (_config.overflow) {
+            case OverflowPolicy::drop:
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            case OverflowPolicy::block: {
+                _blocked.fetch_add(1, std::memory_order_relaxed);
+                std::unique_lock<std::mutex> lck(_wake_mutex);
+                while (!_queue.try_push(std::move(req))) {
+                    if (_stop) {
+                        _dropped.fetch_add(1, std::memory_order_relaxed);
+                        return false;
+                    }
+                    _wake.notify_one();
+                    _space.wait_for(lck, _config.max_latency);
+                }
+                return true;
+            }
+            case OverflowPolicy::spill:
+            default:
+                _spilled.fetch_add(1, std::memory_order_relaxed);
+                if (_spool && _spool->append(req)) {
+                    _spooled.fetch_add(1, std::memory_order_relaxed);
+                    _spool_dirty = true;
+                    return true;
+                }
+                {
+                    std::lock_guard<std::mutex> lck(_spill_mutex);
+                    _spill.push_back(std::move(req));
+                }
+                _wake.notify_one();
+                return true;
+        }
+    }
+
+    void HistoryRecorder::flush() {
+        auto ticket = _flush_requests.fetch_add(1) + 1;
+        _wake.notify_one();
+        std::unique_lock<std::mutex> lck(_wake_mutex);
+        _space.wait(lck, [this, ticket] {
+            return _flushed.load() >= ticket || _stop;
+        });
+    }
+
+    size_t HistoryRecorder::_collect_batch(std::vector<request_t>& batch) {
+        batch.clear();
+        {
+            std::lock_guard<std::mutex> lck(_spill_mutex);
+            while (!_spill.empty() && batch.size() < _config.batch_size) {
+                batch.push_back(std::move(_spill.front()));
+                _spill.pop_front();
+            }
+        }
+
+        request_t req;
+        while (batch.size() < _config.batch_size && _queue.try_pop(req)) {
+            batch.push_back(std::move(req));
+        }
+        return batch.size();
+    }
+
+    void HistoryRecorder::_mark_db_down() {
+        _db_available = false;
+        _next_retry = std::chrono::steady_clock::now() + _config.retry_interval;
+    }
+
+    void HistoryRecorder::_spool_batch(const std::vector<request_t>& batch) {
+        for (auto& req : batch) {
+            if (_spool && _spool->append(req)) {
+                _spooled.fetch_add(1, std::memory_order_relaxed);
+                _spool_dirty = true;
+            } else {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void HistoryRecorder::_replay_spool() {
+        if (!_spool || !_spool_dirty) {
+            return;
+        }
+        if (!_db_available && std::chrono::steady_clock::now() < _next_retry) {
+            return;
+        }
+
+        // Cleared first, so a request spooled during the replay sets it again
+        _spool_dirty = false;
+        size_t replayed = 0;
+        auto complete = _spool->replay([this](const std::vector<request_t>& batch) {
+            _sink(batch);
+            _written.fetch_add(batch.size(), std::memory_order_relaxed);
+        }, _config.batch_size, replayed);
+
+        if (replayed != 0) {
+            logging::info({"Replayed ", std::to_string(replayed), " spooled requests"});
+        }
+        if (complete) {
+            _db_available = true;
+        } else {
+            _spool_dirty = true;
+            _mark_db_down();
+        }
+    }
+
+    void HistoryRecorder::_write_batch(std::vector<request_t>& batch) {
+        auto start = std::chrono::steady_clock::now();
+
+        // While the database is down batches go straight to the spool
+        if (!_db_available && start < _next_retry && _spool) {
+            _spool_batch(batch);
+            return;
+        }
+
+        try {
+            _sink(batch);
+            _written.fetch_add(batch.size(), std::memory_order_relaxed);
+            _db_available = true;
+        } catch (std::exception& e) {
+            logging::error({"History batch of ", std::to_string(batch.size()), " requests failed: ", e.what()});
+            _failed_batches.fetch_add(1, std::memory_order_relaxed);
+            _mark_db_down();
+            _spool_batch(batch);
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - start);
+
+        _batches.fetch_add(1, std::memory_order_relaxed);
+        _last_batch_size = batch.size();
+        _last_flush_us = (size_t) elapsed.count();
+    }
+
+    void HistoryRecorder::_writer_loop() {
+        std::vector<request_t> batch;
+        batch.reserve(_config.batch_size);
+
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lck(_wake_mutex);
+                _wake.wait_for(lck, _config.max_latency, [this] {
+                    return _stop || _queue.size() >= _config.batch_size
+                           || _flush_requests > _flushed;
+                });
+            }
+
+            auto flush_ticket = _flush_requests.load();
+            _replay_spool();
+            while (_collect_batch(batch) != 0) {
+                _write_batch(batch);
+                _space.notify_all();
+                if (batch.size() < _config.batch_size) {
+                    break;
+                }
+            }
+
+            {
+                std::lock_guard<std::mutex> lck(_wake_mutex);
+                _flushed = flush_ticket;
+            }
+            _space.notify_all();
+
+            if (_stop) {
+                // Everything accepted before stop is written
+                while (_collect_batch(batch) != 0) {
+                    _write_batch(batch);
+                }
+                break;
+            }
+        }
+    }
+
+    recorder_metrics_t HistoryRecorder::get_metrics() const {
+        auto spool = _spool ? _spool->get_stats() : spool_stats_t{};
+        return {
+            .recorded = _recorded.load(std::memory_order_relaxed),
+            .written = _written.load(std::memory_order_relaxed),
+            .dropped = _dropped.load(std::memory_order_relaxed),
+            .spilled = _spilled.load(std::memory_order_relaxed),
+            .blocked = _blocked.load(std::memory_order_relaxed),
+            .batches = _batches.load(std::memory_order_relaxed),
+            .failed_batches = _failed_batches.load(std::memory_order_relaxed),
+            .queue_depth = _queue.size(),
+            .last_batch_size = _last_batch_size.load(std::memory_order_relaxed),
+            .last_flush_us = _last_flush_us.load(std::memory_order_relaxed),
+            .spooled = _spooled.load(std::memory_order_relaxed),
+            .replayed = spool.replayed,
+            .spool_pending_bytes = spool.pending_bytes,
+            .db_available = _db_available.load(),
+        };
+    }
+
+    const recorder_config_t& HistoryRecorder::get_config() const {
+        return _config;
+    }
+}
@@ -0,0 +1,64 @@
+#include "history_retention.hpp"
+#include "logger_lib.hpp"
+
+
+namespace repository {
+
+    HistoryRetention::HistoryRetention(PQStoreRequest& rep, retention_config_t config)
+        : _rep(rep)
+        , _config(config)
+        , _stop(false)
+        , _runs(0)
+        , _failed_runs(0)
+        , _dropped_partitions(0) {
+        _worker = std::thread(&HistoryRetention::_loop, this);
+    }
+
+    HistoryRetention::~HistoryRetention() {
+        {
+            std::lock_guard<std::mutex> lck(_mutex);
+            _stop = true;
+        }
+        _wake.notify_one();
+        if (_worker.joinable()) {
+            _worker.join();
+        }
+    }
+
+    bool HistoryRetention::run_once() {
+        _runs.fetch_add(1, std::memory_order_relaxed);
+        try {
+            _rep.ensure_partitions(_config.months_ahead);
+            for (auto& name : _rep.drop_partitions(_config.keep)) {
+                logging::info({"History partition ", name, " dropped by retention"});
+                _dropped_partitions.fetch_add(1, std::memory_order_relaxed);
+            }
+        } catch (std::exception& e) {
+            logging::error({"History retention failed: ", e.what()});
+            _failed_runs.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    void HistoryRetention::_loop() {
+        std::unique_lock<std::mutex> lck(_mutex);
+        while (!_stop) {
+            lck.unlock();
+            run_once();
+            lck.lock();
+
+            _wake.wait_for(lck, _config.interval, [this] {
+                return _stop;
+            });
+        }
+    }
+
+    retention_metrics_t HistoryRetention::get_metrics() const {
+        return {
+            .runs = _runs.load(std::memory_order_relaxed),
+            .failed_runs = _failed_runs.load(std::memory_order_relaxed),
+            .dropped_partitions = _dropped_partitions.load(std::memory_order_relaxed),
+        };
+    }
+}
@@ -0,0 +1,338 @@
+#include "history_spool.hpp"
+#include "logger_lib.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+static const uint32_t segment_magic = 0x4c505348; // "HSPL"
+static const uint32_t segment_version = 1;
+static const uint32_t record_magic = 0x52505348;  // "HSPR"
+
+static const char* segment_prefix = "segment-";
+static const char* segment_suffix = ".spool";
+
+namespace {
+    struct segment_header_t {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t replayed_offset;
+    };
+
+    struct record_header_t {
+        uint32_t magic;
+        uint32_t size;
+        uint32_t crc;
+    };
+
+    std::array<uint32_t, 256> make_crc_table() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; ++j) {
+                crc = (crc & 1) ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }
+
+    uint32_t crc32(const uint8_t* data, size_t size) {
+        static const auto table = make_crc_table();
+        uint32_t crc = 0xffffffff;
+        for (size_t i = 0; i < size; ++i) {
+            crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+        }
+        return crc ^ 0xffffffff;
+    }
+
+    // payload: is_https, port, host size, host, encoded request
+    std::string encode_payload(const repository::request_t& req) {
+        auto request = req.request.encode();
+        std::string res;
+        res.reserve(1 + 2 + 2 + req.host.size() + request.size());
+        res += (char) req.is_https;
+        auto port = (uint16_t) req.port;
+        auto host_size = (uint16_t) std::min(req.host.size(), (size_t) UINT16_MAX);
+        res.append(reinterpret_cast<const char*>(&port), sizeof(port));
+        res.append(reinterpret_cast<const char*>(&host_size), sizeof(host_size));
+        res.append(req.host.data(), host_size);
+        res += request;
+        return res;
+    }
+
+    bool decode_payload(std::string_view data, repository::request_t& req) {
+        uint16_t port = 0, host_size = 0;
+        if (data.size() < 1 + sizeof(port) + sizeof(host_size)) {
+            return false;
+        }
+        req.is_https = data[0] != 0;
+        std::memcpy(&port, data.data() + 1, sizeof(port));
+        std::memcpy(&host_size, data.data() + 1 + sizeof(port), sizeof(host_size));
+        data.remove_prefix(1 + sizeof(port) + sizeof(host_size));
+        if (data.size() < host_size) {
+            return false;
+        }
+        req.is_valid = true;
+        req.id = 0;
+        req.port = port;
+        req.host = std::string(data.substr(0, host_size));
+        return req.request.decode(data.substr(host_size));
+    }
+}
+
+namespace repository {
+
+    HistorySpool::HistorySpool(spool_config_t config)
+        : _config(std::move(config))
+        , _current()
+        , _next_index(1)
+        , _appended(0)
+        , _replayed(0)
+        , _corrupted(0)
+        , _pending_bytes(0) {
+        std::error_code ec;
+        fs::create_directories(_config.directory, ec);
+        if (ec) {
+            logging::error({"Can't create spool directory ", _config.directory, ": ", ec.message()});
+        }
+
+        auto segments = _list_segments();
+        if (!segments.empty()) {
+            _next_index = segments.back() + 1;
+        }
+        for (auto index : segments) {
+            std::error_code size_ec;
+            auto size = fs::file_size(_segment_path(index), size_ec);
+            _pending_bytes += size_ec ? 0 : size;
+        }
+    }
+
+    HistorySpool::~HistorySpool() {
+        std::lock_guard<std::mutex> lck(_mutex);
+        _seal_segment();
+    }
+
+    std::string HistorySpool::_segment_path(size_t index) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%s%08zu%s", segment_prefix, index, segment_suffix);
+        return (fs::path(_config.directory) / name).string();
+    }
+
+    std::vector<size_t> HistorySpool::_list_segments() const {
+        std::vector<size_t> res;
+        std::error_code ec;
+        for (auto& entry : fs::directory_iterator(_config.directory, ec)) {
+            auto name = entry.path().filename().string();
+            if (name.rfind(segment_prefix, 0) != 0 || entry.path().extension() != segment_suffix) {
+                continue;
+            }
+            res.push_back(strtoul(name.c_str() + strlen(segment_prefix), nullptr, 10));
+        }
+        std::sort(res.begin(), res.end());
+        return res;
+    }
+
+    bool HistorySpool::_open_segment(size_t index, size_t min_size) {
+        auto size = std::max(_config.segment_size, min_size + sizeof(segment_header_t));
+        auto path = _segment_path(index);
+
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        if (ftruncate(fd, (off_t) size) != 0) {
+            close(fd);
+            return false;
+        }
+        auto data = static_cast<uint8_t*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        if (data == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+
+        segment_header_t header{segment_magic, segment_version, sizeof(segment_header_t)};
+        std::memcpy(data, &header, sizeof(header));
+
+        _current = {index, fd, data, size, sizeof(segment_header_t)};
+        return true;
+    }
+
+    void HistorySpool::_seal_segment() {
+        if (_current.data == nullptr) {
+            return;
+        }
+        msync(_current.data, _current.size, MS_ASYNC);
+        munmap(_current.data, _current.size);
+        // Drop the unused tail so the file holds only records
+        if (ftruncate(_current.fd, (off_t) _current.offset) != 0) {
+            logging::warning({"Can't truncate spool segment ", std::to_string(_current.index)});
+        }
+        close(_current.fd);
+        _current = segment_t();
+    }
+
+    bool HistorySpool::append(const request_t& req) {
+        auto payload = encode_payload(req);
+        auto record_size = sizeof(record_header_t) + payload.size();
+
+        std::lock_guard<std::mutex> lck(_mutex);
+        if (_current.data != nullptr && _current.offset + record_size > _current.size) {
+            _seal_segment();
+        }
+        if (_current.data == nullptr && !_open_segment(_next_index++, record_size)) {
+            logging::error({"Can't open spool segment in ", _config.directory});
+            return false;
+        }
+
+        record_header_t header{record_magic, (uint32_t) payload.size(),
+                               crc32(reinterpret_cast<const uint8_t*>(payload.data()), payload.size())};
+        auto place = _current.data + _current.offset;
+        std::memcpy(place + sizeof(header), payload.data(), payload.size());
+        std::memcpy(place, &header, sizeof(header));
+        _current.offset += record_size;
+
+        _appended++;
+        _pending_bytes += record_size;
+        return true;
+    }
+
+    bool HistorySpool::_replay_segment(size_t index, const sink_t& sink, size_t batch_size, size_t& replayed) {
+        auto path = _segment_path(index);
+        int fd = open(path.c_str(), O_RDWR);
+        if (fd < 0) {
+            return true;
+        }
+
+        struct stat st{};
+        if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(segment_header_t)) {
+            close(fd);
+            fs::remove(path);
+            return true;
+        }
+        auto size = (size_t) st.st_size;
+        auto data = static_cast<uint8_t*>(mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        close(fd);
+        if (data == MAP_FAILED) {
+            return false;
+        }
+
+        segment_header_t segment{};
+        std::memcpy(&segment, data, sizeof(segment));
+        if (segment.magic != segment_magic || segment.replayed_offset > size) {
+            munmap(data, size);
+            {
+                std::lock_guard<std::mutex> lck(_mutex);
+                _corrupted++;
+            }
+            fs::remove(path);
+            return true;
+        }
+
+        bool complete = true;
+        std::vector<request_t> batch;
+        size_t offset = segment.replayed_offset;
+        size_t batch_end = offset;
+        while (true) {
+            bool end = offset + sizeof(record_header_t) > size;
+            record_header_t header{};
+            if (!end) {
+                std::memcpy(&header, data + offset, sizeof(header));
+                end = header.magic != record_magic || offset + sizeof(header) + header.size > size;
+            }
+
+            if (!end) {
+                auto payload = data + offset + sizeof(header);
+                request_t req;
+                if (crc32(payload, header.size) != header.crc
+                    || !decode_payload({reinterpret_cast<const char*>(payload), header.size}, req)) {
+                    std::lock_guard<std::mutex> lck(_mutex);
+                    _corrupted++;
+                } else {
+                    batch.push_back(std::move(req));
+                }
+                offset += sizeof(header) + header.size;
+            }
+
+            if (!batch.empty() && (end || batch.size() >= batch_size)) {
+                try {
+                    sink(batch);
+                } catch (std::exception& e) {
+                    logging::error({"Spool replay stopped: ", e.what()});
+                    complete = false;
+                    break;
+                }
+                replayed += batch.size();
+                batch.clear();
+            }
+
+            // Progress is kept in the segment, so a failed replay resumes here
+            if (batch.empty()) {
+                {
+                    std::lock_guard<std::mutex> lck(_mutex);
+                    _pending_bytes -= std::min(_pending_bytes, offset - batch_end);
+                }
+                batch_end = offset;
+                segment.replayed_offset = offset;
+                std::memcpy(data, &segment, sizeof(segment));
+            }
+
+            if (end) {
+                break;
+            }
+        }
+
+        munmap(data, size);
+        if (complete) {
+            fs::remove(path);
+        }
+        return complete;
+    }
+
+    bool HistorySpool::replay(const sink_t& sink, size_t batch_size, size_t& replayed) {
+        std::vector<size_t> segments;
+        {
+            std::lock_guard<std::mutex> lck(_mutex);
+            _seal_segment();
+            segments = _list_segments();
+        }
+
+        size_t count = 0;
+        bool complete = true;
+        for (auto index : segments) {
+            if (!_replay_segment(index, sink, std::max(batch_size, (size_t) 1), count)) {
+                complete = false;
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> lck(_mutex);
+        _replayed += count;
+        replayed = count;
+        return complete;
+    }
+
+    bool HistorySpool::empty() {
+        std::lock_guard<std::mutex> lck(_mutex);
+        return _current.data == nullptr && _list_segments().empty();
+    }
+
+    spool_stats_t HistorySpool::get_stats() {
+        std::lock_guard<std::mutex> lck(_mutex);
+        return {
+            .appended = _appended,
+            .replayed = _replayed,
+            .corrupted = _corrupted,
+            .segments = _list_segments().size(),
+            .pending_bytes = _pending_bytes,
+        };
+    }
+}
@@ -1,67 +1,213 @@
 #include "pq_pool.hpp"
+#include "logger_lib.hpp"
 
+#include <bit>
 #include <utility>
-#include <iostream>
+#include <algorithm>
 #include <exception>
 
-static const size_t pool_size = 20;
+static const std::chrono::milliseconds min_retry_delay(500);
+static const std::chrono::milliseconds max_retry_delay(30000);
 
 namespace repository {
 
-    void PQPool::_create_pool() {
-        std::lock_guard<std::mutex> lck(_mutex);
+    PQPool::Lease::Lease(PQPool& pool, std::shared_ptr<pqxx::connection> conn)
+        : _pool(&pool)
+        , _conn(std::move(conn)) {}
+
+    PQPool::Lease::Lease(Lease&& lease) noexcept
+        : _pool(lease._pool)
+        , _conn(std::move(lease._conn)) {}
+
+    PQPool::Lease& PQPool::Lease::operator=(Lease&& lease) noexcept {
+        if (this != &lease) {
+            _release();
+            _pool = lease._pool;
+            _conn = std::move(lease._conn);
+        }
+        return *this;
+    }
+
+    PQPool::Lease::~Lease() {
+        _release();
+    }
+
+    pqxx::connection& PQPool::Lease::operator*() const {
+        return *_conn;
+    }
+
+    pqxx::connection* PQPool::Lease::operator->() const {
+        return _conn.get();
+    }
+
+    void PQPool::Lease::_release() {
+        if (_conn) {
+            _pool->_free_conn(_conn);
+            _conn.reset();
+        }
+    }
+
+    bool PQPool::_open_conn(std::unique_lock<std::mutex>& lck) {
+        // The slot is reserved first so other threads do not open past max_size
+        _size++;
+        lck.unlock();
+
+        std::shared_ptr<pqxx::connection> conn;
         try {
-            for (size_t i = 0; i < pool_size; ++i) {
-                _pool.emplace_back(std::make_shared<pqxx::connection>(_connection_string));
+            conn = std::make_shared<pqxx::connection>(_connection_string);
+            if (_init) {
+                _init(*conn);
             }
         } catch (std::exception& e) {
-            std::cerr << e.what() << "\n";
+            logging::error({"Can't open a database connection: ", e.what()});
+            conn = nullptr;
         }
+
+        lck.lock();
+        if (!conn) {
+            _size--;
+            // Back off so a dead database is not hammered on every request
+            _next_attempt = std::chrono::steady_clock::now() + _retry_delay;
+            _retry_delay = std::min(_retry_delay * 2, max_retry_delay);
+            _condition.notify_all();
+            return false;
+        }
+
+        _retry_delay = min_retry_delay;
+        _created++;
+        _uses[conn.get()] = 0;
+        _pool.push_back(std::move(conn));
+        _condition.notify_one();
+        return true;
     }
 
-    PQPool::PQPool(std::string connection_string)
+    PQPool::PQPool(std::string connection_string, conn_init_t init, pool_config_t config)
         : _is_moved(false)
         , _connection_string(std::move(connection_string))
-        , _condition() {
-        _create_pool();
+        , _init(std::move(init))
+        , _config(config)
+        , _condition()
+        , _size(0)
+        , _next_attempt()
+        , _retry_delay(min_retry_delay)
+        , _created(0)
+        , _replaced(0)
+        , _acquired(0)
+        , _timeouts(0)
+        , _wait_histogram() {
+        _config.max_size = std::max(_config.max_size, std::max(_config.min_size, (size_t) 1));
+
+        std::unique_lock<std::mutex> lck(_mutex);
+        while (_size < _config.min_size && _open_conn(lck)) {}
     }
 
-    std::shared_ptr<pqxx::connection> PQPool::conn() {
+    PQPool::Lease PQPool::lease() {
+        return {*this, _acquire()};
+    }
+
+    std::shared_ptr<pqxx::connection> PQPool::_acquire() {
         if (_is_moved) {
-            return nullptr;
+            throw std::logic_error("Connection requested from a moved pool");
         }
 
+        auto start = std::chrono::steady_clock::now();
+        auto deadline = start + _config.acquire_timeout;
+
         std::unique_lock<std::mutex> lck(_mutex);
-        _condition.wait(lck, [this] {
-            return !_pool.empty();
-        });
+        while (_pool.empty()) {
+            if (_size < _config.max_size && std::chrono::steady_clock::now() >= _next_attempt) {
+                _open_conn(lck);
+                continue;
+            }
+
+            // Waiting only makes sense while somebody holds a connection to give back
+            if (_size == 0) {
+                throw pqxx::broken_connection("no connection to the database");
+            }
 
-        auto conn_ = _pool.back();
+            if (_condition.wait_until(lck, deadline) == std::cv_status::timeout && _pool.empty()) {
+                _timeouts++;
+                throw pool_timeout("No free database connection in " +
+                                   std::to_string(_config.acquire_timeout.count()) + " ms (" +
+                                   std::to_string(_size) + " connections busy)");
+            }
+        }
+
+        auto conn = std::move(_pool.back());
         _pool.pop_back();
 
-        return conn_;
+        _uses[conn.get()]++;
+        _acquired++;
+        _record_wait(std::chrono::steady_clock::now() - start);
+        return conn;
     }
 
-    void PQPool::free_conn(const std::shared_ptr<pqxx::connection>& conn) {
+    void PQPool::_free_conn(const std::shared_ptr<pqxx::connection>& conn) {
         if (_is_moved) {
             return;
         }
 
-        {
-            std::lock_guard<std::mutex> lck(_mutex);
+        std::unique_lock<std::mutex> lck(_mutex);
+        if (conn->is_open()) {
             _pool.push_back(conn);
+            lck.unlock();
+            _condition.notify_one();
+            return;
+        }
+
+        _uses.erase(conn.get());
+        _size--;
+        _replaced++;
+        if (_size < _config.min_size && std::chrono::steady_clock::now() >= _next_attempt) {
+            _open_conn(lck);
+        } else {
+            _condition.notify_all();
         }
-        _condition.notify_one();
+    }
+
+    void PQPool::_record_wait(std::chrono::steady_clock::duration wait) {
+        auto us = (uint64_t) std::chrono::duration_cast<std::chrono::microseconds>(wait).count();
+        _wait_histogram[std::min((size_t) std::bit_width(us), pool_wait_buckets - 1)]++;
+    }
+
+    pool_stats_t PQPool::get_stats() const {
+        std::lock_guard<std::mutex> lck(_mutex);
+
+        pool_stats_t stats{
+            .size = _uses.size(),
+            .idle = _pool.size(),
+            .created = _created,
+            .replaced = _replaced,
+            .acquired = _acquired,
+            .timeouts = _timeouts,
+            .uses = {},
+            .wait_histogram = _wait_histogram,
+        };
+        for (auto& [conn, uses] : _uses) {
+            stats.uses.push_back(uses);
+        }
+        return stats;
     }
 
     PQPool::PQPool(PQPool &&pool) noexcept
         : _is_moved(false)
         , _mutex()
         , _connection_string(std::move(pool._connection_string))
-        , _condition() {
+        , _init(std::move(pool._init))
+        , _config(pool._config)
+        , _condition()
+        , _size(pool._size)
+        , _next_attempt(pool._next_attempt)
+        , _retry_delay(pool._retry_delay)
+        , _created(pool._created)
+        , _replaced(pool._replaced)
+        , _acquired(pool._acquired)
+        , _timeouts(pool._timeouts)
+        , _wait_histogram(pool._wait_histogram) {
         pool._is_moved = true;
-        std::lock_guard<std::mutex> lck(_mutex);
+        std::lock_guard<std::mutex> lck(pool._mutex);
         _pool = std::move(pool._pool);
+        _uses = std::move(pool._uses);
     }
 
 }
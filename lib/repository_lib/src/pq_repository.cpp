@@ -4,21 +4,77 @@
 
 #include "pq_repository.hpp"
 
+#include <algorithm>
+#include <stdexcept>
+
+// Queries kept in flight by add_pipelined before results are read back
+static const size_t pipeline_depth = 64;
+
 namespace repository {
 
-    PQStoreRequest::PQStoreRequest(const std::string &connection_string)
-        : _rep(connection_string) {}
+    // Statements are prepared once for every connection the pool opens
+    static void prepare_statements(pqxx::connection &conn) {
+        conn.prepare("history_add",
+                     "INSERT INTO history (request_bin, is_https, host, port) VALUES($1, $2, $3, $4) RETURNING id");
+        conn.prepare("history_get_by_id",
+                     "SELECT request_bin, request, host, is_https, port FROM history WHERE id = $1");
+        conn.prepare("history_get_by_host",
+                     "SELECT id, request_bin, request, is_https, port FROM history WHERE host = $1 LIMIT 1");
+        conn.prepare("history_reserve_ids",
+                     "SELECT nextval('history_id_seq') FROM generate_series(1, $1) ORDER BY 1");
+        conn.prepare("history_get_list",
+                     "SELECT id, request_bin, request, is_https, host, port FROM history "
+                     "WHERE id > $1 ORDER BY id LIMIT $2");
+        conn.prepare("history_get_by_ids",
+                     "SELECT id, request_bin, request, is_https, host, port FROM history "
+                     "WHERE id = ANY($1::bigint[]) ORDER BY id");
+        conn.prepare("history_get_range",
+                     "SELECT id, request_bin, request, is_https, host, port FROM history "
+                     "WHERE id BETWEEN $1 AND $2 ORDER BY id LIMIT $3");
+    }
+
+    static std::basic_string<std::byte> to_bytea(const std::string &data) {
+        return {reinterpret_cast<const std::byte *>(data.data()), data.size()};
+    }
+
+    // Rows written before the binary format keep their request in the json column
+    static void read_request(const pqxx::row &row, http::Request &request) {
+        if (!row["request_bin"].is_null()) {
+            auto data = row["request_bin"].as<std::basic_string<std::byte>>();
+            if (!request.decode(std::string_view(reinterpret_cast<const char *>(data.data()), data.size()))) {
+                throw std::runtime_error("Broken binary request in history");
+            }
+            return;
+        }
+        request.read_json_from_string(row["request"].as<std::string>());
+    }
+
+    PQStoreRequest::PQStoreRequest(const std::string &connection_string, pool_config_t pool_config,
+                                   size_t recent_capacity)
+        : _rep(connection_string, prepare_statements, pool_config)
+        , _recent(recent_capacity) {}
+
+    pool_stats_t PQStoreRequest::get_pool_stats() const {
+        return _rep.get_stats();
+    }
+
+    recent_stats_t PQStoreRequest::get_recent_stats() const {
+        return _recent.get_stats();
+    }
 
 
     request_t PQStoreRequest::get_by_id(size_t id) {
-        auto conn = _rep.conn();
+        if (auto cached = _recent.find(id)) {
+            return *cached;
+        }
+
+        auto conn = _rep.lease();
 
         pqxx::work w(*conn);
 
-        auto res = w.exec_params1("SELECT request, host, is_https, port FROM history WHERE id = $1", id);
-        if (res.empty()) {
+        auto rows = w.exec_prepared("history_get_by_id", id);
+        if (rows.empty()) {
             w.commit();
-            _rep.free_conn(conn);
             return {.is_valid = false,
                     .is_https = false,
                     .id = 0,
@@ -26,28 +82,27 @@ namespace repository {
                     .host = "",
                     .request = http::Request()};
         }
-        auto rs = res["request"].as<std::string>();
         request_t answ;
         answ.is_valid = true;
+        answ.id = id;
+        auto res = rows[0];
         answ.host = res["host"].as<std::string>();
         answ.port = res["port"].as<size_t>();
         answ.is_https = res["is_https"].as<bool>();
         w.commit();
 
-        _rep.free_conn(conn);
-        answ.request.read_json_from_string(rs);
+        read_request(res, answ.request);
         return answ;
     }
 
     request_t PQStoreRequest::get_by_host(const std::string &host) {
-        auto conn = _rep.conn();
+        auto conn = _rep.lease();
 
         pqxx::work w(*conn);
 
-        auto res = w.exec_params1("SELECT id, request, is_https, port FROM history WHERE host = $1 LIMIT 1", host);
-        if (res.empty()) {
+        auto rows = w.exec_prepared("history_get_by_host", host);
+        if (rows.empty()) {
             w.commit();
-            _rep.free_conn(conn);
             return {.is_valid = false,
                     .is_https = false,
                     .id = 0,
@@ -55,65 +110,268 @@ namespace repository {
                     .host = "",
                     .request = http::Request()};
         }
-        auto rs = res["request"].as<std::string>();
         request_t answ;
         answ.is_valid = true;
+        auto res = rows[0];
         answ.id = res["id"].as<size_t>();
         answ.is_https = res["is_https"].as<bool>();
         answ.port = res["port"].as<size_t>();
 
         w.commit();
-        _rep.free_conn(conn);
 
         answ.host = host;
-        answ.request.read_json_from_string(rs);
+        read_request(res, answ.request);
         return answ;
     }
 
-    std::vector<request_t> PQStoreRequest::get_list(size_t limit) {
-        auto conn = _rep.conn();
+    static request_t read_row(const pqxx::row &row) {
+        request_t answ;
+
+        read_request(row, answ.request);
+        answ.id = row["id"].as<size_t>();
+        answ.is_https = row["is_https"].as<bool>();
+        answ.host = row["host"].as<std::string>();
+        answ.port = row["port"].as<size_t>();
+        answ.is_valid = true;
+        return answ;
+    }
+
+    std::vector<request_t> PQStoreRequest::get_list(size_t after_id, size_t limit) {
+        std::vector<request_t> selected;
+        auto cached = _recent.scan(after_id, limit, [&selected](const request_t& req) {
+            selected.push_back(req);
+            return true;
+        });
+        if (cached.complete) {
+            return selected;
+        }
+
+        for (auto& req : _get_list_db(cached.last_id, limit - cached.sent)) {
+            selected.push_back(std::move(req));
+        }
+        return selected;
+    }
+
+    std::vector<request_t> PQStoreRequest::get_by_ids(const std::vector<size_t>& ids) {
+        std::vector<request_t> selected;
+        std::string missing;
+        for (auto id : ids) {
+            if (auto cached = _recent.find(id)) {
+                selected.push_back(*cached);
+            } else {
+                missing += (missing.empty() ? "{" : ",") + std::to_string(id);
+            }
+        }
+
+        if (!missing.empty()) {
+            auto conn = _rep.lease();
+
+            pqxx::work w(*conn);
+            auto res = w.exec_prepared("history_get_by_ids", missing + "}");
+            w.commit();
+
+            for (auto rs : res) {
+                selected.push_back(read_row(rs));
+            }
+        }
+
+        std::sort(selected.begin(), selected.end(), [](const request_t& a, const request_t& b) {
+            return a.id < b.id;
+        });
+        return selected;
+    }
+
+    std::vector<request_t> PQStoreRequest::get_range(size_t from, size_t to, size_t limit) {
+        auto conn = _rep.lease();
 
         pqxx::work w(*conn);
+        auto res = w.exec_prepared("history_get_range", from, to, limit);
+        w.commit();
 
-        auto res = w.exec_params("SELECT id, request, is_https, host, port FROM history LIMIT $1", limit);
+        std::vector<request_t> selected;
+        for (auto rs : res) {
+            selected.push_back(read_row(rs));
+        }
+        return selected;
+    }
+
+    std::vector<request_t> PQStoreRequest::_get_list_db(size_t after_id, size_t limit) {
+        auto conn = _rep.lease();
+
+        pqxx::work w(*conn);
+
+        auto res = w.exec_prepared("history_get_list", after_id, limit);
         if (res.empty()) {
             w.commit();
-            _rep.free_conn(conn);
             return {};
         }
         w.commit();
-        _rep.free_conn(conn);
 
         std::vector<request_t> selected;
         for (auto rs : res) {
-            request_t answ;
+            selected.push_back(read_row(rs));
+        }
 
-            auto tmp = rs["request"].as<std::string>();
-            answ.request.read_json_from_string(tmp);
-            answ.id = rs["id"].as<size_t>();
-            answ.is_https = rs["is_https"].as<bool>();
-            answ.host = rs["host"].as<std::string>();
-            answ.port = rs["port"].as<size_t>();
-            answ.is_valid = true;
+        return selected;
+    }
 
-            selected.push_back(answ);
+    size_t PQStoreRequest::stream_list(size_t after_id, size_t limit, size_t chunk_size,
+                                       const std::function<bool(const request_t&)>& callback) {
+        auto cached = _recent.scan(after_id, limit, callback);
+        if (cached.complete) {
+            return cached.sent;
         }
+        return cached.sent + _stream_list_db(cached.last_id, limit - cached.sent, chunk_size, callback);
+    }
 
-        return selected;
+    size_t PQStoreRequest::_stream_list_db(size_t after_id, size_t limit, size_t chunk_size,
+                                           const std::function<bool(const request_t&)>& callback) {
+        auto conn = _rep.lease();
+
+        // The cursor lives in this transaction, only one chunk of rows is held
+        // in memory whatever the limit is
+        pqxx::work w(*conn);
+        pqxx::stateless_cursor<pqxx::cursor_base::read_only, pqxx::cursor_base::owned> cursor(
+                w,
+                "SELECT id, request_bin, request, is_https, host, port FROM history "
+                "WHERE id > " + w.quote(after_id) + " ORDER BY id LIMIT " + w.quote(limit),
+                "history_list",
+                false);
+
+        size_t sent = 0;
+        chunk_size = std::max(chunk_size, (size_t) 1);
+        for (size_t pos = 0; sent < limit; pos += chunk_size) {
+            auto res = cursor.retrieve((long) pos, (long) (pos + chunk_size));
+            if (res.empty()) {
+                break;
+            }
+            for (auto rs : res) {
+                sent++;
+                if (!callback(read_row(rs))) {
+                    w.commit();
+                    return sent;
+                }
+            }
+            if (res.size() < chunk_size) {
+                break;
+            }
+        }
+        w.commit();
+        return sent;
     }
 
     size_t PQStoreRequest::add(const request_t &req) {
-        auto conn = _rep.conn();
+        auto conn = _rep.lease();
 
         pqxx::work w(*conn);
-        auto tmp = req.request.get_json().dump();
-        auto res = w.exec_params1("INSERT INTO history (request, is_https, host, port) VALUES($1, $2, $3, $4) RETURNING id",
-                                  tmp, req.is_https, req.host, req.port);
+        auto tmp = to_bytea(req.request.encode());
+        auto res = w.exec_prepared1("history_add", tmp, req.is_https, req.host, req.port);
         auto rs = res[0].as<size_t>();
 
         w.commit();
-        _rep.free_conn(conn);
+        _recent.publish({req}, {rs});
         return rs;
     }
+
+    void PQStoreRequest::add_batch(const std::vector<request_t> &batch) {
+        if (batch.empty()) {
+            return;
+        }
+
+        auto conn = _rep.lease();
+
+        // One transaction, rows sent with COPY ... FROM STDIN. Ids are taken from
+        // the sequence first so the rows can be published to _recent
+        pqxx::work w(*conn);
+        std::vector<size_t> ids;
+        ids.reserve(batch.size());
+        for (auto rs : w.exec_prepared("history_reserve_ids", batch.size())) {
+            ids.push_back(rs[0].as<size_t>());
+        }
+
+        auto stream = pqxx::stream_to::table(w, {"history"}, {"id", "request_bin", "is_https", "host", "port"});
+        for (size_t i = 0; i < batch.size(); ++i) {
+            auto &req = batch[i];
+            stream.write_values(ids[i], to_bytea(req.request.encode()), req.is_https, req.host, req.port);
+        }
+        stream.complete();
+        w.commit();
+
+        _recent.publish(batch, ids);
+    }
+
+    std::vector<size_t> PQStoreRequest::add_pipelined(const std::vector<request_t> &batch) {
+        if (batch.empty()) {
+            return {};
+        }
+
+        auto conn = _rep.lease();
+
+        // pqxx::pipeline keeps several statements in flight instead of waiting
+        // a round-trip for each; it takes SQL text, so the prepared insert is
+        // called through EXECUTE with quoted arguments
+        pqxx::work w(*conn);
+        pqxx::pipeline pipe(w);
+        pipe.retain(static_cast<int>(std::min(batch.size(), pipeline_depth)));
+
+        std::vector<pqxx::pipeline::query_id> queries;
+        queries.reserve(batch.size());
+        for (auto &req : batch) {
+            auto data = to_bytea(req.request.encode());
+            queries.push_back(pipe.insert(
+                    "EXECUTE history_add(" + w.quote_raw(std::basic_string_view<std::byte>(data)) + ", " +
+                    w.quote(req.is_https) + ", " + w.quote(req.host) + ", " + w.quote(req.port) + ")"));
+        }
+
+        std::vector<size_t> ids;
+        ids.reserve(batch.size());
+        for (auto query : queries) {
+            ids.push_back(pipe.retrieve(query)[0][0].as<size_t>());
+        }
+        pipe.complete();
+        w.commit();
+
+        _recent.publish(batch, ids);
+        return ids;
+    }
+
+    size_t PQStoreRequest::migrate_json_rows(size_t batch_size) {
+        auto conn = _rep.lease();
+
+        pqxx::work w(*conn);
+        auto res = w.exec_params("SELECT id, request FROM history WHERE request_bin IS NULL ORDER BY id LIMIT $1",
+                                 batch_size);
+        for (auto rs : res) {
+            http::Request request;
+            request.read_json_from_string(rs["request"].as<std::string>());
+            w.exec_params0("UPDATE history SET request_bin = $1, request = NULL WHERE id = $2",
+                           to_bytea(request.encode()), rs["id"].as<size_t>());
+        }
+        w.commit();
+        return res.size();
+    }
+
+    void PQStoreRequest::ensure_partitions(size_t months_ahead) {
+        auto conn = _rep.lease();
+
+        pqxx::work w(*conn);
+        w.exec_params("SELECT history_ensure_partitions($1)", (int) months_ahead);
+        w.commit();
+    }
+
+    std::vector<std::string> PQStoreRequest::drop_partitions(std::chrono::hours keep) {
+        auto conn = _rep.lease();
+
+        pqxx::work w(*conn);
+        auto res = w.exec_params("SELECT history_drop_partitions($1::interval)",
+                                 std::to_string(keep.count()) + " hours");
+        w.commit();
+
+        std::vector<std::string> dropped;
+        for (auto rs : res) {
+            dropped.push_back(rs[0].as<std::string>());
+        }
+        return dropped;
+    }
 }
 
@@ -0,0 +1,209 @@
+#include "recent_history.hpp"
+#include "pq_repository.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <thread>
+
+namespace repository {
+
+    struct RecentHistory::entry_t {
+        request_t           request;
+        std::atomic<size_t> refs;   // one of the slot and one per pointer handed out
+    };
+
+    static std::atomic<size_t> next_thread(0);
+
+    RecentHistory::RecentHistory(size_t capacity)
+        : _mask(capacity ? std::bit_ceil(capacity) - 1 : 0)
+        , _slots(capacity ? std::make_unique<slot_t[]>(_mask + 1) : nullptr)
+        , _hazards()
+        , _floor(0)
+        , _published(0)
+        , _id_hits(0)
+        , _id_misses(0)
+        , _list_hits(0)
+        , _list_misses(0) {}
+
+    RecentHistory::~RecentHistory() {
+        for (size_t i = 0; _slots && i <= _mask; ++i) {
+            if (auto entry = _slots[i].load(std::memory_order_acquire)) {
+                _release(entry);
+            }
+        }
+    }
+
+    RecentHistory::hazard_t& RecentHistory::_claim_hazard(entry_t* entry) {
+        // Threads start from different hazards so they rarely compete for one
+        static thread_local size_t start = next_thread.fetch_add(1, std::memory_order_relaxed);
+        for (size_t i = start;; ++i) {
+            auto& hazard = _hazards[i % hazard_count];
+            entry_t* expected = nullptr;
+            if (hazard.load(std::memory_order_relaxed) == nullptr && hazard.compare_exchange_strong(expected, entry)) {
+                return hazard;
+            }
+        }
+    }
+
+    RecentHistory::entry_t* RecentHistory::_protect(const slot_t& slot, hazard_t*& hazard) {
+        hazard = nullptr;
+        while (true) {
+            auto entry = slot.load();
+            if (entry == nullptr) {
+                return nullptr;
+            }
+            // The slot still holding the entry after the hazard is set means
+            // that a writer replacing it later will see the hazard
+            hazard = &_claim_hazard(entry);
+            if (slot.load() == entry) {
+                return entry;
+            }
+            hazard->store(nullptr, std::memory_order_release);
+        }
+    }
+
+    void RecentHistory::_retire(entry_t* entry) {
+        // Readers hold a hazard only while taking a reference, a few instructions
+        for (auto& hazard : _hazards) {
+            while (hazard.load() == entry) {
+                std::this_thread::yield();
+            }
+        }
+        _release(entry);
+    }
+
+    void RecentHistory::_release(entry_t* entry) {
+        if (entry->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete entry;
+        }
+    }
+
+    void RecentHistory::publish(const std::vector<request_t>& batch, const std::vector<size_t>& ids) {
+        if (!_slots || ids.empty()) {
+            return;
+        }
+
+        for (size_t i = 0; i < batch.size() && i < ids.size(); ++i) {
+            auto entry = new entry_t{batch[i], {1}};
+            entry->request.id = ids[i];
+            entry->request.is_valid = true;
+
+            auto& slot = _slots[ids[i] & _mask];
+            while (true) {
+                hazard_t* hazard;
+                auto current = _protect(slot, hazard);
+                // A concurrent writer may already have put a newer id there
+                bool newer = current != nullptr && current->request.id >= ids[i];
+                bool swapped = !newer && slot.compare_exchange_strong(current, entry);
+                if (hazard != nullptr) {
+                    hazard->store(nullptr, std::memory_order_release);
+                }
+
+                if (newer) {
+                    delete entry;
+                    break;
+                }
+                if (swapped) {
+                    if (current != nullptr) {
+                        _retire(current);
+                    }
+                    break;
+                }
+            }
+        }
+
+        auto floor = _floor.load(std::memory_order_relaxed);
+        while ((floor == 0 || floor > ids.front())
+               && !_floor.compare_exchange_weak(floor, ids.front(), std::memory_order_relaxed)) {}
+        auto published = _published.load(std::memory_order_relaxed);
+        while (published < ids.back()
+               && !_published.compare_exchange_weak(published, ids.back(), std::memory_order_release)) {}
+    }
+
+    std::shared_ptr<const request_t> RecentHistory::find(size_t id) {
+        if (_slots) {
+            hazard_t* hazard;
+            auto entry = _protect(_slots[id & _mask], hazard);
+            bool hit = entry != nullptr && entry->request.id == id;
+            if (hit) {
+                entry->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (hazard != nullptr) {
+                hazard->store(nullptr, std::memory_order_release);
+            }
+
+            if (hit) {
+                _id_hits.fetch_add(1, std::memory_order_relaxed);
+                return {&entry->request, [entry](const request_t*) { _release(entry); }};
+            }
+        }
+        _id_misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    recent_scan_t RecentHistory::scan(size_t after_id, size_t limit,
+                                      const std::function<bool(const request_t&)>& callback) {
+        auto published = _published.load(std::memory_order_acquire);
+        auto floor = _floor.load(std::memory_order_relaxed);
+
+        // Ids below the oldest slot or written before this process started
+        // are only known to the database
+        auto oldest = std::max(floor, published > _mask ? published - _mask : (size_t) 1);
+        if (!_slots || floor == 0 || after_id + 1 < oldest) {
+            _list_misses.fetch_add(1, std::memory_order_relaxed);
+            return {0, after_id, false};
+        }
+
+        recent_scan_t res{0, after_id, true};
+        for (size_t id = after_id + 1; id <= published && res.sent < limit; ++id) {
+            hazard_t* hazard;
+            auto entry = _protect(_slots[id & _mask], hazard);
+            auto entry_id = entry != nullptr ? entry->request.id : 0;
+            if (entry_id == id) {
+                // Referenced, not guarded, while the callback runs
+                entry->refs.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (hazard != nullptr) {
+                hazard->store(nullptr, std::memory_order_release);
+            }
+
+            if (entry_id < id) {
+                // Reserved by a batch that failed or is not committed yet, there is no such row
+                continue;
+            }
+            if (entry_id > id) {
+                // Evicted while scanning
+                res.complete = false;
+                break;
+            }
+
+            res.sent++;
+            res.last_id = id;
+            bool more;
+            try {
+                more = callback(entry->request);
+            } catch (...) {
+                _release(entry);
+                throw;
+            }
+            _release(entry);
+            if (!more) {
+                break;
+            }
+        }
+
+        (res.complete ? _list_hits : _list_misses).fetch_add(1, std::memory_order_relaxed);
+        return res;
+    }
+
+    recent_stats_t RecentHistory::get_stats() const {
+        return {
+            .capacity = _slots ? _mask + 1 : 0,
+            .published = _published.load(std::memory_order_relaxed),
+            .id_hits = _id_hits.load(std::memory_order_relaxed),
+            .id_misses = _id_misses.load(std::memory_order_relaxed),
+            .list_hits = _list_hits.load(std::memory_order_relaxed),
+            .list_misses = _list_misses.load(std::memory_order_relaxed),
+        };
+    }
+}
@@ -0,0 +1,95 @@
+#include "include/bounded_queue.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using repository::BoundedQueue;
+
+TEST(BoundedQueue, RoundsCapacityToPowerOfTwo) {
+    EXPECT_EQ(BoundedQueue<int>(0).capacity(), 2u);
+    EXPECT_EQ(BoundedQueue<int>(5).capacity(), 8u);
+    EXPECT_EQ(BoundedQueue<int>(64).capacity(), 64u);
+}
+
+TEST(BoundedQueue, KeepsOrderAndRejectsWhenFull) {
+    BoundedQueue<int> queue(4);
+    for (int i = 0; i < 4; ++i) {
+        int value = i;
+        EXPECT_TRUE(queue.try_push(std::move(value)));
+    }
+    int extra = 4;
+    EXPECT_FALSE(queue.try_push(std::move(extra)));
+    EXPECT_EQ(queue.size(), 4u);
+
+    int value = -1;
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(value, i);
+    }
+    EXPECT_FALSE(queue.try_pop(value));
+    EXPECT_EQ(queue.size(), 0u);
+}
+
+TEST(BoundedQueue, FailedPushLeavesValue) {
+    BoundedQueue<std::unique_ptr<int>> queue(2);
+    queue.try_push(std::make_unique<int>(1));
+    queue.try_push(std::make_unique<int>(2));
+
+    auto value = std::make_unique<int>(3);
+    EXPECT_FALSE(queue.try_push(std::move(value)));
+    ASSERT_NE(value, nullptr);
+    EXPECT_EQ(*value, 3);
+}
+
+TEST(BoundedQueue, WrapsAround) {
+    BoundedQueue<std::string> queue(2);
+    std::string value;
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_TRUE(queue.try_push(std::to_string(i)));
+        ASSERT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(value, std::to_string(i));
+    }
+}
+
+TEST(BoundedQueue, ManyProducersAndConsumers) {
+    const size_t producers = 4, consumers = 4, per_producer = 20000;
+    BoundedQueue<size_t> queue(128);
+    std::atomic<size_t> popped = 0, sum = 0;
+
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (size_t i = 0; i < per_producer; ++i) {
+                size_t value = p * per_producer + i + 1;
+                while (!queue.try_push(std::move(value))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (size_t c = 0; c < consumers; ++c) {
+        threads.emplace_back([&] {
+            size_t value;
+            while (popped < producers * per_producer) {
+                if (queue.try_pop(value)) {
+                    sum += value;
+                    popped++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+
+    size_t total = producers * per_producer;
+    EXPECT_EQ(popped, total);
+    EXPECT_EQ(sum, total * (total + 1) / 2);
+}
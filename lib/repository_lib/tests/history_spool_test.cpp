@@ -0,0 +1,215 @@
+#include "include/history_spool.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace fs = std::filesystem;
+using namespace repository;
+
+// Layout of a segment file, see HistorySpool
+static const size_t segment_header_size = 16;
+static const size_t record_header_size = 12;
+
+static request_t make_request(size_t n) {
+    request_t req{true, n % 2 == 1, 0, 8000 + n, "host" + std::to_string(n) + ".test", http::Request()};
+    req.request.parse("GET /item?n=" + std::to_string(n) + " HTTP/1.1\r\nHost: " + req.host + "\r\n\r\n");
+    return req;
+}
+
+class HistorySpoolTest : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        auto name = ::testing::UnitTest::GetInstance()->current_test_info()->name();
+        _config.directory = (fs::temp_directory_path() / ("history_spool_test_" + std::string(name))).string();
+        fs::remove_all(_config.directory);
+    }
+
+    void TearDown() override {
+        fs::remove_all(_config.directory);
+    }
+
+    // Replays everything and returns the requests in the order they came
+    static std::vector<request_t> replay_all(HistorySpool &spool, size_t batch_size = 3) {
+        std::vector<request_t> res;
+        size_t replayed = 0;
+        EXPECT_TRUE(spool.replay([&res](const std::vector<request_t> &batch) {
+            res.insert(res.end(), batch.begin(), batch.end());
+        }, batch_size, replayed));
+        EXPECT_EQ(replayed, res.size());
+        return res;
+    }
+
+    [[nodiscard]] std::string first_segment() const {
+        return (fs::path(_config.directory) / "segment-00000001.spool").string();
+    }
+
+    spool_config_t _config;
+};
+
+static void expect_request(const request_t &req, size_t n) {
+    auto expected = make_request(n);
+    EXPECT_EQ(req.is_https, expected.is_https);
+    EXPECT_EQ(req.port, expected.port);
+    EXPECT_EQ(req.host, expected.host);
+    EXPECT_EQ(req.request.get_param("n"), std::to_string(n));
+    EXPECT_EQ(req.request.get_header("Host"), expected.host);
+}
+
+TEST_F(HistorySpoolTest, ReplaysInOrderAndEmpties) {
+    HistorySpool spool(_config);
+    EXPECT_TRUE(spool.empty());
+    for (size_t i = 0; i < 10; ++i) {
+        ASSERT_TRUE(spool.append(make_request(i)));
+    }
+    EXPECT_FALSE(spool.empty());
+    EXPECT_GT(spool.get_stats().pending_bytes, 0u);
+
+    auto requests = replay_all(spool);
+    ASSERT_EQ(requests.size(), 10u);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        expect_request(requests[i], i);
+    }
+
+    auto stats = spool.get_stats();
+    EXPECT_EQ(stats.appended, 10u);
+    EXPECT_EQ(stats.replayed, 10u);
+    EXPECT_EQ(stats.corrupted, 0u);
+    EXPECT_EQ(stats.pending_bytes, 0u);
+    EXPECT_TRUE(spool.empty());
+}
+
+TEST_F(HistorySpoolTest, RollsOverSegments) {
+    _config.segment_size = 256;
+    HistorySpool spool(_config);
+    for (size_t i = 0; i < 20; ++i) {
+        ASSERT_TRUE(spool.append(make_request(i)));
+    }
+    EXPECT_GT(spool.get_stats().segments, 1u);
+
+    auto requests = replay_all(spool, 4);
+    ASSERT_EQ(requests.size(), 20u);
+    for (size_t i = 0; i < requests.size(); ++i) {
+        expect_request(requests[i], i);
+    }
+    EXPECT_TRUE(spool.empty());
+}
+
+TEST_F(HistorySpoolTest, SurvivesRestart) {
+    {
+        HistorySpool spool(_config);
+        for (size_t i = 0; i < 5; ++i) {
+            ASSERT_TRUE(spool.append(make_request(i)));
+        }
+    }
+    HistorySpool spool(_config);
+    EXPECT_FALSE(spool.empty());
+    EXPECT_EQ(replay_all(spool).size(), 5u);
+}
+
+TEST_F(HistorySpoolTest, SkipsRecordWithBadChecksum) {
+    {
+        HistorySpool spool(_config);
+        for (size_t i = 0; i < 3; ++i) {
+            ASSERT_TRUE(spool.append(make_request(i)));
+        }
+    }
+    // Flip the last payload byte of the last record, a request byte the decoder doesn't check
+    {
+        std::fstream file(first_segment(), std::ios::in | std::ios::out | std::ios::binary);
+        file.seekg(-1, std::ios::end);
+        char byte = 0;
+        file.read(&byte, 1);
+        file.seekp(-1, std::ios::end);
+        byte ^= 0x20;
+        file.write(&byte, 1);
+    }
+
+    HistorySpool spool(_config);
+    auto requests = replay_all(spool);
+    ASSERT_EQ(requests.size(), 2u);
+    expect_request(requests[0], 0);
+    expect_request(requests[1], 1);
+    EXPECT_EQ(spool.get_stats().corrupted, 1u);
+    EXPECT_TRUE(spool.empty());
+}
+
+TEST_F(HistorySpoolTest, StopsAtTruncatedRecord) {
+    {
+        HistorySpool spool(_config);
+        for (size_t i = 0; i < 3; ++i) {
+            ASSERT_TRUE(spool.append(make_request(i)));
+        }
+    }
+    // A crash in the middle of the last record
+    fs::resize_file(first_segment(), fs::file_size(first_segment()) - 5);
+
+    HistorySpool spool(_config);
+    auto requests = replay_all(spool);
+    ASSERT_EQ(requests.size(), 2u);
+    expect_request(requests[1], 1);
+    EXPECT_TRUE(spool.empty());
+}
+
+TEST_F(HistorySpoolTest, DropsSegmentWithBadHeader) {
+    {
+        HistorySpool spool(_config);
+        ASSERT_TRUE(spool.append(make_request(0)));
+    }
+    {
+        std::fstream file(first_segment(), std::ios::in | std::ios::out | std::ios::binary);
+        file.write("XXXX", 4);
+    }
+
+    HistorySpool spool(_config);
+    EXPECT_TRUE(replay_all(spool).empty());
+    EXPECT_EQ(spool.get_stats().corrupted, 1u);
+    EXPECT_TRUE(spool.empty());
+}
+
+TEST_F(HistorySpoolTest, ResumesAfterSinkFailure) {
+    HistorySpool spool(_config);
+    for (size_t i = 0; i < 10; ++i) {
+        ASSERT_TRUE(spool.append(make_request(i)));
+    }
+
+    std::vector<request_t> stored;
+    size_t calls = 0, replayed = 0;
+    auto failing_sink = [&](const std::vector<request_t> &batch) {
+        if (++calls == 2) {
+            throw std::runtime_error("database is down");
+        }
+        stored.insert(stored.end(), batch.begin(), batch.end());
+    };
+    EXPECT_FALSE(spool.replay(failing_sink, 4, replayed));
+    EXPECT_EQ(replayed, 4u);
+    EXPECT_FALSE(spool.empty());
+
+    // Appended while the database was down, replayed after what was spooled before
+    ASSERT_TRUE(spool.append(make_request(10)));
+
+    auto rest = replay_all(spool, 4);
+    stored.insert(stored.end(), rest.begin(), rest.end());
+    ASSERT_EQ(stored.size(), 11u);
+    for (size_t i = 0; i < stored.size(); ++i) {
+        expect_request(stored[i], i);
+    }
+    EXPECT_EQ(spool.get_stats().pending_bytes, 0u);
+    EXPECT_TRUE(spool.empty());
+}
+
+TEST_F(HistorySpoolTest, RecordLayout) {
+    {
+        HistorySpool spool(_config);
+        ASSERT_TRUE(spool.append(make_request(0)));
+    }
+    // A sealed segment holds the header and the record only
+    auto size = fs::file_size(first_segment());
+    EXPECT_GT(size, segment_header_size + record_header_size);
+    HistorySpool spool(_config);
+    EXPECT_EQ(spool.get_stats().pending_bytes, size);
+}
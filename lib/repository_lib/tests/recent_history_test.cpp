@@ -0,0 +1,170 @@
+#include "include/recent_history.hpp"
+#include "include/pq_repository.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace repository;
+
+static std::vector<request_t> make_batch(size_t first, size_t count) {
+    std::vector<request_t> batch(count);
+    for (size_t i = 0; i < count; ++i) {
+        batch[i].host = "host" + std::to_string(first + i);
+    }
+    return batch;
+}
+
+static std::vector<size_t> make_ids(size_t first, size_t count) {
+    std::vector<size_t> ids;
+    for (size_t i = 0; i < count; ++i) {
+        ids.push_back(first + i);
+    }
+    return ids;
+}
+
+static void publish(RecentHistory &ring, size_t first, size_t count) {
+    ring.publish(make_batch(first, count), make_ids(first, count));
+}
+
+TEST(RecentHistory, FindsPublishedIds) {
+    RecentHistory ring(6);
+    EXPECT_EQ(ring.get_stats().capacity, 8u);
+    publish(ring, 1, 5);
+
+    auto req = ring.find(3);
+    ASSERT_NE(req, nullptr);
+    EXPECT_EQ(req->id, 3u);
+    EXPECT_TRUE(req->is_valid);
+    EXPECT_EQ(req->host, "host3");
+    EXPECT_EQ(ring.find(6), nullptr);
+
+    auto stats = ring.get_stats();
+    EXPECT_EQ(stats.published, 5u);
+    EXPECT_EQ(stats.id_hits, 1u);
+    EXPECT_EQ(stats.id_misses, 1u);
+}
+
+TEST(RecentHistory, EvictsOldestAndKeepsNewestPerSlot) {
+    RecentHistory ring(4);
+    publish(ring, 1, 6);
+    EXPECT_EQ(ring.find(1), nullptr);
+    EXPECT_EQ(ring.find(2), nullptr);
+    EXPECT_NE(ring.find(3), nullptr);
+    EXPECT_NE(ring.find(6), nullptr);
+
+    // An older id published late doesn't take the slot of a newer one
+    publish(ring, 2, 1);
+    EXPECT_EQ(ring.find(2), nullptr);
+    EXPECT_NE(ring.find(6), nullptr);
+}
+
+TEST(RecentHistory, FoundRequestOutlivesEviction) {
+    RecentHistory ring(2);
+    publish(ring, 1, 1);
+    auto req = ring.find(1);
+    ASSERT_NE(req, nullptr);
+
+    publish(ring, 2, 4);
+    EXPECT_EQ(ring.find(1), nullptr);
+    EXPECT_EQ(req->host, "host1");
+}
+
+TEST(RecentHistory, ScansInIdOrder) {
+    RecentHistory ring(16);
+    publish(ring, 1, 10);
+
+    std::vector<size_t> seen;
+    auto res = ring.scan(3, 4, [&seen](const request_t &req) {
+        seen.push_back(req.id);
+        return true;
+    });
+    EXPECT_TRUE(res.complete);
+    EXPECT_EQ(res.sent, 4u);
+    EXPECT_EQ(res.last_id, 7u);
+    EXPECT_EQ(seen, (std::vector<size_t>{4, 5, 6, 7}));
+
+    // The callback may stop the scan
+    res = ring.scan(0, 100, [](const request_t &req) {
+        return req.id < 2;
+    });
+    EXPECT_TRUE(res.complete);
+    EXPECT_EQ(res.last_id, 2u);
+}
+
+TEST(RecentHistory, ScanSkipsGapsAndLeavesOlderIdsToDatabase) {
+    RecentHistory ring(8);
+    publish(ring, 10, 2);
+    publish(ring, 14, 2);
+
+    std::vector<size_t> seen;
+    auto res = ring.scan(9, 100, [&seen](const request_t &req) {
+        seen.push_back(req.id);
+        return true;
+    });
+    EXPECT_TRUE(res.complete);
+    EXPECT_EQ(seen, (std::vector<size_t>{10, 11, 14, 15}));
+
+    // Ids before the first one published are only in the database
+    res = ring.scan(5, 100, [](const request_t &) { return true; });
+    EXPECT_FALSE(res.complete);
+    EXPECT_EQ(res.sent, 0u);
+    EXPECT_EQ(res.last_id, 5u);
+    EXPECT_EQ(ring.get_stats().list_misses, 1u);
+}
+
+TEST(RecentHistory, DisabledRing) {
+    RecentHistory ring(0);
+    publish(ring, 1, 3);
+    EXPECT_EQ(ring.find(1), nullptr);
+    EXPECT_FALSE(ring.scan(0, 10, [](const request_t &) { return true; }).complete);
+    EXPECT_EQ(ring.get_stats().capacity, 0u);
+}
+
+TEST(RecentHistory, ConcurrentWritersAndReaders) {
+    RecentHistory ring(64);
+    std::atomic<size_t> next = 1;
+    std::atomic<bool> stop = false;
+    std::atomic<size_t> mismatches = 0;
+
+    std::vector<std::thread> writers, readers;
+    for (int w = 0; w < 3; ++w) {
+        writers.emplace_back([&] {
+            for (size_t k = 0; k < 2000; ++k) {
+                size_t count = 1 + k % 4;
+                publish(ring, next.fetch_add(count), count);
+            }
+        });
+    }
+    for (int r = 0; r < 3; ++r) {
+        readers.emplace_back([&] {
+            while (!stop) {
+                auto published = ring.get_stats().published;
+                for (size_t id = published > 80 ? published - 80 : 1; id <= published; ++id) {
+                    if (auto req = ring.find(id); req && req->host != "host" + std::to_string(id)) {
+                        mismatches++;
+                    }
+                }
+                ring.scan(published > 30 ? published - 30 : 0, 20, [&](const request_t &req) {
+                    if (req.host != "host" + std::to_string(req.id)) {
+                        mismatches++;
+                    }
+                    return true;
+                });
+            }
+        });
+    }
+    for (auto &thread: writers) {
+        thread.join();
+    }
+    stop = true;
+    for (auto &thread: readers) {
+        thread.join();
+    }
+
+    EXPECT_EQ(mismatches, 0u);
+    EXPECT_EQ(ring.get_stats().published, next - 1);
+}
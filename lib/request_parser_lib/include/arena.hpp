@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace http {
+
+struct arena_stats_t {
+    size_t blocks               = 0;    // blocks currently owned by the arena
+    size_t capacity             = 0;    // bytes reserved by those blocks
+    size_t used                 = 0;    // bytes handed out since the last reset
+    size_t peak                 = 0;    // largest `used` ever observed
+    size_t allocations          = 0;    // allocations since the last reset
+    size_t total_allocations    = 0;    // allocations over the arena lifetime
+    size_t oversized            = 0;    // allocations that needed a dedicated block
+    size_t resets               = 0;
+};
+
+// Bump allocator for request-scoped data. Memory is never freed one object at a
+// time: everything handed out is dropped at once by reset(), which keeps the
+// regular blocks for the next request.
+class Arena {
+  public:
+    static constexpr size_t default_block_size = 16 * 1024;
+
+    explicit Arena(size_t block_size = default_block_size);
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    Arena(Arena &&arena) noexcept;
+    Arena &operator=(Arena &&arena) noexcept;
+
+    ~Arena() = default;
+
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+
+    char *allocate_chars(size_t size);
+
+    std::string_view copy(std::string_view str);
+
+    void reset();
+
+    void release();
+
+    [[nodiscard]] arena_stats_t get_stats() const;
+
+  private:
+    struct block_t {
+        std::unique_ptr<std::byte[]>    data;
+        size_t                          size;
+    };
+
+    void *_allocate_from_next_block(size_t size, size_t align);
+
+    std::vector<block_t>    _blocks;
+    std::vector<block_t>    _oversized;
+    size_t                  _current;
+    size_t                  _offset;
+    size_t                  _block_size;
+    arena_stats_t           _stats;
+};
+
+// Standard allocator adapter so containers can live inside an Arena.
+template<typename T>
+class ArenaAllocator {
+  public:
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena &arena) noexcept
+            : _arena(&arena) {}
+
+    template<typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept // NOLINT(google-explicit-constructor)
+            : _arena(other.get_arena()) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(_arena->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, size_t) noexcept {}
+
+    [[nodiscard]] Arena *get_arena() const noexcept {
+        return _arena;
+    }
+
+    template<typename U>
+    bool operator==(const ArenaAllocator<U> &other) const noexcept {
+        return _arena == other.get_arena();
+    }
+
+  private:
+    Arena *_arena;
+};
+
+template<typename T>
+using arena_vector = std::vector<T, ArenaAllocator<T>>;
+
+template<typename K, typename V>
+using arena_map = std::map<K, V, std::less<>, ArenaAllocator<std::pair<const K, V>>>;
+
+using arena_string = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+
+}
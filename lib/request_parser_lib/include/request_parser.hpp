@@ -1,6 +1,7 @@
 #pragma once
 
 #include "json/json.hpp"
+#include "arena.hpp"
 
 namespace nj = nlohmann;
 
@@ -11,11 +12,20 @@ class Request {
 
     Request();
     explicit Request(const std::string &request);
+    Request(std::string_view request, Arena &arena);
 
     bool parse(const std::string &request);
 
+    // Temporary parse state is allocated in `arena`, which the caller resets
+    // once the request is finished
+    bool parse(std::string_view request, Arena &arena);
+
     void read_json_from_string(const std::string &json);
 
+    // Compact length-prefixed binary form used for storage
+    [[nodiscard]] std::string encode() const;
+    bool decode(std::string_view data);
+
     [[nodiscard]] std::string string() const;
 
     [[nodiscard]] std::string get_header(const std::string& name) const;
@@ -45,7 +55,20 @@ class Request {
 
     [[nodiscard]] static std::string _get_param(const nj::json& json, const std::string& name);
     [[nodiscard]] static bool _set_param(nj::json& json, const std::string& name, const std::string& value);
-    nj::json _request;
+
+    void _parse_headers() const;
+    void _parse_params() const;
+    void _parse_cookies() const;
+    [[nodiscard]] std::string _query_string() const;
+    [[nodiscard]] std::string _cookie_string() const;
+    void _clear();
+
+    // Headers, params and cookies stay raw until first access. Parsed
+    // headers are kept as "name: value\n" lines
+    mutable nj::json _request;
+    mutable std::string _raw_query;
+    mutable std::string _raw_headers;
+    mutable std::string _raw_cookies;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,131 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+static size_t align_up(uintptr_t value, size_t align) {
+    return (value + align - 1) & ~(uintptr_t) (align - 1);
+}
+
+namespace http {
+
+Arena::Arena(size_t block_size)
+        : _blocks()
+          , _oversized()
+          , _current(0)
+          , _offset(0)
+          , _block_size(std::max(block_size, (size_t) 64))
+          , _stats() {}
+
+Arena::Arena(Arena &&arena) noexcept
+        : _blocks(std::move(arena._blocks))
+          , _oversized(std::move(arena._oversized))
+          , _current(arena._current)
+          , _offset(arena._offset)
+          , _block_size(arena._block_size)
+          , _stats(arena._stats) {
+    arena._current = 0;
+    arena._offset = 0;
+    arena._stats = arena_stats_t();
+}
+
+Arena &Arena::operator=(Arena &&arena) noexcept {
+    _blocks     = std::move(arena._blocks);
+    _oversized  = std::move(arena._oversized);
+    _current    = arena._current;
+    _offset     = arena._offset;
+    _block_size = arena._block_size;
+    _stats      = arena._stats;
+
+    arena._current  = 0;
+    arena._offset   = 0;
+    arena._stats    = arena_stats_t();
+    return *this;
+}
+
+void *Arena::allocate(size_t size, size_t align) {
+    _stats.allocations++;
+    _stats.total_allocations++;
+    _stats.used += size;
+    _stats.peak = std::max(_stats.peak, _stats.used);
+
+    // Requests bigger than a block get a dedicated block that is dropped on reset
+    if (size + align > _block_size) {
+        _stats.oversized++;
+        _stats.capacity += size + align;
+        _oversized.push_back({std::make_unique<std::byte[]>(size + align), size + align});
+        _stats.blocks = _blocks.size() + _oversized.size();
+        auto data = _oversized.back().data.get();
+        auto base = reinterpret_cast<uintptr_t>(data);
+        return data + (align_up(base, align) - base);
+    }
+
+    if (_current < _blocks.size()) {
+        auto &block = _blocks[_current];
+        auto base = reinterpret_cast<uintptr_t>(block.data.get());
+        size_t start = align_up(base + _offset, align) - base;
+        if (start + size <= block.size) {
+            _offset = start + size;
+            return block.data.get() + start;
+        }
+        _current++;
+    }
+    return _allocate_from_next_block(size, align);
+}
+
+void *Arena::_allocate_from_next_block(size_t size, size_t align) {
+    // Blocks kept from previous requests are reused before allocating new ones
+    if (_current >= _blocks.size()) {
+        _blocks.push_back({std::make_unique<std::byte[]>(_block_size), _block_size});
+        _current = _blocks.size() - 1;
+        _stats.capacity += _block_size;
+        _stats.blocks = _blocks.size() + _oversized.size();
+    }
+
+    auto &block = _blocks[_current];
+    auto base = reinterpret_cast<uintptr_t>(block.data.get());
+    size_t start = align_up(base, align) - base;
+    _offset = start + size;
+    return block.data.get() + start;
+}
+
+char *Arena::allocate_chars(size_t size) {
+    return static_cast<char *>(allocate(size, alignof(char)));
+}
+
+std::string_view Arena::copy(std::string_view str) {
+    if (str.empty()) {
+        return {};
+    }
+    auto data = allocate_chars(str.size());
+    std::memcpy(data, str.data(), str.size());
+    return {data, str.size()};
+}
+
+void Arena::reset() {
+    for (auto &block: _oversized) {
+        _stats.capacity -= block.size;
+    }
+    _oversized.clear();
+
+    _current = 0;
+    _offset = 0;
+    _stats.blocks = _blocks.size();
+    _stats.used = 0;
+    _stats.allocations = 0;
+    _stats.resets++;
+}
+
+void Arena::release() {
+    reset();
+    _blocks.clear();
+    _stats.blocks = 0;
+    _stats.capacity = 0;
+}
+
+arena_stats_t Arena::get_stats() const {
+    return _stats;
+}
+
+}
@@ -1,5 +1,7 @@
 #include "request_parser.hpp"
 
+#include <algorithm>
+#include <cctype>
 #include <map>
 
 static const char * divider = "\r\n";
@@ -12,213 +14,294 @@ static const char * HEADERS = "headers";
 static const char * COOKIE = "cookies";
 static const char * PARAM = "params";
 
-std::string decode_url(const std::string &url) {
-    std::string decoded_url;
+static void encode_component(std::string &res, std::string_view text) {
+    static const char *hex = "0123456789ABCDEF";
+    for (unsigned char symbol: text) {
+        if (symbol <= ' ' || symbol >= 0x7f || symbol == '%' || symbol == '&'
+            || symbol == '=' || symbol == '+' || symbol == '#' || symbol == '?') {
+            res += '%';
+            res += hex[symbol >> 4];
+            res += hex[symbol & 0x0f];
+        } else {
+            res += (char) symbol;
+        }
+    }
+}
+
+static std::string_view decode_url(std::string_view url, http::Arena &arena) {
+    if (url.find('%') == std::string_view::npos) {
+        return url;
+    }
+
+    auto decoded_url = arena.allocate_chars(url.size());
+    size_t size = 0;
     for (size_t i = 0; i < url.size(); i++) {
         if (url[i] == '%') {
-            decoded_url += static_cast<char>(
-                    strtoll(url.substr(i + 1, 2).c_str(), nullptr, 16)
-            );
+            char code[3] = {0, 0, 0};
+            url.copy(code, 2, i + 1);
+            decoded_url[size++] = static_cast<char>(strtol(code, nullptr, 16));
             i = i + 2;
         } else {
-            decoded_url += url[i];
+            decoded_url[size++] = url[i];
         }
     }
-    return decoded_url;
+    return {decoded_url, size};
 }
 
-// trim from start (in place)
-static inline void ltrim(std::string &s) {
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(),
-                                    std::not1(std::ptr_fun<int, int>(std::isspace))));
+// trim from both ends, without copying
+static inline std::string_view trim(std::string_view s) {
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.front()))) {
+        s.remove_prefix(1);
+    }
+    while (!s.empty() && std::isspace(static_cast<unsigned char>(s.back()))) {
+        s.remove_suffix(1);
+    }
+    return s;
 }
 
-// trim from end (in place)
-static inline void rtrim(std::string &s) {
-    s.erase(std::find_if(s.rbegin(), s.rend(),
-                         std::not1(std::ptr_fun<int, int>(std::isspace))).base(), s.end());
+static inline bool iequals(std::string_view lhs, std::string_view rhs) {
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end(),
+                      [](unsigned char l, unsigned char r) {
+                          return std::tolower(l) == std::tolower(r);
+                      });
 }
 
-// trim from both ends (in place)
-static inline std::string trim(std::string s) {
-    ltrim(s);
-    rtrim(s);
-    return s;
-}
+// Split `text` by `divider` into trimmed name=value pairs.
+// Pairs without a value are kept with an empty one.
+static void parse_pairs(std::string_view text, char divider, bool decode,
+                        http::arena_map<std::string_view, std::string_view> &res,
+                        http::Arena &arena) {
+    while (!text.empty()) {
+        auto next_end = text.find(divider);
+        auto pair = trim(text.substr(0, next_end));
+        text = next_end == std::string_view::npos ? std::string_view() : text.substr(next_end + 1);
+        if (pair.empty()) {
+            continue;
+        }
 
-std::size_t replace_all(std::string& inout, std::string_view what, std::string_view with) {
-    std::size_t count{};
-    for (std::string::size_type pos{};
-         std::string::npos != (pos = inout.find(what.data(), pos, what.length()));
-         pos += with.length(), ++count) {
-        inout.replace(pos, what.length(), with.data(), with.length());
+        auto end_value = pair.find('=');
+        auto name = trim(pair.substr(0, end_value));
+        auto value = end_value == std::string_view::npos
+                ? std::string_view() : trim(pair.substr(end_value + 1));
+        if (decode) {
+            name = decode_url(name, arena);
+            value = decode_url(value, arena);
+        }
+        res[name] = value;
     }
-    return count;
 }
 
-bool parse_url(nj::json& request, const std::string &url) {
-    size_t end = 0;
-    size_t next_end = url.find('?');
-    if (next_end == std::string::npos) {
-        request[URL] = url;
-        return true;
+static nj::json to_json(const http::arena_map<std::string_view, std::string_view> &map) {
+    nj::json res = nj::json::object();
+    for (auto &[key, value]: map) {
+        res[std::string(key)] = std::string(value);
     }
-    request[URL] = trim(url.substr(end, next_end - end));
-    end = next_end;
-    next_end = url.find('&', end + 1);
-    std::map<std::string, std::string> res;
-    while(next_end != std::string::npos) {
-        auto param = trim(url.substr(end + 1, next_end - end - 1));
-        auto end_value = param.find('=');
-        if (end_value == std::string::npos) {
-            return false;
-        }
+    return res;
+}
 
-        auto name = trim(param.substr(0, end_value));
-        auto value = trim(param.substr(end_value + 1));
-        res[name] = value;
-        end = next_end + 1;
-        next_end = url.find('&', next_end + 1);
+// Params and cookies are decoded on first access with a scratch arena
+static nj::json parse_pairs_to_json(std::string_view text, char divider, bool decode) {
+    thread_local http::Arena arena(4 * 1024);
+    nj::json res;
+    {
+        http::arena_map<std::string_view, std::string_view> pairs{http::ArenaAllocator<char>(arena)};
+        parse_pairs(text, divider, decode, pairs, arena);
+        res = to_json(pairs);
     }
-    auto param = trim(url.substr(end + 1, url.size() - end));
-    auto end_value = param.find('=');
-    if (end_value == std::string::npos) {
-        return false;
+    arena.reset();
+    return res;
+}
+
+// The target is forwarded as received, so the path is not percent-decoded
+static void parse_url(nj::json &request, std::string_view url, std::string_view &query) {
+    size_t next_end = url.find('?');
+    if (next_end == std::string_view::npos) {
+        request[URL] = std::string(url);
+        return;
     }
-    auto name = trim(param.substr(0, end_value));
-    auto value = trim(param.substr(end_value + 1));
-    res[name] = value;
+    request[URL] = std::string(trim(url.substr(0, next_end)));
 
-    request[PARAM] = res;
-    return true;
+    // The query string is kept raw until params are asked for
+    query = trim(url.substr(next_end + 1));
+    if (query.empty()) {
+        request[PARAM] = nj::json::object();
+    }
 }
 
-bool parse_first_line(nj::json& request, const std::string &text) {
+static bool parse_first_line(nj::json &request, std::string_view text, std::string_view &query) {
     auto end = text.find(' ');
-    if (end == std::string::npos) {
+    if (end == std::string_view::npos) {
         return false;
     }
-    request[METHOD] = trim(text.substr(0, end));
+    request[METHOD] = std::string(trim(text.substr(0, end)));
     auto next_end = text.find(' ', end + 1);
-    if (next_end == std::string::npos) {
+    if (next_end == std::string_view::npos) {
         return false;
     }
-    auto url = decode_url(trim(text.substr(end, next_end - end)));
 
-    if (!parse_url(request, url)) {
-        return false;
-    }
+    parse_url(request, trim(text.substr(end, next_end - end)), query);
 
     if (next_end == text.size()) {
         return false;
     }
 
-    request[VERSION] = trim(text.substr(next_end, text.size() - next_end));
+    request[VERSION] = std::string(trim(text.substr(next_end)));
     return true;
 }
 
-std::map<std::string, std::string> parse_cookies(const std::string &text) {
-    size_t end = 0;
-    size_t next_end = text.find(';');
-    std::map<std::string, std::string> res;
-    while(next_end != std::string::npos) {
-        auto cookie = trim(text.substr(end, next_end - end));
-        auto end_value = cookie.find('=');
-        if (end_value == std::string::npos) {
-            return {};
-        }
+// Appends `text` without '\r'
+static void append_stripped(std::string &res, std::string_view text) {
+    for (auto end = text.find('\r'); end != std::string_view::npos; end = text.find('\r')) {
+        res.append(text.substr(0, end));
+        text.remove_prefix(end + 1);
+    }
+    res.append(text);
+}
 
-        auto name = trim(cookie.substr(0, end_value));
-        auto value = trim(cookie.substr(end_value + 1));
-        res[name] = value;
-        next_end = text.find(';', end + 1);
+static bool is_blank_line(std::string_view line) {
+    return line.find_first_not_of('\r') == std::string_view::npos;
+}
+
+// Calls `callback(name, value)` for every line of a header block kept in
+// the "name: value\n" form
+template<typename Callback>
+static void for_each_header(std::string_view text, Callback &&callback) {
+    while (!text.empty()) {
+        auto end = text.find('\n');
+        auto line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+
+        auto divider_pos = line.find(": ");
+        callback(line.substr(0, divider_pos), line.substr(divider_pos + 2));
     }
+}
+
+// Copies the header lines of `text` into `headers` as "name: value\n" and
+// their cookies into `cookies`, both in one allocation at most
+static void parse_headers(std::string_view text, http::Arena &arena,
+                          std::string &headers, std::string &cookies) {
+    struct line_t {
+        std::string_view    name;
+        std::string_view    value;
+        bool                repeated;
+    };
+    http::arena_vector<line_t> lines{http::ArenaAllocator<char>(arena)};
+    size_t headers_size = 0, cookies_size = 0;
+
+    while (!text.empty()) {
+        auto end = text.find('\n');
+        auto line = text.substr(0, end);
+        text = end == std::string_view::npos ? std::string_view() : text.substr(end + 1);
+
+        auto divider_pos = line.find(": ");
+        if (divider_pos == std::string_view::npos) {
+            continue;
+        }
 
-    auto cookie = trim(text.substr(end + 1, text.size() - end));
-    auto end_value = cookie.find('=');
-    if (end_value == std::string::npos) {
-        return {};
+        auto name = trim(line.substr(0, divider_pos));
+        auto value = trim(line.substr(divider_pos + 1));
+        lines.push_back({name, value, false});
     }
-    auto name = trim(cookie.substr(0, end_value));
-    auto value = trim(cookie.substr(end_value + 1));
-    res[name] = value;
 
-    return res;
-}
+    for (size_t i = 0; i < lines.size(); ++i) {
+        auto &line = lines[i];
+        if (iequals(line.name, "cookie")) {
+            cookies_size += line.value.size() + 2;
+            continue;
+        }
+        // A repeated header keeps its last value
+        for (size_t j = i + 1; j < lines.size() && !line.repeated; ++j) {
+            line.repeated = lines[j].name == line.name;
+        }
+        headers_size += line.name.size() + line.value.size() + 3;
+    }
 
-bool parse_headers(nj::json& request, const std::string &text) {
-    size_t end = 0;
-    size_t next_end = text.find(": ");
-    nj::json tmp;
-    request[COOKIE] = nj::json();
-    while(next_end != std::string::npos) {
-        auto name = trim(text.substr(end, next_end - end));
-        end = text.find('\n', next_end + 1);
-        if (end == std::string::npos) {
-            return false;
+    headers.reserve(headers_size);
+    cookies.reserve(cookies_size);
+    for (auto &[name, value, repeated]: lines) {
+        if (repeated) {
+            continue;
         }
-        auto tm = trim(text.substr(next_end + 1, end - next_end - 1));
-        next_end = text.find(": ", end + 1);
-
-        auto lower_name = name;
-        std::transform(lower_name.begin(), lower_name.end(), lower_name.begin(),
-                       [](unsigned char c){ return std::tolower(c); });
-        if (lower_name == "cookie") {
-            auto cookies = parse_cookies(tm);
-            if (cookies.empty()) {
-                return false;
+        if (iequals(name, "cookie")) {
+            // Split into pairs only when cookies are asked for
+            if (!cookies.empty()) {
+                cookies += "; ";
             }
-            request[COOKIE] = nj::json(cookies);
+            append_stripped(cookies, value);
             continue;
         }
-
-        tmp[name] = tm;
-
+        append_stripped(headers, name);
+        headers += ": ";
+        append_stripped(headers, value);
+        headers += '\n';
     }
-    request[HEADERS] = tmp;
-    return true;
 }
 
 bool http::Request::parse(const std::string &request) {
-    auto request_ = request;
-    replace_all(request_, "\r", "");
-    auto end_first_line = request_.find('\n');
-    if (end_first_line == std::string::npos) {
+    thread_local Arena arena;
+    auto res = parse(request, arena);
+    arena.reset();
+    return res;
+}
+
+bool http::Request::parse(std::string_view request, Arena &arena) {
+    // '\r' is dropped while copying out of `request`, lines are split on '\n'
+    auto end_first_line = request.find('\n');
+    if (end_first_line == std::string_view::npos) {
         return false;
     }
-    auto first_line = trim(request_.substr(0, end_first_line));
-    request_ = request_.substr(end_first_line + 1, request_.size() - end_first_line - 1);
+    auto first_line = trim(request.substr(0, end_first_line));
+    request = request.substr(end_first_line + 1);
 
-    auto end_headers = request_.find("\n\n");
-    if (end_headers == std::string::npos) {
-        end_headers = request_.find('\n');
-        if (end_headers == std::string::npos) {
-            return false;
-        } else {
-            if (!parse_first_line(_request, first_line)) {
-                _request.clear();
-                return false;
-            }
-            return true;
+    // Headers end with the first blank line, the body follows it
+    size_t end_headers = 0, start_body = std::string_view::npos;
+    for (auto end = request.find('\n'); end != std::string_view::npos; end = request.find('\n', end_headers)) {
+        if (is_blank_line(request.substr(end_headers, end - end_headers))) {
+            start_body = end + 1;
+            break;
         }
+        end_headers = end + 1;
     }
-    auto headers = trim(request_.substr(0, end_headers)) + "\n";
-    request_ = trim(request_.substr(end_headers + 2, request_.size() - end_headers - 2));
-
-    auto body = std::move(request_);
 
-    if (!parse_first_line(_request, first_line)) {
-        _request.clear();
+    if (start_body == std::string_view::npos && request.find('\n') == std::string_view::npos) {
         return false;
     }
 
-    if (!parse_headers(_request, headers)) {
-        _request.clear();
+    nj::json result;
+    std::string_view query;
+    if (!parse_first_line(result, first_line, query)) {
+        _clear();
         return false;
     }
 
-    _request[BODY] = body;
-    std::string serialized_string = _request.dump();
+    if (start_body == std::string_view::npos) {
+        // Without a blank line only the first line is taken
+        result[HEADERS] = nj::json::object();
+        _request = std::move(result);
+        _raw_query = query;
+        _raw_headers.clear();
+        _raw_cookies.clear();
+        return true;
+    }
+    auto headers = request.substr(0, end_headers);
+    auto body = trim(request.substr(start_body));
+
+    std::string raw_headers, cookies;
+    parse_headers(headers, arena, raw_headers, cookies);
+    if (raw_headers.empty()) {
+        result[HEADERS] = nj::json::object();
+    }
+    result[COOKIE] = nj::json();
+
+    std::string body_;
+    body_.reserve(body.size());
+    append_stripped(body_, body);
+    result[BODY] = std::move(body_);
+
+    _request = std::move(result);
+    _raw_query = query;
+    _raw_headers = std::move(raw_headers);
+    _raw_cookies = std::move(cookies);
     return true;
 }
 
@@ -236,14 +319,9 @@ std::string http::Request::string() const {
         res += _request[URL].get<std::string>();
     }
 
-    if (_request.contains(PARAM)) {
-        if (!_request[PARAM].empty()) {
-            res += "?";
-        }
-
-        for (auto&[key, value]: _request[PARAM].items()) {
-            res += key + "=" + value.get<std::string>() + "&";
-        }
+    auto query = _query_string();
+    if (!query.empty()) {
+        res += "?" + query;
     }
 
     if (_request.contains(URL) && _request.contains(VERSION)) {
@@ -257,24 +335,19 @@ std::string http::Request::string() const {
 
     res += divider;
 
-    if (_request.contains(HEADERS)) {
+    if (!_raw_headers.empty()) {
+        for_each_header(_raw_headers, [&res](std::string_view name, std::string_view value) {
+            res.append(name).append(": ").append(value).append(divider);
+        });
+    } else if (_request.contains(HEADERS)) {
         for (auto&[key, value]: _request[HEADERS].items()) {
             res += key + ": " + value.get<std::string>() + divider;
         }
     }
 
-    if (_request.contains(COOKIE)) {
-        if (!_request[COOKIE].empty()) {
-            res += "Cookie: ";
-        }
-
-        for (auto&[key, value]: _request[COOKIE].items()) {
-            res += key + "=" + value.get<std::string>() + ";";
-        }
-
-        if (!_request[COOKIE].empty()) {
-            res += divider;
-        }
+    auto cookies = _cookie_string();
+    if (!cookies.empty()) {
+        res += "Cookie: " + cookies + divider;
     }
 
     res += divider;
@@ -286,18 +359,223 @@ std::string http::Request::string() const {
 
 
 nj::json http::Request::get_json() const {
+    _parse_headers();
+    _parse_params();
+    _parse_cookies();
     return _request;
 }
 
 nj::json& http::Request::json() {
+    _parse_headers();
+    _parse_params();
+    _parse_cookies();
     return _request;
 }
 
+void http::Request::_parse_headers() const {
+    if (_raw_headers.empty()) {
+        return;
+    }
+    nj::json headers = nj::json::object();
+    for_each_header(_raw_headers, [&headers](std::string_view name, std::string_view value) {
+        headers[std::string(name)] = std::string(value);
+    });
+    _request[HEADERS] = std::move(headers);
+    _raw_headers.clear();
+}
+
+void http::Request::_parse_params() const {
+    if (_raw_query.empty()) {
+        return;
+    }
+    _request[PARAM] = parse_pairs_to_json(_raw_query, '&', true);
+    _raw_query.clear();
+}
+
+void http::Request::_parse_cookies() const {
+    if (_raw_cookies.empty()) {
+        return;
+    }
+    _request[COOKIE] = parse_pairs_to_json(_raw_cookies, ';', false);
+    _raw_cookies.clear();
+}
+
+std::string http::Request::_query_string() const {
+    if (!_raw_query.empty() || !_request.contains(PARAM) || !_request[PARAM].is_object()) {
+        return _raw_query;
+    }
+
+    std::string res;
+    for (auto&[key, value]: _request[PARAM].items()) {
+        if (!res.empty()) {
+            res += '&';
+        }
+        encode_component(res, key);
+        res += '=';
+        encode_component(res, value.get<std::string>());
+    }
+    return res;
+}
+
+std::string http::Request::_cookie_string() const {
+    if (!_raw_cookies.empty() || !_request.contains(COOKIE) || !_request[COOKIE].is_object()) {
+        return _raw_cookies;
+    }
+
+    std::string res;
+    for (auto&[key, value]: _request[COOKIE].items()) {
+        if (!res.empty()) {
+            res += "; ";
+        }
+        res += key + "=" + value.get<std::string>();
+    }
+    return res;
+}
+
+// Binary format:
+//  "HR" <format version> <method> <url> <version> <query> <cookies> <body>
+//  <headers count> (<name> <value>)*
+// Every string is prefixed by its LEB128 length, counts are LEB128 too.
+static const char binary_magic[] = {'H', 'R', 1};
+
+static void write_varint(std::string &res, size_t value) {
+    while (value >= 0x80) {
+        res += (char) (value | 0x80);
+        value >>= 7;
+    }
+    res += (char) value;
+}
+
+static void write_string(std::string &res, std::string_view value) {
+    write_varint(res, value.size());
+    res.append(value);
+}
+
+static bool read_varint(std::string_view &data, size_t &value) {
+    value = 0;
+    for (size_t shift = 0; shift < 64; shift += 7) {
+        if (data.empty()) {
+            return false;
+        }
+        auto byte = (unsigned char) data.front();
+        data.remove_prefix(1);
+        value |= (size_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool read_string(std::string_view &data, std::string_view &value) {
+    size_t size = 0;
+    if (!read_varint(data, size) || size > data.size()) {
+        return false;
+    }
+    value = data.substr(0, size);
+    data.remove_prefix(size);
+    return true;
+}
+
+std::string http::Request::encode() const {
+    auto query = _query_string();
+    auto cookies = _cookie_string();
+    auto body = _request.contains(BODY) && _request[BODY].is_string()
+            ? std::string_view(_request[BODY].get_ref<const std::string &>()) : std::string_view();
+
+    std::string res;
+    res.reserve(64 + query.size() + cookies.size() + body.size());
+    res.append(binary_magic, sizeof(binary_magic));
+
+    for (auto key: {METHOD, URL, VERSION}) {
+        write_string(res, _request.contains(key) && _request[key].is_string()
+                ? std::string_view(_request[key].get_ref<const std::string &>()) : std::string_view());
+    }
+    write_string(res, query);
+    write_string(res, cookies);
+    write_string(res, body);
+
+    if (!_raw_headers.empty()) {
+        write_varint(res, (size_t) std::count(_raw_headers.begin(), _raw_headers.end(), '\n'));
+        for_each_header(_raw_headers, [&res](std::string_view name, std::string_view value) {
+            write_string(res, name);
+            write_string(res, value);
+        });
+    } else if (_request.contains(HEADERS) && _request[HEADERS].is_object()) {
+        auto &headers = _request[HEADERS];
+        write_varint(res, headers.size());
+        for (auto&[key, value]: headers.items()) {
+            write_string(res, key);
+            write_string(res, value.is_string() ? value.get_ref<const std::string &>() : "");
+        }
+    } else {
+        write_varint(res, 0);
+    }
+    return res;
+}
+
+bool http::Request::decode(std::string_view data) {
+    if (data.substr(0, sizeof(binary_magic)) != std::string_view(binary_magic, sizeof(binary_magic))) {
+        return false;
+    }
+    data.remove_prefix(sizeof(binary_magic));
+
+    // Fields are read as views into `data` and copied once into the request
+    std::string_view method, url, version, query, cookies, body;
+    if (!read_string(data, method) || !read_string(data, url) || !read_string(data, version)
+        || !read_string(data, query) || !read_string(data, cookies) || !read_string(data, body)) {
+        _clear();
+        return false;
+    }
+
+    size_t count = 0;
+    if (!read_varint(data, count)) {
+        _clear();
+        return false;
+    }
+
+    nj::json headers = nj::json::object();
+    for (size_t i = 0; i < count; ++i) {
+        std::string_view name, value;
+        if (!read_string(data, name) || !read_string(data, value)) {
+            _clear();
+            return false;
+        }
+        headers[std::string(name)] = std::string(value);
+    }
+
+    nj::json result;
+    result[METHOD] = std::string(method);
+    result[URL] = std::string(url);
+    result[VERSION] = std::string(version);
+    result[HEADERS] = std::move(headers);
+    result[COOKIE] = nj::json();
+    result[BODY] = std::string(body);
+
+    _request = std::move(result);
+    _raw_query = query;
+    _raw_headers.clear();
+    _raw_cookies = cookies;
+    return true;
+}
+
+void http::Request::_clear() {
+    _request.clear();
+    _raw_query.clear();
+    _raw_headers.clear();
+    _raw_cookies.clear();
+}
+
 http::Request::Request(const std::string &request) {
     parse(request);
 }
 
+http::Request::Request(std::string_view request, Arena &arena) {
+    parse(request, arena);
+}
+
 std::string http::Request::get_param(const std::string& name) const {
+    _parse_params();
     if (_request.contains(PARAM)) {
         return _get_param(_request[PARAM], name);
     }
@@ -305,10 +583,10 @@ std::string http::Request::get_param(const std::string& name) const {
 }
 
 std::map<std::string, std::string> http::Request::get_params() const {
+    _parse_params();
     if (_request.contains(PARAM)) {
         std::map<std::string, std::string> res;
         for (auto& [key, value] : _request[PARAM].items()) {
-            std::string tmp = _request[PARAM].dump();
             res[key] = value.get<std::string>();
         }
         return res;
@@ -317,6 +595,16 @@ std::map<std::string, std::string> http::Request::get_params() const {
 }
 
 std::string http::Request::get_header(const std::string &name) const {
+    if (!_raw_headers.empty()) {
+        // The last one wins, as when the headers are parsed
+        std::string res;
+        for_each_header(_raw_headers, [&name, &res](std::string_view key, std::string_view value) {
+            if (key == name) {
+                res = value;
+            }
+        });
+        return res;
+    }
     if (_request.contains(HEADERS)) {
         return _get_param(_request[HEADERS], name);
     }
@@ -340,6 +628,7 @@ std::string http::Request::get_body() const {
 }
 
 bool http::Request::set_header(const std::string &name, const std::string &value) {
+    _parse_headers();
     if (_request.contains(HEADERS)) {
         return _set_param(_request[HEADERS], name, value);
     }
@@ -347,6 +636,7 @@ bool http::Request::set_header(const std::string &name, const std::string &value
 }
 
 bool http::Request::set_param(const std::string &name, const std::string &value) {
+    _parse_params();
     if (_request.contains(PARAM)) {
         return _set_param(_request[PARAM], name, value);
     }
@@ -395,10 +685,10 @@ bool http::Request::_set_param(nj::json &json, const std::string &name, const st
 }
 
 std::map<std::string, std::string> http::Request::get_cookies() const {
+    _parse_cookies();
     if (_request.contains(COOKIE)) {
         std::map<std::string, std::string> res;
         for (auto& [key, value] : _request[COOKIE].items()) {
-            std::string tmp = _request[COOKIE].dump();
             res[key] = value.get<std::string>();
         }
         return res;
@@ -412,9 +702,13 @@ http::Request::Request() {
 
 void http::Request::read_json_from_string(const std::string &json) {
     _request = nj::json::parse(json);
+    _raw_query.clear();
+    _raw_headers.clear();
+    _raw_cookies.clear();
 }
 
 std::map<std::string, std::string> http::Request::get_headers() const {
+    _parse_headers();
     if (_request.contains(HEADERS)) {
         std::map<std::string, std::string> res;
         for (auto& [key, value] : _request[HEADERS].items()) {
@@ -427,6 +721,7 @@ std::map<std::string, std::string> http::Request::get_headers() const {
 }
 
 bool http::Request::set_cookie(const std::string &name, const std::string &value) {
+    _parse_cookies();
     if (_request.contains(COOKIE)) {
         return _set_param(_request[COOKIE], name, value);
     }
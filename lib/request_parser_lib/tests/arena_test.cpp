@@ -0,0 +1,100 @@
+#include "include/arena.hpp"
+
+#include <cstdint>
+#include <string>
+
+#include <gtest/gtest.h>
+
+using http::Arena;
+
+TEST(Arena, AlignsAllocations) {
+    Arena arena(256);
+    arena.allocate_chars(1);
+    for (size_t align : {2, 4, 8, 16, 32}) {
+        auto ptr = reinterpret_cast<uintptr_t>(arena.allocate(3, align));
+        EXPECT_EQ(ptr % align, 0u) << "align " << align;
+    }
+}
+
+TEST(Arena, CopyOwnsTheBytes) {
+    Arena arena;
+    std::string source = "Host: example.com";
+    auto copy = arena.copy(source);
+    source.assign(source.size(), 'x');
+
+    EXPECT_EQ(copy, "Host: example.com");
+    EXPECT_TRUE(arena.copy("").empty());
+}
+
+TEST(Arena, ResetKeepsRegularBlocks) {
+    Arena arena(128);
+    auto first = arena.allocate(100);
+    arena.allocate(100);
+    auto before = arena.get_stats();
+    EXPECT_EQ(before.blocks, 2u);
+    EXPECT_EQ(before.allocations, 2u);
+
+    arena.reset();
+    auto after = arena.get_stats();
+    EXPECT_EQ(after.blocks, 2u);
+    EXPECT_EQ(after.capacity, before.capacity);
+    EXPECT_EQ(after.used, 0u);
+    EXPECT_EQ(after.allocations, 0u);
+    EXPECT_EQ(after.total_allocations, 2u);
+    EXPECT_EQ(after.resets, 1u);
+
+    // The next request starts again in the first block
+    EXPECT_EQ(arena.allocate(100), first);
+    EXPECT_EQ(arena.get_stats().capacity, before.capacity);
+}
+
+TEST(Arena, OversizedBlocksAreDroppedOnReset) {
+    Arena arena(128);
+    arena.allocate(16);
+    auto regular = arena.get_stats().capacity;
+
+    arena.allocate(1000);
+    auto stats = arena.get_stats();
+    EXPECT_EQ(stats.oversized, 1u);
+    EXPECT_GE(stats.capacity, regular + 1000);
+
+    arena.reset();
+    EXPECT_EQ(arena.get_stats().capacity, regular);
+    EXPECT_EQ(arena.get_stats().blocks, 1u);
+}
+
+TEST(Arena, ReleaseFreesEverything) {
+    Arena arena(128);
+    arena.allocate(100);
+    arena.allocate(1000);
+    arena.release();
+
+    auto stats = arena.get_stats();
+    EXPECT_EQ(stats.blocks, 0u);
+    EXPECT_EQ(stats.capacity, 0u);
+    EXPECT_NE(arena.allocate(8), nullptr);
+}
+
+TEST(Arena, MoveLeavesSourceEmpty) {
+    Arena arena(128);
+    auto text = arena.copy("kept");
+    Arena moved(std::move(arena));
+
+    EXPECT_EQ(text, "kept");
+    EXPECT_EQ(moved.get_stats().allocations, 1u);
+    EXPECT_EQ(arena.get_stats().allocations, 0u); // NOLINT(bugprone-use-after-move)
+}
+
+TEST(Arena, BacksContainers) {
+    Arena arena(256);
+    http::arena_vector<int> values{http::ArenaAllocator<int>(arena)};
+    for (int i = 0; i < 100; ++i) {
+        values.push_back(i);
+    }
+    http::arena_string text{http::ArenaAllocator<char>(arena)};
+    text = "a string that does not fit in the small buffer";
+
+    EXPECT_EQ(values[99], 99);
+    EXPECT_EQ(text, "a string that does not fit in the small buffer");
+    EXPECT_GT(arena.get_stats().allocations, 1u);
+}
@@ -0,0 +1,97 @@
+#include "include/request_parser.hpp"
+
+#include <string>
+
+#include <gtest/gtest.h>
+
+using http::Request;
+
+static const std::string raw_request =
+        "POST /login?user=admin&next=%2Fhome HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "Content-Type: application/x-www-form-urlencoded\r\n"
+        "Cookie: session=abc; theme=dark\r\n"
+        "\r\n"
+        "password=secret";
+
+static void expect_same(const Request &lhs, const Request &rhs) {
+    EXPECT_EQ(lhs.get_method(), rhs.get_method());
+    EXPECT_EQ(lhs.get_url(), rhs.get_url());
+    EXPECT_EQ(lhs.get_version(), rhs.get_version());
+    EXPECT_EQ(lhs.get_params(), rhs.get_params());
+    EXPECT_EQ(lhs.get_headers(), rhs.get_headers());
+    EXPECT_EQ(lhs.get_cookies(), rhs.get_cookies());
+    EXPECT_EQ(lhs.get_body(), rhs.get_body());
+}
+
+TEST(RequestCodec, RoundTrip) {
+    Request original(raw_request);
+    auto data = original.encode();
+
+    Request decoded;
+    ASSERT_TRUE(decoded.decode(data));
+    // Decoded headers come back sorted by name, from then on encoding is stable
+    Request again;
+    ASSERT_TRUE(again.decode(decoded.encode()));
+    EXPECT_EQ(again.encode(), decoded.encode());
+
+    expect_same(decoded, original);
+    EXPECT_EQ(decoded.get_param("next"), "/home");
+    EXPECT_EQ(decoded.get_cookies()["theme"], "dark");
+    EXPECT_EQ(decoded.get_header("Host"), "example.com");
+}
+
+TEST(RequestCodec, RoundTripOfEditedRequest) {
+    Request original(raw_request);
+    original.set_header("X-Test", "1");
+    original.set_param("page", "2");
+    original.set_body("");
+
+    Request decoded;
+    ASSERT_TRUE(decoded.decode(original.encode()));
+    expect_same(decoded, original);
+    EXPECT_EQ(decoded.get_header("X-Test"), "1");
+}
+
+TEST(RequestCodec, RoundTripOfEmptyRequest) {
+    Request empty;
+    Request decoded;
+    ASSERT_TRUE(decoded.decode(empty.encode()));
+    EXPECT_TRUE(decoded.get_headers().empty());
+    EXPECT_TRUE(decoded.get_body().empty());
+}
+
+TEST(RequestCodec, RejectsForeignData) {
+    Request request(raw_request);
+    EXPECT_FALSE(request.decode(""));
+    EXPECT_FALSE(request.decode(R"({"method":"GET"})"));
+
+    auto data = Request(raw_request).encode();
+    data[2] = 2;    // unknown format version
+    EXPECT_FALSE(request.decode(data));
+}
+
+TEST(RequestCodec, RejectsEveryTruncation) {
+    auto data = Request(raw_request).encode();
+    for (size_t size = 0; size < data.size(); ++size) {
+        Request request(raw_request);
+        EXPECT_FALSE(request.decode(std::string_view(data).substr(0, size))) << "size " << size;
+        // Past the 3 byte header a failed decode leaves nothing of the previous request
+        if (size >= 3) {
+            EXPECT_TRUE(request.get_method().empty()) << "size " << size;
+        }
+    }
+}
+
+TEST(RequestCodec, RejectsLengthsPastTheEnd) {
+    auto data = Request(raw_request).encode();
+    // The method length is the first varint after the 3 byte header
+    auto corrupted = data;
+    corrupted[3] = (char) 0x7f;
+    Request request;
+    EXPECT_FALSE(request.decode(corrupted));
+
+    // A varint that never ends
+    corrupted = data.substr(0, 3) + std::string(16, (char) 0xff);
+    EXPECT_FALSE(request.decode(corrupted));
+}
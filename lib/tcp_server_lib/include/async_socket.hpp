@@ -0,0 +1,39 @@
+#pragma once
+
+#include "tcp_base_socket.hpp"
+#include "event_loop.hpp"
+#include "connect_race.hpp"
+#include "task.hpp"
+
+namespace bstcp {
+
+// Operations of a non-blocking socket that wait on an EventLoop instead of
+// blocking the thread. Awaited on the loop thread only. Timeouts are in ms
+class AsyncSocket {
+  public:
+    AsyncSocket(EventLoop &loop, BaseSocket &socket)
+            : _loop(loop)
+              , _socket(socket) {}
+
+    // True when there is something to read within `timeout`, including what
+    // the socket holds already (see BaseSocket::get_pending)
+    Task<bool> readable(long timeout);
+
+    // Reads what is available, up to `size` bytes. Returns the number of
+    // bytes read, 0 if the peer closed the connection and -1 on error or timeout
+    Task<int> read(void *buffer, int size, long timeout);
+
+    // Sends all `size` bytes, false on error or timeout
+    Task<bool> write(const void *buffer, int size, long timeout);
+
+    Task<status> connect(uint32_t host, uint16_t port, long timeout);
+
+    // Runs `race` and takes its winner, which stays non-blocking
+    Task<status> connect(ConnectRace &race);
+
+  private:
+    EventLoop   &_loop;
+    BaseSocket  &_socket;
+};
+
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "cpu_topology.hpp"
+
+namespace bstcp {
+
+struct pool_stats_t {
+    size_t live;    // blocks handed out now
+    size_t free;    // blocks kept for reuse
+};
+
+// Fixed-size blocks recycled instead of given back to the heap. Every thread
+// keeps a small cache of free blocks and moves half of it to or from a shared
+// list when it runs empty or full, so blocks freed on another thread come back
+// without taking the lock on most calls. Blocks are never released: the pool
+// stays at its peak size and a steady load allocates nothing.
+//
+// There is a shared list per NUMA node, used by the threads running on it: a
+// block first touched on a node is reused there, never handed to a thread of
+// another node.
+template<size_t Size, size_t Align = alignof(std::max_align_t)>
+class BlockPool {
+  public:
+    static const size_t cache_size = 64;
+
+    static void *allocate() {
+        void *block = nullptr;
+        if (_thread_exited) {
+            block = _take_shared();
+        } else {
+            auto &cache = _cache().blocks;
+            if (cache.empty()) {
+                _move_from_shared(cache);
+            }
+            if (!cache.empty()) {
+                block = cache.back();
+                cache.pop_back();
+            }
+        }
+
+        if (!block) {
+            block = ::operator new(Size, std::align_val_t(Align));
+            _total.fetch_add(1, std::memory_order_relaxed);
+        }
+        _live.fetch_add(1, std::memory_order_relaxed);
+        return block;
+    }
+
+    static void deallocate(void *block) {
+        _live.fetch_sub(1, std::memory_order_relaxed);
+        if (_thread_exited) {
+            _move_to_shared(&block, 1);
+            return;
+        }
+
+        auto &cache = _cache().blocks;
+        cache.push_back(block);
+        if (cache.size() == cache_size) {
+            _move_to_shared(cache.data() + cache_size / 2, cache_size / 2);
+            cache.resize(cache_size / 2);
+        }
+    }
+
+    static pool_stats_t get_stats() {
+        auto live = _live.load(std::memory_order_relaxed);
+        auto total = _total.load(std::memory_order_relaxed);
+        return {live, total > live ? total - live : 0};
+    }
+
+  private:
+    struct shared_t {
+        std::mutex          mutex;
+        std::vector<void *> blocks;
+    };
+
+    struct cache_t {
+        std::vector<void *> blocks;
+
+        cache_t() {
+            blocks.reserve(cache_size);
+        }
+
+        ~cache_t() {
+            _move_to_shared(blocks.data(), blocks.size());
+            _thread_exited = true;
+        }
+    };
+
+    // Never destroyed, blocks may be freed while statics are destroyed at exit
+    static shared_t &_shared() {
+        static auto *instance = new std::vector<shared_t>(prll::CpuTopology::get().get_nodes().size());
+        return (*instance)[prll::CpuTopology::get().current_node() % instance->size()];
+    }
+
+    static cache_t &_cache() {
+        thread_local cache_t cache;
+        return cache;
+    }
+
+    static void *_take_shared() {
+        auto &shared = _shared();
+        std::lock_guard<std::mutex> lck(shared.mutex);
+        if (shared.blocks.empty()) {
+            return nullptr;
+        }
+        auto block = shared.blocks.back();
+        shared.blocks.pop_back();
+        return block;
+    }
+
+    static void _move_from_shared(std::vector<void *> &cache) {
+        auto &shared = _shared();
+        std::lock_guard<std::mutex> lck(shared.mutex);
+        auto count = std::min(shared.blocks.size(), cache_size / 2);
+        cache.insert(cache.end(), shared.blocks.end() - count, shared.blocks.end());
+        shared.blocks.resize(shared.blocks.size() - count);
+    }
+
+    static void _move_to_shared(void **blocks, size_t count) {
+        auto &shared = _shared();
+        std::lock_guard<std::mutex> lck(shared.mutex);
+        shared.blocks.insert(shared.blocks.end(), blocks, blocks + count);
+    }
+
+    // Set once the cache of the thread is destroyed, later calls of that
+    // thread go to the shared list
+    static inline thread_local bool _thread_exited = false;
+
+    static inline std::atomic<size_t> _live{0};
+    static inline std::atomic<size_t> _total{0};
+};
+
+// Pool of blocks fitting a T, shared by every type of the same size
+template<typename T>
+using ObjectPool = BlockPool<sizeof(T), alignof(T)>;
+
+}
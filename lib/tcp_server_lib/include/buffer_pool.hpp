@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+
+#include "block_pool.hpp"
+
+namespace bstcp {
+
+static const size_t io_buffer_size = 16 * 1024;
+
+// Buffer of io_buffer_size bytes taken from the buffer pool and given back
+// on destruction. The contents are left from the previous owner
+class IOBuffer {
+  public:
+    IOBuffer();
+
+    IOBuffer(const IOBuffer&) = delete;
+    IOBuffer& operator=(const IOBuffer&) = delete;
+
+    IOBuffer(IOBuffer&& buffer) noexcept;
+
+    IOBuffer& operator=(IOBuffer&& buffer) noexcept;
+
+    ~IOBuffer();
+
+    [[nodiscard]] char *data() {
+        return _data;
+    }
+
+    [[nodiscard]] static constexpr size_t size() {
+        return io_buffer_size;
+    }
+
+  private:
+    char *_data;
+};
+
+class BufferPool {
+  public:
+    [[nodiscard]] static pool_stats_t get_stats();
+};
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace bstcp {
+
+// Slot of a client in a ClientTable. The generation changes every time the
+// slot is freed, so a handle kept after removal finds nothing
+struct client_handle_t {
+    uint32_t index;
+    uint32_t generation;
+};
+
+// Clients of a server in a slab of slots with a free list and a hash index
+// on (host, port). Insertion, removal and lookups are O(1); iteration holds a
+// shared lock, so clients are never removed under a running loop.
+template<typename T>
+class ClientTable {
+  public:
+    ClientTable() = default;
+
+    ClientTable(const ClientTable&) = delete;
+    ClientTable& operator=(const ClientTable&) = delete;
+
+    client_handle_t insert(std::unique_ptr<T> client) {
+        auto key = _key(client->get_host(), client->get_port());
+
+        std::unique_lock lock(_mutex);
+        uint32_t index;
+        if (_free.empty()) {
+            index = (uint32_t) _slots.size();
+            _slots.emplace_back();
+        } else {
+            index = _free.back();
+            _free.pop_back();
+        }
+
+        auto& slot = _slots[index];
+        slot.client = std::move(client);
+        slot.key = key;
+        _index.emplace(key, index);
+        _size++;
+        return {index, slot.generation};
+    }
+
+    // The client is given back to the caller, nullptr for a stale handle
+    std::unique_ptr<T> remove(client_handle_t handle) {
+        std::unique_lock lock(_mutex);
+        if (!_is_live(handle)) {
+            return nullptr;
+        }
+
+        auto& slot = _slots[handle.index];
+        auto range = _index.equal_range(slot.key);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == handle.index) {
+                _index.erase(it);
+                break;
+            }
+        }
+
+        slot.generation++;
+        _free.push_back(handle.index);
+        _size--;
+        return std::move(slot.client);
+    }
+
+    // Calls `callback(handle, client)` for every client
+    template<typename Callable>
+    void for_each(Callable&& callback) {
+        std::shared_lock lock(_mutex);
+        for (uint32_t i = 0; i < _slots.size(); ++i) {
+            if (_slots[i].client) {
+                callback(client_handle_t{i, _slots[i].generation}, *_slots[i].client);
+            }
+        }
+    }
+
+    // Calls `callback(client)` for the clients at host:port, false if none
+    template<typename Callable>
+    bool for_each_by(uint32_t host, uint16_t port, Callable&& callback) {
+        std::shared_lock lock(_mutex);
+        auto range = _index.equal_range(_key(host, port));
+        for (auto it = range.first; it != range.second; ++it) {
+            callback(*_slots[it->second].client);
+        }
+        return range.first != range.second;
+    }
+
+    void clear() {
+        std::unique_lock lock(_mutex);
+        for (auto& slot : _slots) {
+            if (slot.client) {
+                slot.client.reset();
+                slot.generation++;
+            }
+        }
+        _free.clear();
+        for (uint32_t i = _slots.size(); i > 0; --i) {
+            _free.push_back(i - 1);
+        }
+        _index.clear();
+        _size = 0;
+    }
+
+    [[nodiscard]] size_t size() const {
+        std::shared_lock lock(_mutex);
+        return _size;
+    }
+
+  private:
+    struct slot_t {
+        std::unique_ptr<T>  client;
+        uint32_t            generation = 0;
+        uint64_t            key = 0;
+    };
+
+    static uint64_t _key(uint32_t host, uint16_t port) {
+        return ((uint64_t) host << 16) | port;
+    }
+
+    [[nodiscard]] bool _is_live(client_handle_t handle) const {
+        return handle.index < _slots.size()
+               && _slots[handle.index].generation == handle.generation
+               && _slots[handle.index].client;
+    }
+
+    mutable std::shared_mutex                       _mutex;
+    std::vector<slot_t>                             _slots;
+    std::vector<uint32_t>                           _free;
+    std::unordered_multimap<uint64_t, uint32_t>     _index;
+    size_t                                          _size = 0;
+};
+
+}
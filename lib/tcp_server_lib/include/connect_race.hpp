@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+
+#include "tcp_base_socket.hpp"
+
+namespace bstcp {
+
+struct connect_config_t {
+    long attempt_timeout    = 3000; // ms one address is given to answer
+    long attempt_delay      = 250;  // ms before the next address is tried alongside
+};
+
+// Happy Eyeballs (RFC 8305): connects to the first of several addresses to
+// answer. Attempts start in order, the next one when the previous has failed
+// or `attempt_delay` has passed, and each is dropped after `attempt_timeout`.
+// Sockets are non-blocking while racing. Driven by run() with poll, or by
+// AsyncSocket::connect() on an event loop
+class ConnectRace {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    ConnectRace(std::vector<endpoint_t> endpoints, uint16_t port, connect_config_t config = {});
+
+    ConnectRace(const ConnectRace &) = delete;
+    ConnectRace &operator=(const ConnectRace &) = delete;
+
+    // Starts the attempts that are due and drops the ones out of time, true
+    // once the race is over
+    bool advance();
+
+    // Sockets of the attempts in progress; one of them becoming writable
+    // means it is decided
+    [[nodiscard]] std::vector<socket_t> get_waiting();
+
+    // ms until advance() has something to do without any socket ready
+    [[nodiscard]] long get_wait_time() const;
+
+    // The attempt of get_waiting()[index] is writable
+    void on_ready(size_t index);
+
+    // Moves the winner into `socket`, err_socket_connect if none connected
+    status finish(BaseSocket &socket);
+
+    // Blocks until the race is over, then finish()
+    status run(BaseSocket &socket, bool blocking = true);
+
+    [[nodiscard]] size_t get_attempts() const;
+
+    [[nodiscard]] size_t get_failed() const;
+
+  private:
+    struct attempt_t {
+        BaseSocket          socket;
+        clock::time_point   deadline;
+    };
+
+    void _start(const endpoint_t &endpoint, clock::time_point now);
+
+    void _fail(size_t index, clock::time_point now);
+
+    void _win(BaseSocket &socket);
+
+    std::vector<endpoint_t> _endpoints;
+    connect_config_t        _config;
+
+    size_t                  _next;
+    clock::time_point       _next_start;
+    std::vector<attempt_t>  _pending;
+
+    bool                    _won;
+    BaseSocket              _winner;
+    size_t                  _attempts;
+    size_t                  _failed;
+};
+
+}
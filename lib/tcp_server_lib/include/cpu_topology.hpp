@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace prll {
+
+// Online CPUs grouped by NUMA node, read once from sysfs. Without sysfs
+// every CPU is put in node 0
+class CpuTopology {
+  public:
+    static const CpuTopology &get();
+
+    // Ascending ids of all online CPUs
+    [[nodiscard]] const std::vector<int> &get_cpus() const;
+
+    [[nodiscard]] const std::vector<std::vector<int>> &get_nodes() const;
+
+    [[nodiscard]] int node_of(int cpu) const;
+
+    // Node of the CPU running the caller
+    [[nodiscard]] int current_node() const;
+
+    // Parses a kernel cpu list such as "0-3,8,10-11"
+    static std::vector<int> parse_cpu_list(std::string_view list);
+
+  private:
+    CpuTopology();
+
+    std::vector<int>                _cpus;
+    std::vector<std::vector<int>>   _nodes;
+    std::vector<int>                _node_of;   // by cpu id
+};
+
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "tcp_utilits.hpp"
+#include "parallel.hpp"
+#include "shard.hpp"
+#include "task.hpp"
+
+namespace bstcp {
+
+// One thread running the coroutines of many connections. A coroutine waits
+// for its socket with co_await readable()/writable() and the thread serves
+// the others meanwhile. Coroutines are started and resumed only on the loop
+// thread, so what they share needs no locking. Built on epoll, Linux only
+class EventLoop {
+  public:
+    using clock = std::chrono::steady_clock;
+
+    // Result of a wait that could not be registered, or that was cut short
+    // by the loop going away
+    static constexpr int wait_failed = -2;
+
+    // Resumes with true when `fd` is ready, false when `timeout` ms passed
+    // first (never with a negative timeout) or the wait failed
+    class io_awaitable {
+      public:
+        io_awaitable(EventLoop &loop, socket_t fd, uint32_t events, long timeout)
+                : _loop(loop)
+                  , _fd(fd)
+                  , _events(events)
+                  , _timeout(timeout) {}
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            return _loop._wait(handle, &_fd, 1, _events, _timeout, &_result);
+        }
+
+        [[nodiscard]] bool await_resume() const noexcept {
+            return _result == 0;
+        }
+
+      private:
+        EventLoop   &_loop;
+        socket_t    _fd;
+        uint32_t    _events;
+        long        _timeout;
+        int         _result = -1;
+    };
+
+    // io_awaitable for several fds: resumes with the index of the first one
+    // ready, -1 on timeout or wait_failed
+    class any_awaitable {
+      public:
+        any_awaitable(EventLoop &loop, std::vector<socket_t> fds, uint32_t events, long timeout)
+                : _loop(loop)
+                  , _fds(std::move(fds))
+                  , _events(events)
+                  , _timeout(timeout) {}
+
+        [[nodiscard]] bool await_ready() const noexcept {
+            return _fds.empty();
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle) {
+            return _loop._wait(handle, _fds.data(), _fds.size(), _events, _timeout, &_result);
+        }
+
+        [[nodiscard]] int await_resume() const noexcept {
+            return _result;
+        }
+
+      private:
+        EventLoop               &_loop;
+        std::vector<socket_t>   _fds;
+        uint32_t                _events;
+        long                    _timeout;
+        int                     _result = -1;
+    };
+
+    EventLoop();
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    // Resumes the coroutines still waiting with wait_failed and runs them to
+    // their end, so that their frames are freed before what they refer to
+    ~EventLoop();
+
+    // Runs the loop on a new thread, `on_start` is called on it first
+    void start(const std::function<void()> &on_start = {});
+
+    // Runs the loop on the calling thread until stop()
+    void run();
+
+    void stop();
+
+    // Resumes `handle` on the loop thread. Callable from any thread
+    void post(std::coroutine_handle<> handle);
+
+    // Starts `task` on the loop thread. Callable from any thread
+    void spawn(Task<void> task);
+
+    // co_await schedule() moves the coroutine to the loop thread
+    auto schedule() {
+        struct awaiter {
+            EventLoop &loop;
+
+            [[nodiscard]] bool await_ready() const noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                loop.post(handle);
+            }
+
+            void await_resume() const noexcept {}
+        };
+        return awaiter{*this};
+    }
+
+    io_awaitable readable(socket_t fd, long timeout);
+
+    io_awaitable writable(socket_t fd, long timeout);
+
+    any_awaitable writable_any(std::vector<socket_t> fds, long timeout);
+
+    // co_await run_blocking(f) calls f on a helper thread and resumes with
+    // its result on the loop thread; what f throws is rethrown there. For what
+    // would block the loop: database queries, long service routes, lookups
+    // missing the caches. f sees the shard of the loop
+    template<typename Callable>
+    auto run_blocking(Callable callable) {
+        using result_t = std::invoke_result_t<Callable &>;
+        static_assert(!std::is_void_v<result_t>, "run_blocking needs a result");
+
+        struct awaiter {
+            EventLoop               &loop;
+            Callable                callable;
+            std::optional<result_t> result;
+            std::exception_ptr      error;
+
+            [[nodiscard]] bool await_ready() const noexcept {
+                return false;
+            }
+
+            void await_suspend(std::coroutine_handle<> handle) {
+                loop._blocking.add([this, handle, shard = get_current_shard()] {
+                    set_current_shard(shard);
+                    // The coroutine is resumed whatever happens, or it would
+                    // hold its connection forever
+                    try {
+                        result.emplace(callable());
+                    } catch (...) {
+                        error = std::current_exception();
+                    }
+                    loop.post(handle);
+                });
+            }
+
+            result_t await_resume() {
+                if (error) {
+                    std::rethrow_exception(error);
+                }
+                return std::move(*result);
+            }
+        };
+        return awaiter{*this, std::move(callable), std::nullopt, nullptr};
+    }
+
+  private:
+    struct deadline_t {
+        clock::time_point   deadline;
+        uint64_t            id;
+
+        bool operator>(const deadline_t &other) const {
+            return deadline > other.deadline;
+        }
+    };
+
+    // A wait for any of `count` fds, registered under the ids first..first + count - 1
+    struct wait_t {
+        std::coroutine_handle<>     handle;
+        const socket_t              *fds;
+        size_t                      count;
+        uint64_t                    first;
+        int                         *result;
+    };
+
+    // Registers a wait for the next epoll_wait, false with wait_failed when
+    // it can't. The fds stay in the epoll set only while waited on, so a
+    // closed socket leaves nothing behind
+    bool _wait(std::coroutine_handle<> handle, const socket_t *fds, size_t count,
+               uint32_t events, long timeout, int *result);
+
+    // Ends `wait` with `result`, the index of the ready fd, -1 or wait_failed
+    void _finish(wait_t wait, int result);
+
+    // Called once the loop thread is gone: ends every wait with wait_failed
+    // until no coroutine is left waiting, on the calling thread
+    void _cancel_all();
+
+    void _resume_posted();
+
+    void _expire_timers();
+
+    int _wait_timeout() const;
+
+    int                                 _epoll;
+    int                                 _wake;      // eventfd, wakes epoll_wait for posted coroutines
+    std::atomic<bool>                   _running;
+    bool                                _cancelled;
+    std::thread                         _thread;
+
+    std::mutex                              _posted_mutex;
+    std::vector<std::coroutine_handle<>>    _posted;
+
+    // Waits by id: an epoll event or timer whose wait is already over finds
+    // nothing, its awaitable may be gone with the coroutine frame
+    uint64_t                                                        _next_id;
+    std::unordered_map<uint64_t, wait_t>                            _waiting;
+    std::priority_queue<deadline_t, std::vector<deadline_t>, std::greater<>> _timers;
+
+    prll::Parallel                      _blocking;
+};
+
+}
@@ -1,3 +1,5 @@
+#pragma once
+
 #include <atomic>
 #include <mutex>
 #include <thread>
@@ -9,6 +11,20 @@
 namespace prll {
 #define MAXNTHREADS (size_t)50
 
+// Where the workers of a pool run. A worker is pinned before it takes its
+// first task, so what it allocates first (its caches and pooled buffers) is
+// placed on its NUMA node by the first touch
+struct placement_t {
+    std::vector<int> cpus;          // CPUs the workers run on, none for no pinning
+    bool             per_worker = false; // worker i gets only cpus[i % size]
+
+    // Every CPU of a NUMA node, `per_worker` spreads the workers over them
+    static placement_t numa_node(int node, bool per_worker = true);
+};
+
+// Pins the calling thread to `cpus`, or lets it run anywhere when empty
+void pin_current_thread(const std::vector<int> &cpus);
+
 class Parallel {
   public:
     Parallel();
@@ -43,8 +59,20 @@ class Parallel {
 
     void set_max_threads(size_t max_threads);
 
+    // Workers kept even without tasks, so that many tasks start at once
+    void set_min_threads(size_t min_threads);
+
+    // Applies to the workers, present and future; an empty placement lifts
+    // the pinning. Ignored where threads can't be pinned
+    void set_placement(placement_t placement);
+
+    [[nodiscard]] placement_t get_placement();
+
     [[nodiscard]] size_t get_count_threads() const;
 
+    // Workers running now, between the min and max thread limits
+    [[nodiscard]] size_t get_worker_count();
+
     ~Parallel();
 
   private:
@@ -55,7 +83,8 @@ class Parallel {
 
         Thread(std::mutex &thread_mutex,
                std::queue<std::function<void()>> &task,
-               std::condition_variable &threads);
+               std::condition_variable &threads,
+               std::vector<int> cpus = {});
 
         Thread(Thread &&) noexcept = delete;
 
@@ -65,6 +94,15 @@ class Parallel {
 
         void force_join();
 
+        void set_affinity(const std::vector<int> &cpus);
+
+        // Makes the worker exit before it takes another task
+        void retire();
+
+        [[nodiscard]] bool is_idle() const;
+
+        [[nodiscard]] bool is_done() const;
+
         ~Thread();
 
       private:
@@ -76,13 +114,19 @@ class Parallel {
         std::queue<std::function<void(void)>> &_tasks;
 
         bool _end;
+        bool _retire;
+        std::vector<int> _cpus;
         std::thread _main_thread;
         std::condition_variable _wait;
         std::atomic<long> _have_proccess;
+        std::atomic<bool> _done;
     };
 
     void _balance();
 
+    // CPUs of the worker with index `worker`
+    std::vector<int> _worker_cpus(size_t worker) const;
+
     std::mutex _task_mutex;
     std::condition_variable _in_thread;
     std::queue<std::function<void(void)>> _tasks;
@@ -90,9 +134,13 @@ class Parallel {
     std::mutex _main_mutex;
     std::condition_variable _in_balance;
     std::vector<std::unique_ptr<Thread>> _threads;
+    // Retired workers finishing their last task, joined once done
+    std::vector<std::unique_ptr<Thread>> _retired;
+    placement_t _placement;
     std::thread _main_thread;
 
-    bool _exit;
+    std::atomic<bool> _exit;
+    size_t _min_threads;
     size_t _max_threads;
 };
 }
\ No newline at end of file
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+
+namespace bstcp {
+
+namespace detail {
+inline size_t &current_shard() {
+    thread_local size_t shard = 0;
+    return shard;
+}
+}
+
+// Index of the server shard the calling thread works for, 0 outside of
+// a ShardedTcpServer. State kept per shard is looked up by it
+inline size_t get_current_shard() {
+    return detail::current_shard();
+}
+
+inline void set_current_shard(size_t shard) {
+    detail::current_shard() = shard;
+}
+
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "tcp_server.hpp"
+
+namespace bstcp {
+
+// Shard-per-core server: `shard_count` independent TcpServers on one port,
+// each with its own SO_REUSEPORT listener, client table and thread pool pinned
+// to one CPU. The kernel spreads connections over the listeners, so nothing
+// is shared between shards on the way of a request; per-shard state of the
+// handlers is found by get_current_shard().
+//
+// Shard i runs on cpus[i], all online CPUs in order by default. A pinned
+// shard's listener asks for the connections received on its CPU, so with NIC
+// queue interrupts (or RPS) spread over the same CPUs a connection is handled
+// where its packets arrive.
+SOCKET_TEMPLATE
+class ShardedTcpServer {
+  public:
+    using Server = TcpServer<Socket, T>;
+    using ServerStatus = typename Server::ServerStatus;
+    using _con_handler_function_t = typename Server::_con_handler_function_t;
+
+    explicit ShardedTcpServer(uint16_t port,
+                              size_t shard_count,
+                              KeepAliveConfig ka_conf = {},
+                              _con_handler_function_t connect_hndl = Server::_default_connsection_handler,
+                              _con_handler_function_t disconnect_hndl = Server::_default_connsection_handler,
+                              size_t threads_per_shard = 2,
+                              bool pin_to_cpus = true,
+                              std::vector<int> cpus = {}
+    );
+
+    ShardedTcpServer(const ShardedTcpServer&) = delete;
+    ShardedTcpServer& operator=(const ShardedTcpServer&) = delete;
+
+    [[nodiscard]] uint16_t get_port() const;
+
+    [[nodiscard]] size_t get_shard_count() const;
+
+    Server &get_shard(size_t index);
+
+    // Status of the first shard that failed, up if all are
+    [[nodiscard]] ServerStatus get_status() const;
+
+    // Applies TcpServer::set_coroutine_mode() to every shard, each gets its own loop
+    void set_coroutine_mode(bool enable);
+
+    // Starts every shard; if one fails the started ones are stopped
+    ServerStatus start();
+
+    void stop();
+
+    void joinLoop();
+
+  private:
+    uint16_t                                _port;
+    std::vector<std::unique_ptr<Server>>    _shards;
+};
+
+}
+
+#include "sharded_tcp_server.inl"
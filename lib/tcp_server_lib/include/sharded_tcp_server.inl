@@ -0,0 +1,92 @@
+#include <algorithm>
+
+#include "cpu_topology.hpp"
+
+using namespace bstcp;
+
+SOCKET_TEMPLATE
+ShardedTcpServer<Socket, T>::ShardedTcpServer(uint16_t port,
+                                              size_t shard_count,
+                                              KeepAliveConfig ka_conf,
+                                              _con_handler_function_t connect_hndl,
+                                              _con_handler_function_t disconnect_hndl,
+                                              size_t threads_per_shard,
+                                              bool pin_to_cpus,
+                                              std::vector<int> cpus
+)
+        : _port(port)
+          , _shards() {
+    if (cpus.empty()) {
+        cpus = prll::CpuTopology::get().get_cpus();
+    }
+    shard_count = std::max(shard_count, (size_t) 1);
+    for (size_t i = 0; i < shard_count; ++i) {
+        int cpu = cpus[i % cpus.size()];
+        prll::placement_t placement;
+        if (pin_to_cpus) {
+            placement.cpus = {cpu};
+        }
+        auto &shard = _shards.emplace_back(std::make_unique<Server>(port, ka_conf, connect_hndl, disconnect_hndl,
+                                                                    threads_per_shard, std::move(placement)));
+        shard->set_shard(i, pin_to_cpus ? cpu : -1);
+    }
+}
+
+SOCKET_TEMPLATE
+uint16_t ShardedTcpServer<Socket, T>::get_port() const {
+    return _port;
+}
+
+SOCKET_TEMPLATE
+size_t ShardedTcpServer<Socket, T>::get_shard_count() const {
+    return _shards.size();
+}
+
+SOCKET_TEMPLATE
+typename ShardedTcpServer<Socket, T>::Server &ShardedTcpServer<Socket, T>::get_shard(size_t index) {
+    return *_shards[index];
+}
+
+SOCKET_TEMPLATE
+typename ShardedTcpServer<Socket, T>::ServerStatus ShardedTcpServer<Socket, T>::get_status() const {
+    for (auto &shard: _shards) {
+        if (shard->get_status() != ServerStatus::up) {
+            return shard->get_status();
+        }
+    }
+    return ServerStatus::up;
+}
+
+SOCKET_TEMPLATE
+void ShardedTcpServer<Socket, T>::set_coroutine_mode(bool enable) {
+    for (auto &shard: _shards) {
+        shard->set_coroutine_mode(enable);
+    }
+}
+
+SOCKET_TEMPLATE
+typename ShardedTcpServer<Socket, T>::ServerStatus ShardedTcpServer<Socket, T>::start() {
+    for (auto &shard: _shards) {
+        if (auto status = shard->start(); status != ServerStatus::up) {
+            stop();
+            return status;
+        }
+    }
+    return ServerStatus::up;
+}
+
+SOCKET_TEMPLATE
+void ShardedTcpServer<Socket, T>::stop() {
+    for (auto &shard: _shards) {
+        if (shard->get_status() == ServerStatus::up) {
+            shard->stop();
+        }
+    }
+}
+
+SOCKET_TEMPLATE
+void ShardedTcpServer<Socket, T>::joinLoop() {
+    for (auto &shard: _shards) {
+        shard->joinLoop();
+    }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+namespace bstcp {
+
+template<typename T>
+class Task;
+
+namespace detail {
+
+struct task_promise_base {
+    std::coroutine_handle<> continuation = std::noop_coroutine();
+    std::exception_ptr      error;
+
+    // Resumes the awaiting coroutine in place of returning, so a chain of
+    // tasks finishing one after another doesn't grow the stack
+    struct final_awaiter {
+        [[nodiscard]] bool await_ready() const noexcept {
+            return false;
+        }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            return handle.promise().continuation;
+        }
+
+        void await_resume() const noexcept {}
+    };
+
+    std::suspend_always initial_suspend() const noexcept {
+        return {};
+    }
+
+    final_awaiter final_suspend() const noexcept {
+        return {};
+    }
+
+    void unhandled_exception() {
+        error = std::current_exception();
+    }
+};
+
+template<typename T>
+struct task_promise : task_promise_base {
+    std::optional<T> value;
+
+    Task<T> get_return_object();
+
+    template<typename U>
+    void return_value(U &&result) {
+        value.emplace(std::forward<U>(result));
+    }
+
+    T result() {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return std::move(*value);
+    }
+};
+
+template<>
+struct task_promise<void> : task_promise_base {
+    Task<void> get_return_object();
+
+    void return_void() const noexcept {}
+
+    void result() const {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+};
+
+struct detached_t {
+    struct promise_type {
+        detached_t get_return_object() const noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() const noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() const noexcept {
+            return {};
+        }
+
+        void return_void() const noexcept {}
+
+        void unhandled_exception() const noexcept {
+            std::terminate();
+        }
+    };
+};
+
+}
+
+// Coroutine started when it is awaited; the awaiting coroutine is resumed
+// with the result once it is done. An exception is passed on to the awaiting
+// one. Owns the coroutine frame
+template<typename T = void>
+class Task {
+  public:
+    using promise_type = detail::task_promise<T>;
+
+    explicit Task(std::coroutine_handle<promise_type> handle)
+            : _handle(handle) {}
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+
+    Task(Task &&task) noexcept
+            : _handle(std::exchange(task._handle, nullptr)) {}
+
+    Task &operator=(Task &&task) noexcept {
+        if (this != &task) {
+            if (_handle) {
+                _handle.destroy();
+            }
+            _handle = std::exchange(task._handle, nullptr);
+        }
+        return *this;
+    }
+
+    ~Task() {
+        if (_handle) {
+            _handle.destroy();
+        }
+    }
+
+    auto operator co_await() const noexcept {
+        struct awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            [[nodiscard]] bool await_ready() const noexcept {
+                return !handle || handle.done();
+            }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+
+            T await_resume() {
+                return handle.promise().result();
+            }
+        };
+        return awaiter{_handle};
+    }
+
+  private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
+template<typename T>
+Task<T> detail::task_promise<T>::get_return_object() {
+    return Task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));
+}
+
+inline Task<void> detail::task_promise<void>::get_return_object() {
+    return Task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));
+}
+
+// Runs `task` with nobody awaiting it, the frames are freed at its end. An
+// exception escaping it terminates the program
+inline detail::detached_t start_detached(Task<void> task) {
+    co_await task;
+}
+
+}
@@ -32,6 +32,19 @@ class BaseSocket : public ISocket {
 
     status accept(const BaseSocket& server_socket);
 
+    // Starts connecting a new non-blocking client socket. When the connect
+    // can't finish at once `in_progress` is set, the socket becomes writable
+    // once it is done and finish_connect() tells the outcome
+    status start_connect(uint32_t host, uint16_t port, bool &in_progress);
+
+    // start_connect() for an address of either family; get_host() and
+    // get_address() are only filled in for IPv4
+    status start_connect(const endpoint_t &endpoint, bool &in_progress);
+
+    status finish_connect();
+
+    bool set_blocking(bool blocking);
+
     ~BaseSocket() override;
 
     [[nodiscard]] uint32_t get_host() const override;
@@ -44,8 +57,14 @@ class BaseSocket : public ISocket {
 
     bool recv_from(void *buffer, int size) override;
 
+    int recv_some(void *buffer, int size) override;
+
     bool send_to(const void *buffer, int size) const override;
 
+    // Sends what fits, up to `size` bytes. Returns the number of bytes sent or
+    // -1 on error; errno is EAGAIN when a non-blocking socket is full
+    virtual int send_some(const void *buffer, int size);
+
     [[nodiscard]] SocketType get_type() const override;
 
     socket_t get_socket();
@@ -54,6 +73,10 @@ class BaseSocket : public ISocket {
 
     [[nodiscard]] bool is_allow_to_read(long timeout) const override;
 
+    // Bytes received and held by the socket itself, readable without the fd
+    // becoming readable again
+    [[nodiscard]] virtual int get_pending() const;
+
     [[nodiscard]] bool is_allow_to_write(long timeout) const override;
 
     [[nodiscard]] bool is_allow_to_rwrite(long timeout) const override;
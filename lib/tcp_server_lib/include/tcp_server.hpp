@@ -1,7 +1,6 @@
 #pragma once
 
 #include <functional>
-#include <list>
 
 #include <thread>
 #include <mutex>
@@ -27,7 +26,12 @@
 #endif
 
 #include "tcp_base_socket.hpp"
+#include "client_table.hpp"
+#include "block_pool.hpp"
+#include "shard.hpp"
 #include "parallel.hpp"
+#include "event_loop.hpp"
+#include "task.hpp"
 
 namespace bstcp {
 
@@ -77,6 +81,12 @@ using server_client = std::conjunction<std::is_constructible<T, Socket&&>,
                         typename = std::enable_if_t<server_client<T, Socket>::value>>
 #endif
 
+// A client that can also be served by a coroutine on the event loop of the server
+template<typename T>
+concept async_server_client = requires(T client, EventLoop &loop) {
+    { client.handle_request_async(loop) } -> std::same_as<Task<void>>;
+};
+
 
 SOCKET_TEMPLATE
 class TcpServer {
@@ -87,7 +97,8 @@ public:
 
         explicit Client(Socket&& socket)
                 : T(std::move(socket))
-                , _in_use(false) {}
+                , _in_use(false)
+                , _senders(0) {}
 
         Client(const Client&) = delete;
         Client operator=(const Client&) = delete;
@@ -95,17 +106,33 @@ public:
         Client(Client&& clt) noexcept
                 : T(std::move(clt))
                 , _in_use(false)
-                , _access_mtx() {}
+                , _senders(0) {}
 
         Client& operator=(const Client&&) = delete;
 
         ~Client() override = default;
 
+        // Clients are recycled through a per-thread pool instead of the heap
+        static void *operator new(size_t) {
+            return ObjectPool<Client>::allocate();
+        }
+
+        static void operator delete(void *pointer) {
+            ObjectPool<Client>::deallocate(pointer);
+        }
+
+        [[nodiscard]] static pool_stats_t get_pool_stats() {
+            return ObjectPool<Client>::get_stats();
+        }
+
     private:
         friend class TcpServer;
 
-        bool        _in_use;
-        std::mutex  _access_mtx;
+        std::atomic<bool>   _in_use;
+        std::mutex          _access_mtx;
+        // send_to() calls using the client outside the table lock, it isn't
+        // removed while there are any
+        std::atomic<int>    _senders;
     };
 
     enum class ServerStatus : uint8_t {
@@ -126,7 +153,8 @@ public:
                        KeepAliveConfig ka_conf = {},
                        _con_handler_function_t connect_hndl = _default_connsection_handler,
                        _con_handler_function_t disconnect_hndl = _default_connsection_handler,
-                       size_t thread_count = std::thread::hardware_concurrency()
+                       size_t thread_count = std::thread::hardware_concurrency(),
+                       prll::placement_t placement = {} // CPUs of the pool threads
     );
 
     ~TcpServer();
@@ -140,6 +168,18 @@ public:
 
     [[nodiscard]] ServerStatus get_status() const;
 
+    // Makes the server shard `index` of a group listening on one port: the
+    // listener is opened with SO_REUSEPORT and the pool threads see `index`
+    // as get_current_shard(). With `cpu` the listener also sets
+    // SO_INCOMING_CPU, so the kernel prefers it for connections whose packets
+    // are received on that CPU (by the RSS queue or RPS). Applied by the next start()
+    void set_shard(size_t index, int cpu = -1);
+
+    // Serves the clients with handle_request_async() on one event loop thread
+    // instead of handle_request() on the pool, so a waiting request holds no
+    // thread. The pool keeps accepting. Applied by the next start()
+    void set_coroutine_mode(bool enable);
+
     // Server status manip
     ServerStatus start();
 
@@ -151,6 +191,8 @@ public:
     bool connect_to(uint32_t host, uint16_t port,
                    const _con_handler_function_t& connect_hndl);
 
+    // Sends block on slow peers, so they are made after the client table is
+    // unlocked and don't hold back connecting and removing clients
     void send_to(const void *buffer, int size);
 
     bool send_to_by(uint32_t host, uint16_t port, const void *buffer, size_t size);
@@ -162,21 +204,35 @@ public:
   private:
     Socket          _serv_socket;
     uint16_t        _port;
-    std::mutex      _client_mutex;
     ServerStatus    _status  = ServerStatus::close;
+    size_t          _shard   = 0;
+    int             _shard_cpu = -1;
+    uint16_t        _listen_type = (uint16_t) SocketType::nonblocking_socket
+                                   | (uint16_t) SocketType::server_socket;
     prll::Parallel  _thread_pool;
     KeepAliveConfig _ka_conf;
 
+    bool                        _coroutine_mode = false;
+    std::unique_ptr<EventLoop>  _loop;
+
     _con_handler_function_t _connect_hndl       = _default_connsection_handler;
     _con_handler_function_t _disconnect_hndl    = _default_connsection_handler;
 
-    std::list<std::unique_ptr<Client>> _client_list;
+    ClientTable<Client> _clients;
 
     bool _enable_keep_alive(socket_t socket);
 
     void _handling_accept_loop();
 
     void _waiting_recv_loop();
+
+    Task<void> _serve_async(Client &client);
+
+    // Called under the table lock, adds `client` to `pinned` unless it or
+    // the server is closed
+    void _pin(Client &client, std::vector<Client *> &pinned);
+
+    static void _send_pinned(const std::vector<Client *> &pinned, const void *buffer, int size);
 };
 
 
@@ -1,7 +1,9 @@
 #include <chrono>
 #include <cstring>
 #include <mutex>
+#include <thread>
 #include <utility>
+#include <vector>
 
 using namespace bstcp;
 
@@ -10,7 +12,8 @@ TcpServer<Socket, T>::TcpServer(uint16_t port,
                                 KeepAliveConfig ka_conf,
                                 _con_handler_function_t connect_hndl,
                                 _con_handler_function_t disconnect_hndl,
-                                size_t thread_count
+                                size_t thread_count,
+                                prll::placement_t placement
 )
         : _port(port)
           , _thread_pool()
@@ -18,6 +21,9 @@ TcpServer<Socket, T>::TcpServer(uint16_t port,
           , _connect_hndl(std::move(connect_hndl))
           , _disconnect_hndl(std::move(disconnect_hndl)) {
     _thread_pool.set_max_threads(thread_count);
+    if (!placement.cpus.empty()) {
+        _thread_pool.set_placement(std::move(placement));
+    }
 }
 
 SOCKET_TEMPLATE
@@ -46,9 +52,7 @@ TcpServer<Socket, T>::start() {
         stop();
     }
 
-    auto sts = _serv_socket.init(localhost, _port,
-                                 (uint16_t) SocketType::nonblocking_socket
-                                 | (uint16_t) SocketType::server_socket);
+    auto sts = _serv_socket.init(localhost, _port, _listen_type);
     switch (sts) {
         case SocketStatus::connected:
             break;
@@ -68,6 +72,22 @@ TcpServer<Socket, T>::start() {
             return _status = ServerStatus::close;
     }
 
+#ifdef SO_INCOMING_CPU
+    if (_shard_cpu >= 0) {
+        setsockopt(_serv_socket.get_socket(), SOL_SOCKET, SO_INCOMING_CPU, &_shard_cpu, sizeof(_shard_cpu));
+    }
+#endif
+
+    if (_coroutine_mode) {
+        _loop = std::make_unique<EventLoop>();
+        _loop->start([shard = _shard, placement = _thread_pool.get_placement()] {
+            set_current_shard(shard);
+            if (!placement.cpus.empty()) {
+                prll::pin_current_thread(placement.cpus);
+            }
+        });
+    }
+
     _status = ServerStatus::up;
     _thread_pool.add([this] { _handling_accept_loop(); });
     _thread_pool.add([this] { _waiting_recv_loop(); });
@@ -75,6 +95,19 @@ TcpServer<Socket, T>::start() {
     return _status;
 }
 
+SOCKET_TEMPLATE
+void TcpServer<Socket, T>::set_shard(size_t index, int cpu) {
+    _shard = index;
+    _shard_cpu = cpu;
+    _listen_type |= (uint16_t) SocketType::reuse_port;
+}
+
+SOCKET_TEMPLATE
+void TcpServer<Socket, T>::set_coroutine_mode(bool enable) {
+    static_assert(async_server_client<T>, "coroutine mode needs T::handle_request_async(EventLoop&)");
+    _coroutine_mode = enable;
+}
+
 SOCKET_TEMPLATE
 void TcpServer<Socket, T>::stop() {
     _thread_pool.wait();
@@ -82,7 +115,17 @@ void TcpServer<Socket, T>::stop() {
 
     _serv_socket.disconnect();
 
-    _client_list.clear();
+    // Sends started before the close still use their clients
+    _clients.for_each([](client_handle_t, Client &client) {
+        while (client._senders > 0) {
+            std::this_thread::yield();
+        }
+    });
+
+    // Ends the coroutines left waiting while the clients they serve still exist
+    _loop.reset();
+
+    _clients.clear();
 }
 
 SOCKET_TEMPLATE
@@ -108,56 +151,49 @@ bool TcpServer<Socket, T>::connect_to(uint32_t host, uint16_t port,
     }
 
     std::unique_ptr<Client> client(new Client(std::move(client_socket)));
-    connect_hndl(client);
-    _client_mutex.lock();
-    _client_list.emplace_back(std::move(client));
-    _client_mutex.unlock();
+    connect_hndl(reinterpret_cast<std::unique_ptr<ISocket> &>(client));
+    _clients.insert(std::move(client));
     return true;
 }
 
 SOCKET_TEMPLATE
 void TcpServer<Socket, T>::send_to(const void *buffer, int size) {
-    for (std::unique_ptr<Client> &client: _client_list) {
-        client->send_to(buffer, size);
-    }
+    std::vector<Client *> pinned;
+    _clients.for_each([this, &pinned](client_handle_t, Client &client) {
+        _pin(client, pinned);
+    });
+    _send_pinned(pinned, buffer, size);
 }
 
 SOCKET_TEMPLATE
 bool TcpServer<Socket, T>::send_to_by(uint32_t host, uint16_t port,
                                       const void *buffer,
                                       const size_t size) {
-    bool data_is_sended = false;
-
-    for (std::unique_ptr<Client> &client: _client_list)
-        if (client->get_host() == host &&
-            client->get_port() == port) {
-            client->send_to(buffer, size);
-            data_is_sended = true;
-        }
-
-    return data_is_sended;
+    std::vector<Client *> pinned;
+    bool found = _clients.for_each_by(host, port, [this, &pinned](Client &client) {
+        _pin(client, pinned);
+    });
+    _send_pinned(pinned, buffer, (int) size);
+    return found;
 }
 
 SOCKET_TEMPLATE
 bool TcpServer<Socket, T>::disconnect_by(uint32_t host, uint16_t port) {
-    bool client_is_disconnected = false;
-    for (std::unique_ptr<Client> &client: _client_list)
-        if (client->get_host() == host &&
-            client->get_port() == port) {
-            client->disconnect();
-            client_is_disconnected = true;
-        }
-    return client_is_disconnected;
+    return _clients.for_each_by(host, port, [](Client &client) {
+        client.disconnect();
+    });
 }
 
 SOCKET_TEMPLATE
 void TcpServer<Socket, T>::disconnect_all() {
-    for (std::unique_ptr<Client> &client: _client_list)
-        client->disconnect();
+    _clients.for_each([](client_handle_t, Client &client) {
+        client.disconnect();
+    });
 }
 
 SOCKET_TEMPLATE
 void TcpServer<Socket, T>::_handling_accept_loop() {
+    set_current_shard(_shard);
     Socket client_socket;
     if (client_socket.accept(_serv_socket) == status::connected
         && _status == ServerStatus::up) {
@@ -167,9 +203,7 @@ void TcpServer<Socket, T>::_handling_accept_loop() {
             std::unique_ptr<Client> client(
                     new Client(std::move(client_socket)));
             _connect_hndl(reinterpret_cast<std::unique_ptr<ISocket> &>(client));
-            _client_mutex.lock();
-            _client_list.emplace_back(std::move(client));
-            _client_mutex.unlock();
+            _clients.insert(std::move(client));
         }
     }
 
@@ -180,37 +214,47 @@ void TcpServer<Socket, T>::_handling_accept_loop() {
 
 SOCKET_TEMPLATE
 void TcpServer<Socket, T>::_waiting_recv_loop() {
-    {
-        std::lock_guard lock(_client_mutex);
-        for (auto it = _client_list.begin(); it != _client_list.end(); it++) {
-            auto &client = *it;
-            if (client) {
-                if (!client->_in_use) {
-                    client->_in_use = true;
-                    if (client->get_status() == SocketStatus::disconnected) {
-                        client->_access_mtx.lock();
-                        Client *pointer = client.release();
-                        client = nullptr;
-                        _disconnect_hndl(
-                                reinterpret_cast<std::unique_ptr<ISocket> &>(pointer));
-                        _client_list.erase(it);
-                        pointer->_access_mtx.unlock();
-                        delete pointer;
-                        break;
-                    } else {
-                        _thread_pool.add(
-                                [this, &client] {
-                                    client->_access_mtx.lock();
-                                    if (client->get_status() !=
-                                        SocketStatus::disconnected) {
-                                        client->handle_request();
-                                    }
-                                    client->_in_use = false;
-                                    client->_access_mtx.unlock();
-                                });
-                    }
-                }
+    // A client is only taken by one task at a time; the ones found closed
+    // are removed after the walk, none of their tasks can still be running
+    std::vector<client_handle_t> closed;
+    _clients.for_each([this, &closed](client_handle_t handle, Client &client) {
+        if (client._in_use.exchange(true)) {
+            return;
+        }
+        if (client.get_status() == SocketStatus::disconnected) {
+            if (client._senders > 0) {
+                // Removed on a later pass, once the sends to it are over
+                client._in_use = false;
+            } else {
+                closed.push_back(handle);
             }
+            return;
+        }
+        if constexpr (async_server_client<T>) {
+            if (_loop) {
+                _loop->spawn(_serve_async(client));
+                return;
+            }
+        }
+        _thread_pool.add(
+                [pointer = &client, shard = _shard] {
+                    set_current_shard(shard);
+                    pointer->_access_mtx.lock();
+                    if (pointer->get_status() !=
+                        SocketStatus::disconnected) {
+                        pointer->handle_request();
+                    }
+                    pointer->_in_use = false;
+                    pointer->_access_mtx.unlock();
+                });
+    });
+
+    for (auto handle : closed) {
+        auto client = _clients.remove(handle);
+        if (client) {
+            client->_access_mtx.lock();
+            _disconnect_hndl(reinterpret_cast<std::unique_ptr<ISocket> &>(client));
+            client->_access_mtx.unlock();
         }
     }
 
@@ -219,6 +263,37 @@ void TcpServer<Socket, T>::_waiting_recv_loop() {
     }
 }
 
+SOCKET_TEMPLATE
+Task<void> TcpServer<Socket, T>::_serve_async(Client &client) {
+    // The client stays in use until the coroutine ends, it is removed only after
+    try {
+        co_await client.handle_request_async(*_loop);
+    } catch (const std::exception &) {
+        client.disconnect();
+    }
+    client._in_use = false;
+}
+
+SOCKET_TEMPLATE
+void TcpServer<Socket, T>::_pin(Client &client, std::vector<Client *> &pinned) {
+    // Pinned before the checks: the recv loop and stop() look at the
+    // status first, then wait for the pins
+    client._senders++;
+    if (_status != ServerStatus::up || client.get_status() == SocketStatus::disconnected) {
+        client._senders--;
+        return;
+    }
+    pinned.push_back(&client);
+}
+
+SOCKET_TEMPLATE
+void TcpServer<Socket, T>::_send_pinned(const std::vector<Client *> &pinned, const void *buffer, int size) {
+    for (auto client: pinned) {
+        client->send_to(buffer, size);
+        client->_senders--;
+    }
+}
+
 SOCKET_TEMPLATE
 bool TcpServer<Socket, T>::_enable_keep_alive(socket_t socket) {
     int flag = 1;
@@ -66,6 +66,7 @@ enum class SocketType : uint16_t {
     server_socket       = 2,
     blocking_socket     = 4,
     nonblocking_socket  = 8,
+    reuse_port          = 16,   // server only, lets several listeners share the port
 };
 
 enum class SocketStatus : uint8_t {
@@ -78,8 +79,20 @@ enum class SocketStatus : uint8_t {
     err_socket_listening    = 6,
 };
 
+// First IPv4 address of `hostname`, -1 when it has none
 int hostname_to_ip(const char *hostname, socket_addr_in *addr);
 
+// Address of either family
+struct endpoint_t {
+    sockaddr_storage    address;
+    sock_len_t          length;
+};
+
+// Every address of `hostname`, in the order to try them (RFC 8305): the
+// families alternate, starting with the one getaddrinfo puts first. Ports
+// are left unset. -1 when it can't be resolved
+int resolve_host(const char *hostname, std::vector<endpoint_t> *endpoints);
+
 class ThreadPool {
     std::vector<std::thread> thread_pool;
     std::queue<std::function<void()>> job_queue;
@@ -173,6 +186,10 @@ class IReceivable {
     virtual ~IReceivable() = default;
 
     virtual bool recv_from(void *buffer, int size) = 0;
+
+    // Reads what is available, up to `size` bytes. Returns the number of bytes
+    // read, 0 if the peer closed the connection and -1 on error
+    virtual int recv_some(void *buffer, int size) = 0;
 };
 
 class ISendable {
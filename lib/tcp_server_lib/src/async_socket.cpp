@@ -0,0 +1,74 @@
+#include "async_socket.hpp"
+
+#include <cerrno>
+
+namespace bstcp {
+
+static bool would_block() {
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+Task<bool> AsyncSocket::readable(long timeout) {
+    if (_socket.get_pending() > 0) {
+        co_return true;
+    }
+    co_return co_await _loop.readable(_socket.get_socket(), timeout);
+}
+
+Task<int> AsyncSocket::read(void *buffer, int size, long timeout) {
+    while (true) {
+        errno = 0;
+        int got = _socket.recv_some(buffer, size);
+        if (got >= 0) {
+            co_return got;
+        }
+        if (!would_block() || !co_await _loop.readable(_socket.get_socket(), timeout)) {
+            co_return -1;
+        }
+    }
+}
+
+Task<bool> AsyncSocket::write(const void *buffer, int size, long timeout) {
+    auto data = reinterpret_cast<const char *>(buffer);
+    while (size > 0) {
+        errno = 0;
+        int sent = _socket.send_some(data, size);
+        if (sent > 0) {
+            data += sent;
+            size -= sent;
+            continue;
+        }
+        if (!would_block() || !co_await _loop.writable(_socket.get_socket(), timeout)) {
+            co_return false;
+        }
+    }
+    co_return true;
+}
+
+Task<status> AsyncSocket::connect(uint32_t host, uint16_t port, long timeout) {
+    bool in_progress;
+    auto sts = _socket.start_connect(host, port, in_progress);
+    if (!in_progress) {
+        co_return sts;
+    }
+    if (!co_await _loop.writable(_socket.get_socket(), timeout)) {
+        _socket.disconnect();
+        co_return status::err_socket_connect;
+    }
+    co_return _socket.finish_connect();
+}
+
+Task<status> AsyncSocket::connect(ConnectRace &race) {
+    while (!race.advance()) {
+        int ready = co_await _loop.writable_any(race.get_waiting(), race.get_wait_time());
+        if (ready == EventLoop::wait_failed) {
+            co_return status::err_socket_connect;
+        }
+        if (ready >= 0) {
+            race.on_ready(ready);
+        }
+    }
+    co_return race.finish(_socket);
+}
+
+}
@@ -0,0 +1,33 @@
+#include "buffer_pool.hpp"
+
+#include <utility>
+
+using namespace bstcp;
+
+using io_pool = BlockPool<io_buffer_size>;
+
+IOBuffer::IOBuffer()
+        : _data(static_cast<char *>(io_pool::allocate())) {}
+
+IOBuffer::IOBuffer(IOBuffer &&buffer) noexcept
+        : _data(std::exchange(buffer._data, nullptr)) {}
+
+IOBuffer &IOBuffer::operator=(IOBuffer &&buffer) noexcept {
+    if (this != &buffer) {
+        if (_data) {
+            io_pool::deallocate(_data);
+        }
+        _data = std::exchange(buffer._data, nullptr);
+    }
+    return *this;
+}
+
+IOBuffer::~IOBuffer() {
+    if (_data) {
+        io_pool::deallocate(_data);
+    }
+}
+
+pool_stats_t BufferPool::get_stats() {
+    return io_pool::get_stats();
+}
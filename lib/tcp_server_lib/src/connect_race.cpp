@@ -0,0 +1,157 @@
+#include "connect_race.hpp"
+
+#include <algorithm>
+
+#ifndef _WIN32
+#include <poll.h>
+#endif
+
+namespace bstcp {
+
+static void set_port(endpoint_t &endpoint, uint16_t port) {
+    if (endpoint.address.ss_family == AF_INET6) {
+        reinterpret_cast<sockaddr_in6 &>(endpoint.address).sin6_port = htons(port);
+    } else {
+        reinterpret_cast<socket_addr_in &>(endpoint.address).sin_port = htons(port);
+    }
+}
+
+ConnectRace::ConnectRace(std::vector<endpoint_t> endpoints, uint16_t port, connect_config_t config)
+        : _endpoints(std::move(endpoints))
+          , _config(config)
+          , _next(0)
+          , _next_start(clock::now())
+          , _pending()
+          , _won(false)
+          , _winner()
+          , _attempts(0)
+          , _failed(0) {
+    for (auto &endpoint: _endpoints) {
+        set_port(endpoint, port);
+    }
+}
+
+bool ConnectRace::advance() {
+    auto now = clock::now();
+    for (size_t i = 0; i < _pending.size();) {
+        if (_pending[i].deadline <= now) {
+            _fail(i, now);
+        } else {
+            ++i;
+        }
+    }
+
+    while (!_won && _next < _endpoints.size() && (_pending.empty() || _next_start <= now)) {
+        _start(_endpoints[_next++], now);
+    }
+    return _won || (_pending.empty() && _next == _endpoints.size());
+}
+
+std::vector<socket_t> ConnectRace::get_waiting() {
+    std::vector<socket_t> res;
+    for (auto &attempt: _pending) {
+        res.push_back(attempt.socket.get_socket());
+    }
+    return res;
+}
+
+long ConnectRace::get_wait_time() const {
+    auto until = _next < _endpoints.size() ? _next_start : clock::time_point::max();
+    for (auto &attempt: _pending) {
+        until = std::min(until, attempt.deadline);
+    }
+    if (until == clock::time_point::max()) {
+        return 0;
+    }
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(until - clock::now());
+    return left.count() > 0 ? (long) left.count() : 0;
+}
+
+void ConnectRace::on_ready(size_t index) {
+    if (_pending[index].socket.finish_connect() == status::connected) {
+        _win(_pending[index].socket);
+    } else {
+        _fail(index, clock::now());
+    }
+}
+
+status ConnectRace::finish(BaseSocket &socket) {
+    if (!_won) {
+        return status::err_socket_connect;
+    }
+    _won = false;
+    socket.disconnect();
+    socket = std::move(_winner);
+    return status::connected;
+}
+
+status ConnectRace::run(BaseSocket &socket, bool blocking) {
+    while (!advance()) {
+        std::vector<pollfd> polled;
+        for (auto fd: get_waiting()) {
+            polled.push_back({fd, POLLOUT, 0});
+        }
+#ifdef _WIN32
+        WSAPoll(polled.data(), (ULONG) polled.size(), (int) get_wait_time());
+#else
+        poll(polled.data(), polled.size(), (int) get_wait_time());
+#endif
+        // One at a time, on_ready() changes the attempts
+        for (size_t i = 0; i < polled.size(); ++i) {
+            if (polled[i].revents != 0) {
+                on_ready(i);
+                break;
+            }
+        }
+    }
+
+    auto sts = finish(socket);
+    if (sts == status::connected && !socket.set_blocking(blocking)) {
+        socket.disconnect();
+        return status::err_socket_init;
+    }
+    return sts;
+}
+
+size_t ConnectRace::get_attempts() const {
+    return _attempts;
+}
+
+size_t ConnectRace::get_failed() const {
+    return _failed;
+}
+
+void ConnectRace::_start(const endpoint_t &endpoint, clock::time_point now) {
+    _attempts++;
+    _next_start = now + std::chrono::milliseconds(_config.attempt_delay);
+
+    attempt_t attempt{BaseSocket(), now + std::chrono::milliseconds(_config.attempt_timeout)};
+    bool in_progress;
+    if (attempt.socket.start_connect(endpoint, in_progress) == status::connected) {
+        _win(attempt.socket);
+    } else if (in_progress) {
+        _pending.push_back(std::move(attempt));
+    } else {
+        _failed++;
+        _next_start = now;
+    }
+}
+
+void ConnectRace::_fail(size_t index, clock::time_point now) {
+    _failed++;
+    _pending[index].socket.disconnect();
+    _pending.erase(_pending.begin() + (long) index);
+    // The next address is tried at once instead of after the delay
+    _next_start = now;
+}
+
+void ConnectRace::_win(BaseSocket &socket) {
+    _won = true;
+    _winner = std::move(socket);
+    for (auto &attempt: _pending) {
+        attempt.socket.disconnect();
+    }
+    _pending.clear();
+}
+
+}
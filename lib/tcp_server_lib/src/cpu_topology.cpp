@@ -0,0 +1,103 @@
+#include "cpu_topology.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace prll {
+
+static const int max_numa_nodes = 64;
+
+static bool read_cpu_list(const std::string &path, std::vector<int> &cpus) {
+    std::ifstream file(path);
+    std::string list;
+    if (!file || !std::getline(file, list)) {
+        return false;
+    }
+    cpus = CpuTopology::parse_cpu_list(list);
+    return true;
+}
+
+CpuTopology::CpuTopology() {
+    if (!read_cpu_list("/sys/devices/system/cpu/online", _cpus) || _cpus.empty()) {
+        _cpus.clear();
+        for (int cpu = 0; cpu < (int) std::max(std::thread::hardware_concurrency(), 1u); ++cpu) {
+            _cpus.push_back(cpu);
+        }
+    }
+    _node_of.assign(_cpus.back() + 1, 0);
+
+    for (int node = 0; node < max_numa_nodes; ++node) {
+        std::vector<int> cpus;
+        if (!read_cpu_list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist", cpus)) {
+            continue;
+        }
+        // Keeps the numbering of the kernel, a node without online CPUs stays empty
+        _nodes.resize(node + 1);
+        for (auto cpu: cpus) {
+            if (cpu < (int) _node_of.size() && std::binary_search(_cpus.begin(), _cpus.end(), cpu)) {
+                _nodes[node].push_back(cpu);
+                _node_of[cpu] = node;
+            }
+        }
+    }
+    if (_nodes.empty()) {
+        _nodes.push_back(_cpus);
+    }
+}
+
+const CpuTopology &CpuTopology::get() {
+    static const CpuTopology topology;
+    return topology;
+}
+
+const std::vector<int> &CpuTopology::get_cpus() const {
+    return _cpus;
+}
+
+const std::vector<std::vector<int>> &CpuTopology::get_nodes() const {
+    return _nodes;
+}
+
+int CpuTopology::node_of(int cpu) const {
+    return cpu >= 0 && cpu < (int) _node_of.size() ? _node_of[cpu] : 0;
+}
+
+int CpuTopology::current_node() const {
+#ifdef __linux__
+    return node_of(sched_getcpu());
+#else
+    return 0;
+#endif
+}
+
+std::vector<int> CpuTopology::parse_cpu_list(std::string_view list) {
+    std::vector<int> cpus;
+    while (!list.empty()) {
+        auto end = std::min(list.find(','), list.size());
+        auto range = list.substr(0, end);
+        list.remove_prefix(std::min(end + 1, list.size()));
+
+        auto dash = range.find('-');
+        auto first = (int) strtol(std::string(range.substr(0, dash)).c_str(), nullptr, 10);
+        auto last = dash == std::string_view::npos
+                    ? first : (int) strtol(std::string(range.substr(dash + 1)).c_str(), nullptr, 10);
+        if (range.find_first_of("0123456789") == std::string_view::npos) {
+            continue;
+        }
+        for (int cpu = first; cpu <= last; ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+}
@@ -0,0 +1,205 @@
+#include "event_loop.hpp"
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace bstcp {
+
+static const int        max_events = 256;
+static const uint64_t   wake_id = 0;
+static const size_t     blocking_threads = 8;
+
+EventLoop::EventLoop()
+        : _epoll(epoll_create1(EPOLL_CLOEXEC))
+          , _wake(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+          , _running(false)
+          , _cancelled(false)
+          , _thread()
+          , _posted()
+          , _next_id(wake_id)
+          , _waiting()
+          , _timers()
+          , _blocking() {
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = wake_id;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _wake, &event);
+
+    _blocking.set_max_threads(blocking_threads);
+}
+
+EventLoop::~EventLoop() {
+    stop();
+    _cancel_all();
+    _blocking.stop();
+    close(_wake);
+    close(_epoll);
+}
+
+void EventLoop::start(const std::function<void()> &on_start) {
+    _running = true;
+    _thread = std::thread([this, on_start] {
+        if (on_start) {
+            on_start();
+        }
+        run();
+    });
+}
+
+void EventLoop::run() {
+    _running = true;
+    epoll_event events[max_events];
+    while (_running) {
+        int count = epoll_wait(_epoll, events, max_events, _wait_timeout());
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.u64 == wake_id) {
+                _resume_posted();
+                continue;
+            }
+
+            auto it = _waiting.find(events[i].data.u64);
+            if (it != _waiting.end()) {
+                _finish(it->second, (int) (events[i].data.u64 - it->second.first));
+            }
+        }
+        _expire_timers();
+    }
+}
+
+void EventLoop::stop() {
+    _running = false;
+    uint64_t one = 1;
+    [[maybe_unused]] auto res = write(_wake, &one, sizeof(one));
+    if (_thread.joinable() && _thread.get_id() != std::this_thread::get_id()) {
+        _thread.join();
+    }
+}
+
+void EventLoop::post(std::coroutine_handle<> handle) {
+    {
+        std::lock_guard<std::mutex> lck(_posted_mutex);
+        _posted.push_back(handle);
+    }
+    uint64_t one = 1;
+    [[maybe_unused]] auto res = write(_wake, &one, sizeof(one));
+}
+
+void EventLoop::spawn(Task<void> task) {
+    start_detached([](EventLoop &loop, Task<void> task) -> Task<void> {
+        co_await loop.schedule();
+        co_await task;
+    }(*this, std::move(task)));
+}
+
+EventLoop::io_awaitable EventLoop::readable(socket_t fd, long timeout) {
+    return {*this, fd, EPOLLIN | EPOLLRDHUP, timeout};
+}
+
+EventLoop::io_awaitable EventLoop::writable(socket_t fd, long timeout) {
+    return {*this, fd, EPOLLOUT, timeout};
+}
+
+EventLoop::any_awaitable EventLoop::writable_any(std::vector<socket_t> fds, long timeout) {
+    return {*this, std::move(fds), EPOLLOUT, timeout};
+}
+
+bool EventLoop::_wait(std::coroutine_handle<> handle, const socket_t *fds, size_t count,
+                      uint32_t events, long timeout, int *result) {
+    if (_cancelled) {
+        *result = wait_failed;
+        return false;
+    }
+
+    wait_t wait{handle, fds, 0, _next_id + 1, result};
+    _next_id += count;
+
+    // One shot, so that an fd ready again before _finish() removes it isn't
+    // reported twice
+    for (; wait.count < count; ++wait.count) {
+        epoll_event event{};
+        event.events = events | EPOLLONESHOT;
+        event.data.u64 = wait.first + wait.count;
+        if (epoll_ctl(_epoll, EPOLL_CTL_ADD, fds[wait.count], &event) != 0) {
+            break;
+        }
+        _waiting[event.data.u64] = wait;
+    }
+    if (wait.count < count) {
+        *result = wait_failed;
+        for (size_t i = 0; i < wait.count; ++i) {
+            epoll_ctl(_epoll, EPOLL_CTL_DEL, fds[i], nullptr);
+            _waiting.erase(wait.first + i);
+        }
+        return false;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        _waiting[wait.first + i].count = count;
+    }
+    if (timeout >= 0) {
+        _timers.push({clock::now() + std::chrono::milliseconds(timeout), wait.first});
+    }
+    return true;
+}
+
+void EventLoop::_finish(wait_t wait, int result) {
+    for (size_t i = 0; i < wait.count; ++i) {
+        _waiting.erase(wait.first + i);
+        epoll_ctl(_epoll, EPOLL_CTL_DEL, wait.fds[i], nullptr);
+    }
+    *wait.result = result;
+    wait.handle.resume();
+}
+
+void EventLoop::_cancel_all() {
+    _cancelled = true;
+    while (true) {
+        // What runs on the helpers is posted back once done
+        _blocking.wait();
+        {
+            std::lock_guard<std::mutex> lck(_posted_mutex);
+            if (_posted.empty() && _waiting.empty()) {
+                break;
+            }
+        }
+        _resume_posted();
+        while (!_waiting.empty()) {
+            _finish(_waiting.begin()->second, wait_failed);
+        }
+    }
+}
+
+void EventLoop::_resume_posted() {
+    uint64_t count;
+    [[maybe_unused]] auto res = read(_wake, &count, sizeof(count));
+
+    std::vector<std::coroutine_handle<>> posted;
+    {
+        std::lock_guard<std::mutex> lck(_posted_mutex);
+        posted.swap(_posted);
+    }
+    for (auto handle: posted) {
+        handle.resume();
+    }
+}
+
+void EventLoop::_expire_timers() {
+    auto now = clock::now();
+    while (!_timers.empty() && _timers.top().deadline <= now) {
+        auto it = _waiting.find(_timers.top().id);
+        _timers.pop();
+        if (it != _waiting.end()) {
+            _finish(it->second, -1);
+        }
+    }
+}
+
+int EventLoop::_wait_timeout() const {
+    if (_timers.empty()) {
+        return -1;
+    }
+    auto left = std::chrono::ceil<std::chrono::milliseconds>(_timers.top().deadline - clock::now());
+    return left.count() > 0 ? (int) left.count() : 0;
+}
+
+}
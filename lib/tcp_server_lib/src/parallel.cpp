@@ -1,14 +1,26 @@
 #include "parallel.hpp"
+#include "cpu_topology.hpp"
+
+#include <chrono>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 namespace prll {
 static const double resize_coef = 2;
+static const std::chrono::milliseconds balance_interval(100);
 
 Parallel::Parallel()
         : _threads()
-          , _main_thread(&Parallel::_balance, this)
+          , _main_thread()
           , _exit(false)
+          , _min_threads(1)
           , _max_threads(MAXNTHREADS) {
     _threads.emplace_back(new Thread(_task_mutex, _tasks, _in_thread));
+    // Started last, it reads the members above
+    _main_thread = std::thread(&Parallel::_balance, this);
 }
 
 void Parallel::wait() {
@@ -26,6 +38,41 @@ void Parallel::set_max_threads(size_t max_threads) {
     _in_balance.notify_one();
 }
 
+void Parallel::set_min_threads(size_t min_threads) {
+    std::unique_lock<std::mutex> lck(_task_mutex);
+    _min_threads = std::max(min_threads, (size_t) 1);
+    lck.unlock();
+    _in_balance.notify_one();
+}
+
+placement_t placement_t::numa_node(int node, bool per_worker) {
+    auto &nodes = CpuTopology::get().get_nodes();
+    if (node < 0 || node >= (int) nodes.size()) {
+        return {};
+    }
+    return {nodes[node], per_worker};
+}
+
+void Parallel::set_placement(placement_t placement) {
+    std::unique_lock<std::mutex> lck(_main_mutex);
+    _placement = std::move(placement);
+    for (size_t i = 0; i < _threads.size(); ++i) {
+        _threads[i]->set_affinity(_worker_cpus(i));
+    }
+}
+
+placement_t Parallel::get_placement() {
+    std::unique_lock<std::mutex> lck(_main_mutex);
+    return _placement;
+}
+
+std::vector<int> Parallel::_worker_cpus(size_t worker) const {
+    if (!_placement.per_worker || _placement.cpus.empty()) {
+        return _placement.cpus;
+    }
+    return {_placement.cpus[worker % _placement.cpus.size()]};
+}
+
 Parallel::~Parallel() {
     if (!_exit) {
         stop();
@@ -34,12 +81,19 @@ Parallel::~Parallel() {
 
 Parallel::Thread::Thread(std::mutex &thread_mutex,
                          std::queue<std::function<void(void)>> &task,
-                         std::condition_variable &threads)
+                         std::condition_variable &threads,
+                         std::vector<int> cpus)
         : _task_mutex(thread_mutex)
           , _in_thread(threads)
           , _tasks(task)
           , _end(false)
-          , _main_thread(&Thread::_main, this) {}
+          , _retire(false)
+          , _cpus(std::move(cpus))
+          , _main_thread()
+          , _have_proccess(0)
+          , _done(false) {
+    _main_thread = std::thread(&Thread::_main, this);
+}
 
 void Parallel::Thread::join() {
     _main_thread.join();
@@ -55,6 +109,37 @@ void Parallel::Thread::force_join() {
     }
 }
 
+// Restricts `thread` to `cpus`, or lets it run on every online CPU when empty
+static void pin_thread(std::thread::native_handle_type thread, const std::vector<int> &cpus) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu: cpus.empty() ? CpuTopology::get().get_cpus() : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    pthread_setaffinity_np(thread, sizeof(set), &set);
+#else
+    (void) thread;
+    (void) cpus;
+#endif
+}
+
+void pin_current_thread(const std::vector<int> &cpus) {
+#ifdef __linux__
+    pin_thread(pthread_self(), cpus);
+#else
+    (void) cpus;
+#endif
+}
+
+void Parallel::Thread::set_affinity(const std::vector<int> &cpus) {
+    std::unique_lock<std::mutex> lck(_task_mutex);
+    _cpus = cpus;
+    pin_thread(_main_thread.native_handle(), _cpus);
+}
+
 void Parallel::Thread::wait() {
     std::unique_lock<std::mutex> lck(_task_mutex);
     _wait.wait(lck, [this] {
@@ -62,19 +147,44 @@ void Parallel::Thread::wait() {
     });
 }
 
+void Parallel::Thread::retire() {
+    std::unique_lock<std::mutex> lck(_task_mutex);
+    _retire = true;
+    lck.unlock();
+    _in_thread.notify_all();
+}
+
+bool Parallel::Thread::is_idle() const {
+    return _have_proccess == 0;
+}
+
+bool Parallel::Thread::is_done() const {
+    return _done;
+}
+
 Parallel::Thread::~Thread() {
     force_join();
 }
 
 void Parallel::Thread::_main() {
+    // The handle in _main_thread may not be stored yet
+#ifdef __linux__
+    {
+        std::unique_lock<std::mutex> lck(_task_mutex);
+        if (!_cpus.empty()) {
+            pin_thread(pthread_self(), _cpus);
+        }
+    }
+#endif
+
     while (true) {
         std::unique_lock<std::mutex> lck(_task_mutex);
 
         _in_thread.wait(lck, [this] {
-            return _end || !_tasks.empty();
+            return _end || _retire || !_tasks.empty();
         });
 
-        if (_end) {
+        if (_end || _retire) {
             lck.unlock();
             break;
         }
@@ -90,19 +200,41 @@ void Parallel::Thread::_main() {
 
         _wait.notify_one();
     }
+    _done = true;
 }
 
 void Parallel::_balance() {
+    // The queue and the limits are guarded by _task_mutex, the workers by _main_mutex
+    auto resize = [this]() -> int {
+        std::lock_guard<std::mutex> tasks_lck(_task_mutex);
+        auto threads = _threads.size();
+        if (threads > _max_threads
+            || (threads > _min_threads && threads > (size_t) (resize_coef * (double) _tasks.size()))) {
+            return -1;
+        }
+        if (threads < _max_threads
+            && (threads < _min_threads || _tasks.size() > (size_t) (resize_coef * (double) threads))) {
+            return 1;
+        }
+        return 0;
+    };
+
+    // False after a shrink found every worker busy, the next try waits for
+    // the interval instead of spinning
+    bool shrink_now = true;
+
     while (true) {
         std::unique_lock<std::mutex> lck(_main_mutex);
 
-        _in_balance.wait(lck, [this] {
-            return _exit
-                   || _tasks.size() >
-                      (size_t) (resize_coef * (double) _threads.size())
-                   || _threads.size() >
-                      (size_t) (resize_coef * (double) _tasks.size())
-                   || _threads.size() > (size_t) _max_threads;
+        // Woken by new tasks; rechecks now and then to shrink once they are done
+        int step = 0;
+        _in_balance.wait_for(lck, balance_interval, [&] {
+            step = resize();
+            return _exit || step > 0 || (step < 0 && shrink_now);
+        });
+
+        std::erase_if(_retired, [](auto &thread) {
+            return thread->is_done();
         });
 
         if (_exit) {
@@ -110,25 +242,29 @@ void Parallel::_balance() {
                 _threads.back()->force_join();
                 _threads.pop_back();
             }
+            _retired.clear();
             break;
         }
 
-        while (_threads.size() > (size_t) _max_threads) {
-            _threads.back()->wait();
-            _threads.back()->force_join();
-            _threads.pop_back();
-        }
-
-        if (_tasks.size() > (size_t) (resize_coef * (double) _threads.size()) &&
-            _threads.size() < (size_t) _max_threads) {
-            _threads.emplace_back(new Thread(_task_mutex, _tasks, _in_thread));
-        } else {
-            if (_threads.size() >
-                (size_t) (resize_coef * (double) _tasks.size()) &&
-                _threads.size() > (size_t) 1) {
-                _threads.back()->wait();
-                _threads.back()->force_join();
-                _threads.pop_back();
+        if (step > 0) {
+            _threads.emplace_back(new Thread(_task_mutex, _tasks, _in_thread, _worker_cpus(_threads.size())));
+        } else if (step < 0) {
+            // Only a worker between tasks is retired. Waiting for the queue to
+            // drain never ends while tasks such as accept loops queue themselves again
+            shrink_now = false;
+            for (size_t i = _threads.size(); i-- > 0;) {
+                if (!_threads[i]->is_idle()) {
+                    continue;
+                }
+                _threads[i]->retire();
+                _retired.push_back(std::move(_threads[i]));
+                _threads.erase(_threads.begin() + (long) i);
+                // The workers after it move down, their CPUs follow the index
+                for (size_t j = i; j < _threads.size(); ++j) {
+                    _threads[j]->set_affinity(_worker_cpus(j));
+                }
+                shrink_now = true;
+                break;
             }
         }
         lck.unlock();
@@ -139,6 +275,11 @@ size_t Parallel::get_count_threads() const {
     return _max_threads;
 }
 
+size_t Parallel::get_worker_count() {
+    std::unique_lock<std::mutex> lck(_main_mutex);
+    return _threads.size();
+}
+
 void Parallel::stop() {
     _exit = true;
     _in_balance.notify_one();
@@ -2,6 +2,7 @@
 
 using namespace bstcp;
 
+#include <cerrno>
 #include <iostream>
 
 BaseSocket::~BaseSocket() {
@@ -91,6 +92,80 @@ status BaseSocket::_init_as_client(uint32_t host, uint16_t port, uint16_t type)
     return _status = status::connected;
 }
 
+status BaseSocket::start_connect(uint32_t host, uint16_t port, bool &in_progress) {
+    endpoint_t endpoint{};
+    auto &address = reinterpret_cast<socket_addr_in &>(endpoint.address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = host;
+    address.sin_port = htons(port);
+    endpoint.length = sizeof(socket_addr_in);
+    return start_connect(endpoint, in_progress);
+}
+
+status BaseSocket::start_connect(const endpoint_t &endpoint, bool &in_progress) {
+    in_progress = false;
+#ifdef _WIN32
+    auto &address = reinterpret_cast<const socket_addr_in &>(endpoint.address);
+    return init(address.sin_addr.S_un.S_addr, ntohs(address.sin_port),
+                (uint16_t) SocketType::nonblocking_socket | (uint16_t) SocketType::client_socket);
+#else
+    if (_status == status::connected) {
+        disconnect();
+    }
+
+    auto family = endpoint.address.ss_family;
+    if ((_socket = socket(family, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_IP)) < 0) {
+        return _status = status::err_socket_init;
+    }
+
+    new(&_address) socket_addr_in;
+    if (family == AF_INET) {
+        _address = reinterpret_cast<const socket_addr_in &>(endpoint.address);
+    }
+
+    if (::connect(_socket, (const sockaddr *) &endpoint.address, endpoint.length) == 0) {
+        return _status = status::connected;
+    }
+    if (errno != EINPROGRESS) {
+        close(_socket);
+        _socket = -1;
+        return _status = status::err_socket_connect;
+    }
+
+    in_progress = true;
+    return _status = status::disconnected;
+#endif
+}
+
+status BaseSocket::finish_connect() {
+#ifdef _WIN32
+    return _status;
+#else
+    int error = 0;
+    sock_len_t len = sizeof(error);
+    if (_socket == -1
+        || getsockopt(_socket, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0) {
+        disconnect();
+        return _status = status::err_socket_connect;
+    }
+    return _status = status::connected;
+#endif
+}
+
+bool BaseSocket::set_blocking(bool blocking) {
+#ifdef _WIN32
+    unsigned long mode = blocking ? 0 : 1;
+    return ioctlsocket(_socket, FIONBIO, &mode) != SOCKET_ERROR;
+#else
+    int flags = fcntl(_socket, F_GETFL, 0);
+    if (flags == -1) {
+        return false;
+    }
+    flags = blocking ? (flags & ~O_NONBLOCK) : (flags | O_NONBLOCK);
+    return fcntl(_socket, F_SETFL, flags) == 0;
+#endif
+}
+
 status BaseSocket::accept(const BaseSocket& server_socket) {
     if (_status == status::connected) {
         disconnect();
@@ -170,6 +245,12 @@ status BaseSocket::_init_as_server(uint32_t, uint16_t port, uint16_t type) {
         return _status = status::err_socket_bind;
     }
 
+    // The kernel spreads incoming connections over all listeners of the port
+    if (int flag = true; type & (uint16_t)SocketType::reuse_port
+                         && setsockopt(_socket, SOL_SOCKET, SO_REUSEPORT, &flag, sizeof(flag)) == -1)  {
+        return _status = status::err_socket_bind;
+    }
+
     if (bind(_socket, (struct sockaddr *) &address, sizeof(address)) < 0) {
         return _status = status::err_socket_bind;
     }
@@ -200,6 +281,15 @@ bool BaseSocket::recv_from(void *buffer, int size) {
     return true;
 }
 
+int BaseSocket::recv_some(void *buffer, int size) {
+    if (_status != SocketStatus::connected) {
+        return -1;
+    }
+
+    ssize_t answ = recv(_socket, reinterpret_cast<char *>(buffer), size, 0);
+    return answ < 0 ? -1 : (int) answ;
+}
+
 bool BaseSocket::send_to(const void *buffer, int size) const {
     if (_status != SocketStatus::connected) {
         return false;
@@ -212,6 +302,15 @@ bool BaseSocket::send_to(const void *buffer, int size) const {
     return true;
 }
 
+int BaseSocket::send_some(const void *buffer, int size) {
+    if (_status != SocketStatus::connected) {
+        return -1;
+    }
+
+    ssize_t sent = send(_socket, reinterpret_cast<const char *>(buffer), size, 0);
+    return sent < 0 ? -1 : (int) sent;
+}
+
 status BaseSocket::disconnect() {
     _status = status::disconnected;
 #ifdef _WIN32
@@ -308,6 +407,10 @@ bool BaseSocket::is_allow_to_read(long timeout) const {
     }
 }
 
+int BaseSocket::get_pending() const {
+    return 0;
+}
+
 bool BaseSocket::is_allow_to_write(long timeout) const {
     if (_status != status::connected) {
         return false;
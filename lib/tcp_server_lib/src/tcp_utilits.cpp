@@ -4,7 +4,7 @@ int bstcp::hostname_to_ip(const char *hostname, bstcp::socket_addr_in *addr) {
     struct addrinfo hints{}, *servinfo, *p;
 
     memset(&hints, 0, sizeof hints);
-    hints.ai_family = AF_UNSPEC;
+    hints.ai_family = AF_INET;
     hints.ai_socktype = SOCK_STREAM;
 
     if (getaddrinfo( hostname , "http" , &hints , &servinfo) != 0) {
@@ -15,4 +15,37 @@ int bstcp::hostname_to_ip(const char *hostname, bstcp::socket_addr_in *addr) {
 
     freeaddrinfo(servinfo); // all done with this structure
     return 0;
+}
+
+int bstcp::resolve_host(const char *hostname, std::vector<endpoint_t> *endpoints) {
+    struct addrinfo hints{}, *servinfo;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    if (getaddrinfo(hostname, nullptr, &hints, &servinfo) != 0) {
+        return -1;
+    }
+
+    std::vector<endpoint_t> first, second;
+    for (auto p = servinfo; p != nullptr; p = p->ai_next) {
+        if ((p->ai_family != AF_INET && p->ai_family != AF_INET6) || p->ai_addrlen > sizeof(sockaddr_storage)) {
+            continue;
+        }
+        endpoint_t endpoint{};
+        memcpy(&endpoint.address, p->ai_addr, p->ai_addrlen);
+        endpoint.length = (sock_len_t) p->ai_addrlen;
+        (p->ai_family == servinfo->ai_family ? first : second).push_back(endpoint);
+    }
+    freeaddrinfo(servinfo);
+
+    endpoints->clear();
+    for (size_t i = 0; i < std::max(first.size(), second.size()); ++i) {
+        if (i < first.size()) {
+            endpoints->push_back(first[i]);
+        }
+        if (i < second.size()) {
+            endpoints->push_back(second[i]);
+        }
+    }
+    return endpoints->empty() ? -1 : 0;
 }
\ No newline at end of file
@@ -2,4 +2,14 @@
 
 #include "include/tcp_utilits.hpp"
 #include "include/tcp_server.hpp"
+#include "include/task.hpp"
+#include "include/event_loop.hpp"
+#include "include/async_socket.hpp"
+#include "include/connect_race.hpp"
+#include "include/sharded_tcp_server.hpp"
+#include "include/shard.hpp"
+#include "include/cpu_topology.hpp"
+#include "include/client_table.hpp"
+#include "include/block_pool.hpp"
+#include "include/buffer_pool.hpp"
 #include "include/tcp_base_socket.hpp"
\ No newline at end of file
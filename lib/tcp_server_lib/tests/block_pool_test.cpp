@@ -0,0 +1,121 @@
+#include "include/block_pool.hpp"
+#include "include/cpu_topology.hpp"
+
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using bstcp::BlockPool;
+
+// Each test uses its own block size, the pools are process-wide
+
+TEST(BlockPool, AlignsBlocks) {
+    using pool = BlockPool<48, 64>;
+    std::vector<void *> blocks;
+    for (int i = 0; i < 10; ++i) {
+        blocks.push_back(pool::allocate());
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(blocks.back()) % 64, 0u);
+    }
+    for (auto block: blocks) {
+        pool::deallocate(block);
+    }
+}
+
+TEST(BlockPool, ReusesFreedBlock) {
+    using pool = BlockPool<104>;
+    auto block = pool::allocate();
+    EXPECT_EQ(pool::get_stats().live, 1u);
+    EXPECT_EQ(pool::get_stats().free, 0u);
+
+    pool::deallocate(block);
+    EXPECT_EQ(pool::get_stats().live, 0u);
+    EXPECT_EQ(pool::get_stats().free, 1u);
+
+    EXPECT_EQ(pool::allocate(), block);
+    pool::deallocate(block);
+}
+
+TEST(BlockPool, SteadyLoadStopsAllocating) {
+    using pool = BlockPool<136>;
+    const size_t count = 3 * pool::cache_size;
+    std::vector<void *> blocks;
+    for (int round = 0; round < 5; ++round) {
+        for (size_t i = 0; i < count; ++i) {
+            blocks.push_back(pool::allocate());
+        }
+        for (auto block: blocks) {
+            pool::deallocate(block);
+        }
+        blocks.clear();
+
+        // The peak stays in the pool, past the cache too
+        auto stats = pool::get_stats();
+        EXPECT_EQ(stats.live, 0u);
+        EXPECT_EQ(stats.free, count) << "round " << round;
+    }
+}
+
+TEST(BlockPool, BlocksFreedOnAnotherThreadComeBack) {
+    using pool = BlockPool<168>;
+    const size_t count = 2 * pool::cache_size;
+    std::vector<void *> blocks;
+    for (size_t i = 0; i < count; ++i) {
+        blocks.push_back(pool::allocate());
+    }
+
+    std::thread([&blocks] {
+        for (auto block: blocks) {
+            pool::deallocate(block);
+        }
+    }).join();
+    EXPECT_EQ(pool::get_stats().live, 0u);
+    EXPECT_EQ(pool::get_stats().free, count);
+
+    // The exited thread gave its cache to the shared list of its node
+    if (prll::CpuTopology::get().get_nodes().size() > 1) {
+        GTEST_SKIP() << "the threads may run on different NUMA nodes";
+    }
+    for (size_t i = 0; i < count; ++i) {
+        blocks[i] = pool::allocate();
+    }
+    EXPECT_EQ(pool::get_stats().free, 0u);
+    EXPECT_EQ(pool::get_stats().live, count);
+    for (auto block: blocks) {
+        pool::deallocate(block);
+    }
+}
+
+TEST(BlockPool, ConcurrentThreads) {
+    using pool = BlockPool<200>;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([] {
+            std::vector<void *> blocks;
+            for (int round = 0; round < 200; ++round) {
+                for (int i = 0; i < 50; ++i) {
+                    auto block = static_cast<unsigned char *>(pool::allocate());
+                    block[0] = (unsigned char) i;
+                    blocks.push_back(block);
+                }
+                for (auto block: blocks) {
+                    pool::deallocate(block);
+                }
+                blocks.clear();
+            }
+        });
+    }
+    for (auto &thread: threads) {
+        thread.join();
+    }
+    EXPECT_EQ(pool::get_stats().live, 0u);
+    EXPECT_LE(pool::get_stats().free, 4u * 50);
+}
+
+TEST(ObjectPool, SharedBySize) {
+    struct a_t { char data[232]; };
+    struct b_t { char data[232]; };
+    EXPECT_TRUE((std::is_same_v<bstcp::ObjectPool<a_t>, bstcp::ObjectPool<b_t>>));
+}
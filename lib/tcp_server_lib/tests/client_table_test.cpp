@@ -0,0 +1,127 @@
+#include "include/client_table.hpp"
+
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using bstcp::ClientTable;
+using bstcp::client_handle_t;
+
+struct FakeClient {
+    FakeClient(uint32_t host, uint16_t port, int id)
+            : host(host)
+              , port(port)
+              , id(id) {}
+
+    [[nodiscard]] uint32_t get_host() const {
+        return host;
+    }
+
+    [[nodiscard]] uint16_t get_port() const {
+        return port;
+    }
+
+    uint32_t    host;
+    uint16_t    port;
+    int         id;
+};
+
+static client_handle_t insert(ClientTable<FakeClient> &table, uint32_t host, uint16_t port, int id) {
+    return table.insert(std::make_unique<FakeClient>(host, port, id));
+}
+
+TEST(ClientTable, InsertAndRemove) {
+    ClientTable<FakeClient> table;
+    auto first = insert(table, 1, 80, 1);
+    auto second = insert(table, 2, 80, 2);
+    EXPECT_EQ(table.size(), 2u);
+
+    auto removed = table.remove(first);
+    ASSERT_NE(removed, nullptr);
+    EXPECT_EQ(removed->id, 1);
+    EXPECT_EQ(table.size(), 1u);
+    EXPECT_FALSE(table.for_each_by(1, 80, [](FakeClient &) {}));
+    EXPECT_NE(table.remove(second), nullptr);
+    EXPECT_EQ(table.size(), 0u);
+}
+
+TEST(ClientTable, StaleHandleFindsNothing) {
+    ClientTable<FakeClient> table;
+    auto old = insert(table, 1, 80, 1);
+    ASSERT_NE(table.remove(old), nullptr);
+    EXPECT_EQ(table.remove(old), nullptr);
+
+    // The slot is reused under a new generation
+    auto reused = insert(table, 1, 80, 2);
+    EXPECT_EQ(reused.index, old.index);
+    EXPECT_NE(reused.generation, old.generation);
+    EXPECT_EQ(table.remove(old), nullptr);
+    EXPECT_EQ(table.size(), 1u);
+
+    auto removed = table.remove(reused);
+    ASSERT_NE(removed, nullptr);
+    EXPECT_EQ(removed->id, 2);
+}
+
+TEST(ClientTable, OutOfRangeHandle) {
+    ClientTable<FakeClient> table;
+    EXPECT_EQ(table.remove({7, 0}), nullptr);
+}
+
+TEST(ClientTable, LooksUpByHostAndPort) {
+    ClientTable<FakeClient> table;
+    insert(table, 1, 80, 1);
+    auto second = insert(table, 1, 80, 2);
+    insert(table, 1, 443, 3);
+    insert(table, 2, 80, 4);
+
+    std::set<int> ids;
+    EXPECT_TRUE(table.for_each_by(1, 80, [&ids](FakeClient &client) {
+        ids.insert(client.id);
+    }));
+    EXPECT_EQ(ids, (std::set<int>{1, 2}));
+
+    table.remove(second);
+    ids.clear();
+    table.for_each_by(1, 80, [&ids](FakeClient &client) {
+        ids.insert(client.id);
+    });
+    EXPECT_EQ(ids, (std::set<int>{1}));
+    EXPECT_FALSE(table.for_each_by(3, 80, [](FakeClient &) {}));
+}
+
+TEST(ClientTable, ForEachGivesLiveHandles) {
+    ClientTable<FakeClient> table;
+    for (int i = 0; i < 5; ++i) {
+        insert(table, i, 80, i);
+    }
+    table.remove({2, 0});
+
+    std::vector<client_handle_t> handles;
+    table.for_each([&handles](client_handle_t handle, FakeClient &) {
+        handles.push_back(handle);
+    });
+    EXPECT_EQ(handles.size(), 4u);
+    for (auto handle: handles) {
+        EXPECT_NE(table.remove(handle), nullptr);
+    }
+    EXPECT_EQ(table.size(), 0u);
+}
+
+TEST(ClientTable, ClearInvalidatesHandles) {
+    ClientTable<FakeClient> table;
+    auto handle = insert(table, 1, 80, 1);
+    insert(table, 2, 80, 2);
+    table.clear();
+
+    EXPECT_EQ(table.size(), 0u);
+    EXPECT_EQ(table.remove(handle), nullptr);
+    EXPECT_FALSE(table.for_each_by(1, 80, [](FakeClient &) {}));
+
+    // Freed slots are reused, lowest index first
+    auto reused = insert(table, 3, 80, 3);
+    EXPECT_EQ(reused.index, 0u);
+    EXPECT_NE(reused.generation, handle.generation);
+}
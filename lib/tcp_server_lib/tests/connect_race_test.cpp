@@ -0,0 +1,182 @@
+#include "tcp_server_lib.hpp"
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace bstcp;
+using std::chrono::steady_clock;
+
+static long elapsed_ms(steady_clock::time_point start) {
+    return (long) std::chrono::duration_cast<std::chrono::milliseconds>(steady_clock::now() - start).count();
+}
+
+// 127.0.0.`host`, every one of them reaches the loopback interface
+static endpoint_t loopback(uint8_t host = 1) {
+    endpoint_t endpoint{};
+    auto &address = reinterpret_cast<sockaddr_in &>(endpoint.address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK - 1 + host);
+    endpoint.length = sizeof(sockaddr_in);
+    return endpoint;
+}
+
+// Listener on a loopback address, on a free port unless one is given. A
+// stalled one has its accept queue filled, so the kernel drops further SYNs
+// and connects hang
+class Listener {
+  public:
+    explicit Listener(bool stalled = false, uint8_t host = 1, uint16_t fixed_port = 0)
+            : port(fixed_port)
+              , _host(host) {
+        _fd = socket(AF_INET, SOCK_STREAM, 0);
+        auto endpoint = loopback(host);
+        reinterpret_cast<sockaddr_in &>(endpoint.address).sin_port = htons(port);
+        bind(_fd, reinterpret_cast<sockaddr *>(&endpoint.address), endpoint.length);
+        listen(_fd, 0);
+        socklen_t length = sizeof(endpoint.address);
+        getsockname(_fd, reinterpret_cast<sockaddr *>(&endpoint.address), &length);
+        port = ntohs(reinterpret_cast<sockaddr_in &>(endpoint.address).sin_port);
+
+        while (stalled && _fill_one()) {}
+    }
+
+    ~Listener() {
+        for (auto fd: _fillers) {
+            close(fd);
+        }
+        close(_fd);
+    }
+
+    uint16_t port = 0;
+
+  private:
+    // true while a connect to the listener still completes at once
+    bool _fill_one() {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        auto endpoint = loopback(_host);
+        reinterpret_cast<sockaddr_in &>(endpoint.address).sin_port = htons(port);
+        connect(fd, reinterpret_cast<sockaddr *>(&endpoint.address), endpoint.length);
+        _fillers.push_back(fd);
+
+        pollfd polled{fd, POLLOUT, 0};
+        return poll(&polled, 1, 100) == 1;
+    }
+
+    uint8_t             _host;
+    int                 _fd;
+    std::vector<int>    _fillers;
+};
+
+// Port with nothing listening, connects are refused
+static uint16_t closed_port() {
+    Listener listener;
+    return listener.port;
+}
+
+TEST(ConnectRace, ConnectsToSingleAddress) {
+    Listener listener;
+    ConnectRace race({loopback()}, listener.port);
+    BaseSocket socket;
+    EXPECT_EQ(race.run(socket), status::connected);
+    EXPECT_EQ(socket.get_status(), status::connected);
+    EXPECT_EQ(race.get_attempts(), 1u);
+    EXPECT_EQ(race.get_failed(), 0u);
+}
+
+TEST(ConnectRace, NoAddresses) {
+    ConnectRace race({}, 80);
+    BaseSocket socket;
+    EXPECT_EQ(race.run(socket), status::err_socket_connect);
+    EXPECT_EQ(race.get_attempts(), 0u);
+}
+
+TEST(ConnectRace, AllRefused) {
+    auto port = closed_port();
+    ConnectRace race({loopback(), loopback()}, port, {1000, 500});
+    BaseSocket socket;
+    auto start = steady_clock::now();
+    EXPECT_EQ(race.run(socket), status::err_socket_connect);
+    EXPECT_EQ(race.get_attempts(), 2u);
+    EXPECT_EQ(race.get_failed(), 2u);
+    // A refused attempt starts the next one at once
+    EXPECT_LT(elapsed_ms(start), 500);
+}
+
+TEST(ConnectRace, StalledAddressTimesOut) {
+    Listener stalled(true);
+    ConnectRace race({loopback()}, stalled.port, {200, 50});
+    BaseSocket socket;
+    auto start = steady_clock::now();
+    EXPECT_EQ(race.run(socket), status::err_socket_connect);
+    EXPECT_GE(elapsed_ms(start), 200);
+    EXPECT_EQ(race.get_failed(), 1u);
+}
+
+TEST(ConnectRace, NextAddressWinsAfterDelay) {
+    Listener stalled(true, 2);
+    Listener listener(false, 1, stalled.port);
+    ConnectRace race({loopback(2), loopback(1)}, stalled.port, {2000, 100});
+    BaseSocket socket;
+    auto start = steady_clock::now();
+    EXPECT_EQ(race.run(socket), status::connected);
+
+    // Not before the delay, and without waiting for the stalled attempt to time out
+    auto elapsed = elapsed_ms(start);
+    EXPECT_GE(elapsed, 100);
+    EXPECT_LT(elapsed, 2000);
+    EXPECT_EQ(race.get_attempts(), 2u);
+    EXPECT_EQ(race.get_failed(), 0u);
+
+    socket_addr_in peer{};
+    socklen_t length = sizeof(peer);
+    getpeername(socket.get_socket(), reinterpret_cast<sockaddr *>(&peer), &length);
+    EXPECT_EQ(ntohl(peer.sin_addr.s_addr), INADDR_LOOPBACK);
+}
+
+TEST(ConnectRace, GetWaitTimeFollowsDeadlines) {
+    Listener stalled(true);
+    ConnectRace race({loopback(), loopback()}, stalled.port, {1000, 100});
+    EXPECT_FALSE(race.advance());
+    EXPECT_EQ(race.get_waiting().size(), 1u);
+    auto wait = race.get_wait_time();
+    EXPECT_GT(wait, 0);
+    EXPECT_LE(wait, 100);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(wait + 10));
+    EXPECT_FALSE(race.advance());
+    EXPECT_EQ(race.get_waiting().size(), 2u);
+    EXPECT_EQ(race.get_attempts(), 2u);
+}
+
+TEST(ConnectRace, AsyncOnEventLoop) {
+    Listener listener;
+    EventLoop loop;
+    loop.start();
+
+    std::atomic<bool> done = false;
+    status result = status::disconnected;
+    loop.spawn([](EventLoop &loop, uint16_t port, status &result, std::atomic<bool> &done) -> Task<void> {
+        ConnectRace race({loopback()}, port);
+        BaseSocket socket;
+        AsyncSocket async(loop, socket);
+        result = co_await async.connect(race);
+        done = true;
+    }(loop, listener.port, result, done));
+
+    for (int i = 0; i < 500 && !done; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    loop.stop();
+    ASSERT_TRUE(done);
+    EXPECT_EQ(result, status::connected);
+}
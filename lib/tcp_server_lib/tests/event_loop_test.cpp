@@ -0,0 +1,92 @@
+#include "tcp_server_lib.hpp"
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+using namespace bstcp;
+
+namespace {
+
+struct socket_pair_t {
+    int fds[2] = {-1, -1};
+
+    socket_pair_t() {
+        socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds);
+    }
+
+    ~socket_pair_t() {
+        close(fds[0]);
+        close(fds[1]);
+    }
+};
+
+bool wait_for(const std::atomic<bool> &done) {
+    for (int i = 0; i < 500 && !done; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return done;
+}
+
+}
+
+TEST(EventLoop, WaitsOnSameFdAgain) {
+    socket_pair_t pair;
+    EventLoop loop;
+    loop.start();
+
+    std::atomic<bool> done = false;
+    int ready = 0;
+    loop.spawn([](EventLoop &loop, int fd, int &ready, std::atomic<bool> &done) -> Task<void> {
+        for (int i = 0; i < 3; ++i) {
+            ready += co_await loop.writable(fd, 1000) ? 1 : 0;
+        }
+        done = true;
+    }(loop, pair.fds[0], ready, done));
+
+    ASSERT_TRUE(wait_for(done));
+    EXPECT_EQ(ready, 3);
+}
+
+TEST(EventLoop, FailedWaitIsNotTimeout) {
+    EventLoop loop;
+    loop.start();
+
+    std::atomic<bool> done = false;
+    int result = 0;
+    loop.spawn([](EventLoop &loop, int &result, std::atomic<bool> &done) -> Task<void> {
+        std::vector<socket_t> closed{-1};
+        result = co_await loop.writable_any(std::move(closed), 1000);
+        done = true;
+    }(loop, result, done));
+
+    ASSERT_TRUE(wait_for(done));
+    EXPECT_EQ(result, EventLoop::wait_failed);
+}
+
+TEST(EventLoop, DestructorEndsWaitingCoroutines) {
+    socket_pair_t pair;
+    // A copy is held by the coroutine frame
+    auto frame_alive = std::make_shared<int>(0);
+    std::atomic<bool> started = false;
+    bool result = true;
+    {
+        EventLoop loop;
+        loop.start();
+        loop.spawn([](EventLoop &loop, int fd, std::shared_ptr<int>, bool &result,
+                      std::atomic<bool> &started) -> Task<void> {
+            started = true;
+            result = co_await loop.readable(fd, -1);
+        }(loop, pair.fds[0], frame_alive, result, started));
+        ASSERT_TRUE(wait_for(started));
+    }
+    EXPECT_FALSE(result);
+    EXPECT_EQ(frame_alive.use_count(), 1);
+}
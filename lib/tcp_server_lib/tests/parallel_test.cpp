@@ -0,0 +1,57 @@
+#include "include/parallel.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+using prll::Parallel;
+
+namespace {
+
+// Queues itself again like the accept and recv loops, the queue never drains
+void requeue(Parallel &pool, std::atomic<long> &runs) {
+    ++runs;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    pool.add(requeue, std::ref(pool), std::ref(runs));
+}
+
+bool wait_for(const std::function<bool()> &done, std::chrono::seconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+}
+
+TEST(Parallel, ShrinksWhileTasksQueueThemselves) {
+    Parallel pool;
+    pool.set_max_threads(8);
+    std::atomic<long> runs = 0;
+    pool.add(requeue, std::ref(pool), std::ref(runs));
+
+    for (int i = 0; i < 64; ++i) {
+        pool.add([] { std::this_thread::sleep_for(std::chrono::milliseconds(20)); });
+    }
+    EXPECT_TRUE(wait_for([&pool] { return pool.get_worker_count() > 1; }, std::chrono::seconds(5)));
+    EXPECT_TRUE(wait_for([&pool] { return pool.get_worker_count() <= 2; }, std::chrono::seconds(5)));
+
+    auto before = runs.load();
+    EXPECT_TRUE(wait_for([&] { return runs > before; }, std::chrono::seconds(5)));
+
+    // A balancer stuck waiting for the queue never lets stop() return
+    auto stopped = std::async(std::launch::async, [&pool] { pool.stop(); });
+    if (stopped.wait_for(std::chrono::seconds(5)) != std::future_status::ready) {
+        ADD_FAILURE() << "stop() hangs";
+        std::_Exit(1);
+    }
+}
@@ -1,8 +1,69 @@
+-- History is range partitioned by month on created_at. Partitions are created
+-- ahead of time by history_ensure_partitions and dropped by
+-- history_drop_partitions (both called by HistoryRetention); rows outside of
+-- every monthly partition land in history_default.
 CREATE TABLE history
 (
-    id       bigserial          not null primary key,
-    port     int                not null,
-    request  json               not null,
-    is_https bool default false not null,
-    host     text               not null
-);
+    id          bigserial                        not null,
+    created_at  timestamptz default now()        not null,
+    port        int                              not null,
+    request     jsonb,
+    request_bin bytea,
+    is_https    bool default false               not null,
+    host        text                             not null,
+    CHECK (request IS NOT NULL OR request_bin IS NOT NULL),
+    PRIMARY KEY (id, created_at)
+) PARTITION BY RANGE (created_at);
+
+CREATE INDEX history_host_id_idx ON history (host, id);
+
+CREATE TABLE history_default PARTITION OF history DEFAULT;
+
+CREATE OR REPLACE FUNCTION history_create_partition(month date) RETURNS text
+    LANGUAGE plpgsql AS
+$$
+DECLARE
+    start_at date := date_trunc('month', month)::date;
+    name     text := 'history_y' || to_char(start_at, 'YYYY') || 'm' || to_char(start_at, 'MM');
+BEGIN
+    EXECUTE format('CREATE TABLE IF NOT EXISTS %I PARTITION OF history FOR VALUES FROM (%L) TO (%L)',
+                   name, start_at, (start_at + interval '1 month')::date);
+    RETURN name;
+END
+$$;
+
+CREATE OR REPLACE FUNCTION history_ensure_partitions(months_ahead int DEFAULT 2) RETURNS void
+    LANGUAGE plpgsql AS
+$$
+BEGIN
+    FOR i IN 0..months_ahead
+        LOOP
+            PERFORM history_create_partition((now() + make_interval(months => i))::date);
+        END LOOP;
+END
+$$;
+
+-- Drops the monthly partitions that end before now() - keep, returns their names
+CREATE OR REPLACE FUNCTION history_drop_partitions(keep interval) RETURNS SETOF text
+    LANGUAGE plpgsql AS
+$$
+DECLARE
+    part text;
+BEGIN
+    FOR part IN
+        SELECT c.relname
+        FROM pg_inherits i
+                 JOIN pg_class c ON c.oid = i.inhrelid
+        WHERE i.inhparent = 'history'::regclass
+          AND c.relname ~ '^history_y[0-9]{4}m[0-9]{2}$'
+        ORDER BY c.relname
+        LOOP
+            IF to_date(substr(part, 10), 'YYYY"m"MM') + interval '1 month' <= now() - keep THEN
+                EXECUTE format('DROP TABLE %I', part);
+                RETURN NEXT part;
+            END IF;
+        END LOOP;
+END
+$$;
+
+SELECT history_ensure_partitions();
\ No newline at end of file
@@ -0,0 +1,8 @@
+-- Moves history to the binary request format (http::Request::encode).
+-- Existing rows keep their json request and are still readable; they can be
+-- re-encoded in batches with PQStoreRequest::migrate_json_rows.
+
+ALTER TABLE history ADD COLUMN IF NOT EXISTS request_bin bytea;
+ALTER TABLE history ALTER COLUMN request DROP NOT NULL;
+ALTER TABLE history ADD CONSTRAINT history_request_check
+    CHECK (request IS NOT NULL OR request_bin IS NOT NULL);
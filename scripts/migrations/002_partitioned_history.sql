@@ -0,0 +1,21 @@
+-- Moves history to the partitioned schema of scripts/init.sql. Run from the
+-- scripts/migrations directory with psql (it includes ../init.sql). Existing
+-- rows have no creation time and are put into the current month.
+
+BEGIN;
+
+ALTER TABLE history RENAME TO history_legacy;
+ALTER INDEX history_pkey RENAME TO history_legacy_pkey;
+ALTER SEQUENCE history_id_seq RENAME TO history_legacy_id_seq;
+
+\ir ../init.sql
+
+INSERT INTO history (id, created_at, port, request, request_bin, is_https, host)
+SELECT id, now(), port, request::jsonb, request_bin, is_https, host
+FROM history_legacy;
+
+SELECT setval('history_id_seq', (SELECT coalesce(max(id), 0) + 1 FROM history), false);
+
+DROP TABLE history_legacy;
+
+COMMIT;
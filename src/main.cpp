@@ -1,5 +1,6 @@
 #include "tcp_server_lib.hpp"
 #include "proxy_client_lib.hpp"
+#include "logger_lib.hpp"
 
 #include <iostream>
 #include <getopt.h>
@@ -23,28 +24,136 @@ int main(int argc, char *argv[]) {
     proxy::SSLCert::init("certs", "certs/cert.key");
 
     int http_port = 8081;
-    while ((opt = getopt(argc, argv, "p:")) != -1) {
-        if (opt == 'p') {
-            http_port = (int)strtol(optarg, nullptr, 10);
+    rp::recorder_config_t recorder_config;
+    rp::retention_config_t retention_config;
+    proxy::search_config_t search_config;
+    logging::logger_config_t logger_config;
+    size_t shard_count = 1;
+    std::vector<int> cpus;
+    bool coroutines = false;
+    bstcp::connect_config_t connect_config;
+    while ((opt = getopt(argc, argv, "p:b:l:q:o:s:r:k:c:i:e:v:g:m:n:a:wt:")) != -1) {
+        switch (opt) {
+            case 'p':
+                http_port = (int)strtol(optarg, nullptr, 10);
+                break;
+            case 'b': // history batch size
+                recorder_config.batch_size = strtoul(optarg, nullptr, 10);
+                break;
+            case 'l': // max delay before a history batch is written, ms
+                recorder_config.max_latency = std::chrono::milliseconds(strtol(optarg, nullptr, 10));
+                break;
+            case 'q': // history queue capacity
+                recorder_config.queue_capacity = strtoul(optarg, nullptr, 10);
+                break;
+            case 'o': // history overflow policy: drop, block or spill
+                if (std::string(optarg) == "drop") {
+                    recorder_config.overflow = rp::OverflowPolicy::drop;
+                } else if (std::string(optarg) == "block") {
+                    recorder_config.overflow = rp::OverflowPolicy::block;
+                } else {
+                    recorder_config.overflow = rp::OverflowPolicy::spill;
+                }
+                break;
+            case 's': // history spool directory, "off" disables the spool
+                if (std::string(optarg) == "off") {
+                    recorder_config.use_spool = false;
+                } else {
+                    recorder_config.spool.directory = optarg;
+                }
+                break;
+            case 'r': // delay between database retries while spooling, ms
+                recorder_config.retry_interval = std::chrono::milliseconds(strtol(optarg, nullptr, 10));
+                break;
+            case 'k': // days of history kept, older monthly partitions are dropped
+                retention_config.keep = std::chrono::hours(24 * strtol(optarg, nullptr, 10));
+                break;
+            case 'c': // probes of one /search sent at once
+                search_config.concurrency = strtoul(optarg, nullptr, 10);
+                break;
+            case 'i': // /search payloads and signatures, see scan/injections.txt
+                search_config.corpus_path = optarg;
+                break;
+            case 'e': // bytes of a matching response shown by /search
+                search_config.excerpt_size = strtoul(optarg, nullptr, 10);
+                break;
+            case 'v': // log level: debug, info, warning, error or off
+                logger_config.level = logging::Logger::parse_level(optarg);
+                break;
+            case 'g': // log file, stdout by default
+                logger_config.path = optarg;
+                break;
+            case 'm': // keep one of N debug and info log entries
+                logger_config.sample_every = strtoul(optarg, nullptr, 10);
+                break;
+            case 'n': // server shards, each with its own listener and threads pinned to a CPU
+                shard_count = std::max(strtoul(optarg, nullptr, 10), 1ul);
+                break;
+            case 'a': // CPUs to run on, e.g. 0-7,16-23: one per shard, or one per pool thread without shards
+                cpus = prll::CpuTopology::parse_cpu_list(optarg);
+                break;
+            case 'w': // serve requests with coroutines on an event loop thread of each shard
+                coroutines = true;
+                break;
+            case 't': // ms an upstream address is given to connect before the next one is tried alone
+                connect_config.attempt_timeout = strtol(optarg, nullptr, 10);
+                break;
+            default:
+                break;
         }
     }
 
-    proxy::ProxyClient::set_repository("host=localhost user=proxy password=pwd port=5432 dbname=proxy connect_timeout=10");
+    logging::Logger::init(logger_config);
 
-    try {
-        TcpServer<proxy::TcpSocket, proxy::ProxyClient> server(http_port,
-                         {1, 1, 1}, // Keep alive{idle:1s, interval: 1s, pk_count: 1}
+    proxy::ProxyClient::set_repository("host=localhost user=proxy password=pwd port=5432 dbname=proxy connect_timeout=10",
+                                       recorder_config, retention_config);
+    proxy::ProxyClient::set_search_config(search_config);
+    proxy::ProxyClient::set_connect_config(connect_config);
+    proxy::ProxyClient::set_shard_count(shard_count);
 
-                         [](uniq_ptr<ISocket> &client) { // Connect handler
-                             std::cout << "Client " << getHostStr(client) << " connected\n";
-                         },
+    auto connect_hndl = [](uniq_ptr<ISocket> &client) {
+        proxy::ProxyMetrics::connection_accepted();
+        if (logging::Logger::enabled(logging::Level::debug)) {
+            logging::debug({"Client ", getHostStr(client), " connected"});
+        }
+    };
 
-                         [](uniq_ptr<ISocket> &client) { // Disconnect handler
-                             std::cout << "Client " << getHostStr(client) << " disconnected\n";
-                         },
+    auto disconnect_hndl = [](uniq_ptr<ISocket> &client) {
+        proxy::ProxyMetrics::connection_closed();
+        if (logging::Logger::enabled(logging::Level::debug)) {
+            logging::debug({"Client ", getHostStr(client), " disconnected"});
+        }
+    };
 
-                         std::thread::hardware_concurrency() // Thread pool size
+    try {
+        if (shard_count > 1) {
+            size_t threads = std::max(std::thread::hardware_concurrency() / shard_count, (size_t) 2);
+            ShardedTcpServer<proxy::TcpSocket, proxy::ProxyClient> server(http_port, shard_count,
+                             {1, 1, 1}, // Keep alive{idle:1s, interval: 1s, pk_count: 1}
+                             connect_hndl, disconnect_hndl,
+                             threads, // Thread pool size of each shard
+                             true, cpus
+            );
+            server.set_coroutine_mode(coroutines);
+
+            if (server.start() == TcpServer<proxy::TcpSocket, proxy::ProxyClient>::ServerStatus::up) {
+                std::cout << "Server listen on port: " << server.get_port() << std::endl
+                          << "Server shards: " << shard_count << ", " << threads << " threads each" << std::endl;
+                server.joinLoop();
+                return EXIT_SUCCESS;
+            } else {
+                std::cout << "Server start error! Error code:" << int(server.get_status()) << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        TcpServer<proxy::TcpSocket, proxy::ProxyClient> server(http_port,
+                         {1, 1, 1}, // Keep alive{idle:1s, interval: 1s, pk_count: 1}
+                         connect_hndl, disconnect_hndl,
+                         std::thread::hardware_concurrency(), // Thread pool size
+                         {cpus, true}
         );
+        server.set_coroutine_mode(coroutines);
 
         //Start server
         if (server.start() == TcpServer<proxy::TcpSocket, proxy::ProxyClient>::ServerStatus::up) {